@@ -1,70 +1,203 @@
-#include <LayeredAStarPathfinder.h>
+#include "src/BatchStream.h"
+#include "src/ContractionHierarchyPathfinder.h"
+#include "src/Generation.h"
 #include "src/OSM.h"
+#include "src/PBF.h"
+#include "src/TaskRegistry.h"
+#include "src/WorkerPool.h"
 #include "third-party/httplib.h"
 #include "third-party/json.hpp"
-#include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <algorithm>
 #include <atomic>
-#include <unordered_map>
-#include <future>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <optional>
+#include <thread>
 #include <string>
 
+using Lane = Foliage::Util::WorkerPool::Lane;
+using Status = Foliage::Util::TaskRegistry::Status;
+
 httplib::Server server;
-Foliage::DataProvider::OSM::Document doc;
-Foliage::Pathfinder::LayeredAStarPathfinder pathfinder;
-
-std::mutex task_mutex;
-std::condition_variable task_cv;
-std::queue<std::function<void()> > task_queue;
-std::atomic<bool> running{true};
-
-enum TaskStatus {
-    NotFound,
-    InQueue,
-    Running,
-    Success,
-    Failed
-};
 
-std::unordered_map<std::string, TaskStatus> task_status; // Task ID -> Status
-std::unordered_map<std::string, std::string> task_result; // Task ID -> Result (JSON string)
+// The region being served. Queries pin a generation with an atomic load, and loads publish the next
+Foliage::Pathfinder::GenerationSlot generations;
 
-// Generate a unique task ID
-std::string generate_task_id() {
-    static std::atomic<int> id_counter{0};
-    return "task_" + std::to_string(id_counter++);
+nlohmann::json lane_stats_to_json(const Foliage::Util::WorkerPool::LaneStats &stats) {
+    return {
+        {"workers", stats.workers}, {"queued", stats.queued}, {"running", stats.running},
+        {"completed", stats.completed}, {"failed", stats.failed}, {"stolen", stats.stolen},
+        {"busy_seconds", stats.busy_seconds}, {"max_seconds", stats.max_seconds},
+        {"wait_seconds", stats.wait_seconds}
+    };
 }
 
-// Background worker to process tasks
-void task_worker() {
-    while (running) {
-        std::function<void()> task; {
-            std::unique_lock<std::mutex> lock(task_mutex);
-            task_cv.wait(lock, [] { return !task_queue.empty() || !running; });
-            if (!running && task_queue.empty()) break;
-            task = std::move(task_queue.front());
-            task_queue.pop();
-        }
-        if (task) task();
+// Longest a request may block waiting for a task, so that waiting clients cannot pin every HTTP thread
+constexpr std::chrono::milliseconds max_wait(30000);
+
+// Until when a request waits: `param` milliseconds from now, at most max_wait, or `fallback` if not given.
+// Throws std::invalid_argument unless the parameter is a whole, non-negative number
+std::chrono::steady_clock::time_point deadline_of(const httplib::Request &req, const std::string &param,
+                                                  std::chrono::milliseconds fallback) {
+    auto wait = std::min(fallback, max_wait);
+    if (req.has_param(param)) {
+        const auto value = req.get_param_value(param);
+        uint64_t milliseconds = 0;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), milliseconds);
+        // from_chars takes no sign, so "-1" fails here, while too many digits are just a long wait
+        if (value.empty() || end != value.data() + value.size() ||
+            (error != std::errc() && error != std::errc::result_out_of_range)) {
+            throw std::invalid_argument("Expected milliseconds for " + param + ", got \"" + value + "\"");
+        }
+        if (error == std::errc() && milliseconds < static_cast<uint64_t>(max_wait.count())) {
+            wait = std::chrono::milliseconds(milliseconds);
+        } else {
+            wait = max_wait;
+        }
     }
+    return std::chrono::steady_clock::now() + wait;
 }
 
-// Convert TaskStatus to a string
-std::string task_status_to_string(TaskStatus status) {
-    switch (status) {
-        case InQueue: return "InQueue";
-        case Running: return "Running";
-        case Success: return "Success";
-        case Failed: return "Failed";
-        default: return "NotFound";
+// A command line value that must be a whole number from 1 to `max`, or nothing if it is not one
+std::optional<uint64_t> positive_of(const std::string &value, uint64_t max) {
+    uint64_t number = 0;
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (value.empty() || end != value.data() + value.size() || error != std::errc() || number == 0 || number > max) {
+        return std::nullopt;
     }
+    return number;
 }
 
-int main() {
-    // Start the worker thread
-    std::thread worker(task_worker);
+// The algorithm a query asks for. "astar" (default) searches the layered costs, "ch" uses a contraction
+// hierarchy when the profile has one. Throws std::invalid_argument for an unknown algorithm, or for a
+// `suboptimality` asked of the hierarchy, which always answers with its own exact costs
+std::string algorithm_of(const nlohmann::json &req_json) {
+    auto algorithm = req_json.value("algorithm", std::string("astar"));
+    if (algorithm != "ch" && algorithm != "astar") {
+        throw std::invalid_argument("Unknown algorithm " + algorithm);
+    }
+    if (algorithm == "ch" && req_json.at("preference").contains("suboptimality")) {
+        throw std::invalid_argument("suboptimality is only supported by the astar algorithm");
+    }
+    return algorithm;
+}
+
+// Answers one /api/query, /api/route or /api/batch request on the current generation
+nlohmann::json route(const nlohmann::json &req_json) {
+    // Pinned for the whole query, even if a load publishes another meanwhile
+    const auto generation = generations.pin();
+    Foliage::Geometry::Position st(req_json["start"]["lat"], req_json["start"]["lon"]);
+    Foliage::Geometry::Position goal(req_json["goal"]["lat"], req_json["goal"]["lon"]);
+
+    auto preference = req_json.at("preference").get<std::map<std::string, std::string> >();
+    const auto algorithm = algorithm_of(req_json);
+    bool relocated = false;
+    auto path = algorithm == "ch"
+                    ? generation->ch->get_path(st, goal, preference, &relocated)
+                    : generation->astar->get_path(st, goal, preference, &relocated);
+
+    nlohmann::json res_json = nlohmann::json::array();
+    for (const auto &p: path) {
+        res_json.push_back({{"lat", p->position.latitude}, {"lon", p->position.longitude}});
+    }
+    // The closest roads to the ends cannot reach each other, so the route runs between the closest ones that can
+    nlohmann::json response = {{"result", res_json}, {"disconnected", relocated}};
+    if (algorithm == "ch") return response;
+    // The search just ran on this thread, so its workspace still holds what it did
+    const auto stats = Foliage::Pathfinder::SearchWorkspace::local().stats();
+    nlohmann::json stats_json = {
+        {"settled", stats.settled}, {"relaxed", stats.relaxed}, {"heap_pushes", stats.pushes},
+        {"heap_decreases", stats.decreases}, {"heap_pops", stats.pops}
+    };
+    response["stats"] = stats_json;
+    return response;
+}
+
+// The body of a failed query. Ends that no route joins are told apart from bad requests, with the components
+// they snapped into
+nlohmann::json query_error(const std::exception &e) {
+    nlohmann::json error_json = {{"error", e.what()}};
+    if (const auto *unreachable = dynamic_cast<const Foliage::Pathfinder::Unreachable *>(&e)) {
+        error_json["reason"] = "unreachable";
+        error_json["start_component"] = unreachable->start_component;
+        error_json["goal_component"] = unreachable->goal_component;
+    }
+    return error_json;
+}
+
+// A batch being answered. Its queries go to the query lane a few at a time, see run_batch
+struct Batch {
+    nlohmann::json queries;
+    std::shared_ptr<Foliage::Util::BatchStream> stream;
+    std::atomic<size_t> next{0}; // First query not submitted yet
+};
+
+// Submits the next query of a batch, if any is left. Once it has run and its line is pushed, it submits the
+// one after it, so the batch keeps as many queries on the lane as it was started with
+void run_batch(Foliage::Util::WorkerPool &workers, const std::shared_ptr<Batch> &batch) {
+    const size_t i = batch->next++;
+    if (i >= batch->queries.size()) return;
+    workers.submit(Lane::Query, [&workers, batch, i]() {
+        try {
+            auto line = route(batch->queries[i]);
+            line["index"] = i;
+            batch->stream->push(line.dump());
+        } catch (const std::exception &e) {
+            auto line = query_error(e);
+            line["index"] = i;
+            batch->stream->push(line.dump(), true);
+        }
+        run_batch(workers, batch);
+    });
+}
+
+// Queues a route request on the query lane, for the caller to answer with the task id or to wait on.
+// Throws std::invalid_argument, before queueing anything, if it asks for an algorithm it cannot have
+Foliage::Util::TaskRegistry::Handle submit_query(Foliage::Util::WorkerPool &workers,
+                                                 Foliage::Util::TaskRegistry &tasks, nlohmann::json req_json) {
+    (void) algorithm_of(req_json);
+    auto task = tasks.create();
+    workers.submit(Lane::Query, [req_json = std::move(req_json), task]() {
+        task.start();
+        try {
+            task.finish(Status::Success, route(req_json).dump());
+        } catch (const std::exception &e) {
+            task.finish(Status::Failed, query_error(e).dump());
+        }
+    });
+    return task;
+}
+
+int main(int argc, char **argv) {
+    // --query-workers=N sets the threads that answer queries, one per core by default.
+    // Loads and snapshots run one at a time on a lane of their own.
+    // --task-memory=MiB and --task-ttl=seconds bound the results kept for polling
+    size_t query_workers = std::max(1u, std::thread::hardware_concurrency());
+    Foliage::Util::TaskRegistry::Options task_options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        std::optional<uint64_t> value;
+        if (arg.starts_with("--query-workers=")) {
+            if ((value = positive_of(arg.substr(16), 4096))) query_workers = *value;
+        } else if (arg.starts_with("--task-memory=")) {
+            if ((value = positive_of(arg.substr(14), SIZE_MAX >> 20))) task_options.max_bytes = *value << 20;
+        } else if (arg.starts_with("--task-ttl=")) {
+            if ((value = positive_of(arg.substr(11), 10 * 365 * 24 * 3600))) {
+                task_options.ttl = std::chrono::seconds(*value);
+            }
+        }
+        if (!value) {
+            std::cerr << "Invalid argument \"" << arg << "\"\n"
+                    << "Usage: " << argv[0] << " [--query-workers=N] [--task-memory=MiB] [--task-ttl=seconds]\n"
+                    << "Each value is a whole number greater than 0" << std::endl;
+            return 2;
+        }
+    }
+    // Declared first, so it outlives the workers that report to it
+    Foliage::Util::TaskRegistry tasks(task_options);
+    Foliage::Util::WorkerPool workers(query_workers);
 
     server.Get("/api/test", [](const httplib::Request &, httplib::Response &res) {
         nlohmann::json json;
@@ -73,106 +206,240 @@ int main() {
         res.set_content(json.dump(), "application/json");
     });
 
-    server.Get("/api/task/:id/status", [](const httplib::Request &req, httplib::Response &res) {
+    server.Get("/api/workers", [&workers](const httplib::Request &, httplib::Response &res) {
+        nlohmann::json json = {
+            {"load", lane_stats_to_json(workers.stats(Lane::Load))},
+            {"query", lane_stats_to_json(workers.stats(Lane::Query))}
+        };
+        res.set_content(json.dump(), "application/json");
+    });
+
+    server.Get("/api/tasks", [&tasks](const httplib::Request &, httplib::Response &res) {
+        const auto stats = tasks.stats();
+        nlohmann::json json = {
+            {"tasks", stats.tasks}, {"bytes", stats.bytes}, {"created", stats.created},
+            {"expired", stats.expired}, {"evicted", stats.evicted}
+        };
+        res.set_content(json.dump(), "application/json");
+    });
+
+    // Work of the A* searches on the current generation, summed, to tune `suboptimality` against
+    server.Get("/api/search", [](const httplib::Request &, httplib::Response &res) {
+        const auto totals = generations.pin()->astar->totals();
+        nlohmann::json json = {
+            {"searches", totals.searches}, {"settled", totals.settled}, {"relaxed", totals.relaxed},
+            {"heap_operations", totals.heap_operations}, {"unreachable", totals.unreachable},
+            {"stopped_early", totals.stopped_early}
+        };
+        res.set_content(json.dump(), "application/json");
+    });
+
+    // With `wait=<ms>`, both block until the task finishes or the time is up, instead of being polled
+    server.Get("/api/task/:id/status", [&tasks](const httplib::Request &req, httplib::Response &res) {
         auto task_id = req.path_params.at("id");
-        auto it = task_status.find(task_id);
-        nlohmann::json json;
-        if (it != task_status.end()) {
-            json = {{"status", task_status_to_string(it->second)}};
-        } else {
-            json = {{"status", "NotFound"}};
+        try {
+            const auto status = req.has_param("wait")
+                                    ? tasks.wait(task_id, deadline_of(req, "wait", max_wait))
+                                    : tasks.status(task_id);
+            nlohmann::json json = {{"status", Foliage::Util::TaskRegistry::to_string(status)}};
+            res.set_content(json.dump(), "application/json");
+        } catch (const std::invalid_argument &e) {
+            nlohmann::json error_json = {{"error", e.what()}};
+            res.status = 400;
+            res.set_content(error_json.dump(), "application/json");
         }
-        res.set_content(json.dump(), "application/json");
     });
 
-    server.Get("/api/task/:id/result", [](const httplib::Request &req, httplib::Response &res) {
+    server.Get("/api/task/:id/result", [&tasks](const httplib::Request &req, httplib::Response &res) {
         auto task_id = req.path_params.at("id");
-        auto it = task_result.find(task_id);
-        if (it != task_result.end()) {
-            res.set_content(it->second, "application/json");
+        try {
+            if (req.has_param("wait")) (void) tasks.wait(task_id, deadline_of(req, "wait", max_wait));
+        } catch (const std::invalid_argument &e) {
+            nlohmann::json error_json = {{"error", e.what()}};
+            res.status = 400;
+            res.set_content(error_json.dump(), "application/json");
+            return;
+        }
+        if (const auto result = tasks.result(task_id)) {
+            res.set_content(*result, "application/json");
         } else {
-            nlohmann::json error_json = {{"error", "Task ID not found or not completed"}};
+            nlohmann::json error_json = {{"error", "Task ID not found, not completed or expired"}};
             res.status = 404;
             res.set_content(error_json.dump(), "application/json");
         }
     });
 
-    server.Post("/api/load", [](const httplib::Request &req, httplib::Response &res) {
+    server.Post("/api/load", [&workers, &tasks](const httplib::Request &req, httplib::Response &res) {
         auto file = req.get_param_value("file");
         if (file.empty()) {
             nlohmann::json res_json = {{"status", "error"}, {"message", "No file given"}};
             res.set_content(res_json.dump(), "application/json");
             return;
         }
+        // .pbf files go through the PBF reader and .snapshot files are mapped as they are. For XML,
+        // "stream" (default) reads the file in one pass and "dom" goes through tinyxml2
+        bool is_pbf = file.ends_with(".pbf");
+        bool is_snapshot = file.ends_with(".snapshot");
+        auto loader_name = req.has_param("loader") ? req.get_param_value("loader") : "stream";
+        if (loader_name != "stream" && loader_name != "dom") {
+            nlohmann::json res_json = {{"status", "error"}, {"message", "Unknown loader " + loader_name}};
+            res.set_content(res_json.dump(), "application/json");
+            return;
+        }
+        auto loader = loader_name == "dom"
+                          ? Foliage::DataProvider::OSM::Document::Loader::DOM
+                          : Foliage::DataProvider::OSM::Document::Loader::Streaming;
 
-        std::string task_id = generate_task_id();
-        task_status[task_id] = InQueue; {
-            std::unique_lock<std::mutex> lock(task_mutex);
-            task_queue.push([file, task_id]() {
-                task_status[task_id] = Running;
-                try {
-                    doc.set_document(file);
-                    doc.reset();
-                    doc.load();
-                    doc.parse();
-                    pathfinder.qtree = std::make_shared<Foliage::Util::QuadTree>(doc.qtree);
-                    task_status[task_id] = Success;
-                    nlohmann::json result_json = {
-                        {
-                            "min_bound",
-                            {"lat", doc.border.min_position.latitude},
-                            {"lon", doc.border.min_position.longitude}
-                        },
-                        {
-                            "max_bound",
-                            {"lat", doc.border.max_position.latitude},
-                            {"lon", doc.border.max_position.longitude}
-                        }
-                    };
-                    task_result[task_id] = result_json.dump();
-                } catch (const std::exception &e) {
-                    task_status[task_id] = Failed;
-                    task_result[task_id] = nlohmann::json({{"error", e.what()}}).dump();
+        const auto task = tasks.create();
+        workers.submit(Lane::Load, [file, is_pbf, is_snapshot, loader, task]() {
+            task.start();
+            try {
+                // Queries keep using the current generation until the next one is complete
+                Foliage::Util::StageTimer timings;
+                std::shared_ptr<Foliage::Pathfinder::Generation> next;
+                if (is_snapshot) {
+                    next = Foliage::Pathfinder::Generation::load(file, timings);
+                } else {
+                    std::unique_ptr<Foliage::DataProvider::AbstractDocument> doc;
+                    if (is_pbf) doc = std::make_unique<Foliage::DataProvider::PBF::Document>(file);
+                    else doc = std::make_unique<Foliage::DataProvider::OSM::Document>(file, loader);
+                    doc->load();
+                    doc->parse();
+                    timings = doc->timings;
+                    timings.restart();
+                    next = Foliage::Pathfinder::Generation::build(*doc, timings);
                 }
-            });
+                const auto bounds = next->bounds;
+                const auto generation = generations.publish(std::move(next));
+                nlohmann::json result_json = {
+                    {
+                        "min_bound",
+                        {"lat", bounds.min_position.latitude},
+                        {"lon", bounds.min_position.longitude}
+                    },
+                    {
+                        "max_bound",
+                        {"lat", bounds.max_position.latitude},
+                        {"lon", bounds.max_position.longitude}
+                    }
+                };
+                // Stages in the order they ran, so the slow one of a load can be told apart
+                nlohmann::json stages = nlohmann::json::array();
+                for (const auto &stage: timings.stages) {
+                    stages.push_back({{"stage", stage.name}, {"seconds", stage.seconds}});
+                }
+                result_json.push_back(nlohmann::json::array({"timings", stages}));
+                result_json.push_back(nlohmann::json::array({"generation", generation}));
+                task.finish(Status::Success, result_json.dump());
+            } catch (const std::exception &e) {
+                task.finish(Status::Failed, nlohmann::json({{"error", e.what()}}).dump());
+            }
+        });
+
+        nlohmann::json res_json = {{"task_id", task.id()}};
+        res.set_content(res_json.dump(), "application/json");
+    });
+
+    // Writes the loaded region, with its landmark tables and hierarchies, to a file /api/load can map
+    server.Post("/api/snapshot", [&workers, &tasks](const httplib::Request &req, httplib::Response &res) {
+        auto file = req.get_param_value("file");
+        if (file.empty()) {
+            nlohmann::json res_json = {{"status", "error"}, {"message", "No file given"}};
+            res.set_content(res_json.dump(), "application/json");
+            return;
         }
-        task_cv.notify_one();
 
-        nlohmann::json res_json = {{"task_id", task_id}};
+        const auto task = tasks.create();
+        workers.submit(Lane::Load, [file, task]() {
+            task.start();
+            try {
+                generations.pin()->snapshot().write(file);
+                task.finish(Status::Success, nlohmann::json({{"file", file}}).dump());
+            } catch (const std::exception &e) {
+                task.finish(Status::Failed, nlohmann::json({{"error", e.what()}}).dump());
+            }
+        });
+
+        nlohmann::json res_json = {{"task_id", task.id()}};
         res.set_content(res_json.dump(), "application/json");
     });
 
-    server.Post("/api/query", [](const httplib::Request &req, httplib::Response &res) {
+    server.Post("/api/query", [&workers, &tasks](const httplib::Request &req, httplib::Response &res) {
         try {
-            auto req_json = nlohmann::json::parse(req.body);
-            std::string task_id = generate_task_id();
-            task_status[task_id] = InQueue;
+            const auto task = submit_query(workers, tasks, nlohmann::json::parse(req.body));
+            nlohmann::json res_json = {{"task_id", task.id()}};
+            res.set_content(res_json.dump(), "application/json");
+        } catch (const std::exception &e) {
+            nlohmann::json error_json = {{"error", e.what()}};
+            res.status = 400;
+            res.set_content(error_json.dump(), "application/json");
+        }
+    });
 
-            std::unique_lock<std::mutex> lock(task_mutex);
-            task_queue.push([req_json, task_id]() {
-                task_status[task_id] = Running;
-                try {
-                    Foliage::Geometry::Position st(req_json["start"]["lat"], req_json["start"]["lon"]);
-                    Foliage::Geometry::Position goal(req_json["goal"]["lat"], req_json["goal"]["lon"]);
+    // Same request as /api/query, answered inline if the route is found within `timeout` ms (5000 by
+    // default). Otherwise 202 with the task id, to be waited for with /api/task/:id/result?wait=<ms>
+    server.Post("/api/route", [&workers, &tasks](const httplib::Request &req, httplib::Response &res) {
+        try {
+            const auto deadline = deadline_of(req, "timeout", std::chrono::milliseconds(5000));
+            const auto task = submit_query(workers, tasks, nlohmann::json::parse(req.body));
+            const auto status = task.wait(deadline);
+            // A result evicted right away under memory pressure is reported like an unfinished task
+            if (const auto result = tasks.result(task.id())) {
+                if (status == Status::Failed) res.status = 400;
+                res.set_content(*result, "application/json");
+                return;
+            }
+            nlohmann::json res_json = {
+                {"task_id", task.id()}, {"status", Foliage::Util::TaskRegistry::to_string(status)}
+            };
+            res.status = 202;
+            res.set_content(res_json.dump(), "application/json");
+        } catch (const std::exception &e) {
+            nlohmann::json error_json = {{"error", e.what()}};
+            res.status = 400;
+            res.set_content(error_json.dump(), "application/json");
+        }
+    });
 
-                    auto preference = req_json.at("preference").get<std::map<std::string, std::string> >();
-                    auto path = pathfinder.get_path(st, goal, preference);
+    // Route costs between every source and every target, as a task like /api/query. Takes
+    // {"sources": [{"lat", "lon"}...], "targets": [...], "preference": {...}} and gives
+    // {"costs": [[...]...]}, one row per source, null where there is no route
+    server.Post("/api/matrix", [&workers, &tasks](const httplib::Request &req, httplib::Response &res) {
+        try {
+            auto req_json = nlohmann::json::parse(req.body);
+            Foliage::Pathfinder::ContractionHierarchyPathfinder::require_table_size(req_json.at("sources").size(),
+                                                                                    req_json.at("targets").size());
+            const auto task = tasks.create();
+            workers.submit(Lane::Query, [req_json = std::move(req_json), task]() {
+                task.start();
+                try {
+                    const auto generation = generations.pin();
+                    auto positions = [](const nlohmann::json &points) {
+                        std::vector<Foliage::Geometry::Position> result;
+                        for (const auto &point: points) result.emplace_back(point.at("lat"), point.at("lon"));
+                        return result;
+                    };
+                    const auto sources = positions(req_json.at("sources"));
+                    const auto targets = positions(req_json.at("targets"));
+                    const auto preference = req_json.value("preference", std::map<std::string, std::string>{});
+                    const auto costs = generation->ch->table(sources, targets, preference);
 
-                    nlohmann::json res_json = nlohmann::json::array();
-                    for (const auto &p: path) {
-                        res_json.push_back({{"lat", p->position.latitude}, {"lon", p->position.longitude}});
+                    nlohmann::json rows = nlohmann::json::array();
+                    for (size_t s = 0; s < sources.size(); ++s) {
+                        nlohmann::json row = nlohmann::json::array();
+                        for (size_t t = 0; t < targets.size(); ++t) {
+                            const float cost = costs[s * targets.size() + t];
+                            if (std::isfinite(cost)) row.push_back(cost);
+                            else row.push_back(nullptr);
+                        }
+                        rows.push_back(std::move(row));
                     }
-                    res_json = {{"result", res_json}};
-                    task_status[task_id] = Success;
-                    task_result[task_id] = res_json.dump();
+                    task.finish(Status::Success, nlohmann::json({{"costs", rows}}).dump());
                 } catch (const std::exception &e) {
-                    task_status[task_id] = Failed;
-                    task_result[task_id] = nlohmann::json({{"error", e.what()}}).dump();
+                    task.finish(Status::Failed, nlohmann::json({{"error", e.what()}}).dump());
                 }
             });
-            task_cv.notify_one();
-
-            nlohmann::json res_json = {{"task_id", task_id}};
+            nlohmann::json res_json = {{"task_id", task.id()}};
             res.set_content(res_json.dump(), "application/json");
         } catch (const std::exception &e) {
             nlohmann::json error_json = {{"error", e.what()}};
@@ -181,12 +448,50 @@ int main() {
         }
     });
 
-    server.listen("0.0.0.0", 9961);
+    // Takes an array of /api/query bodies and answers with one JSON line per query, `index` being its place in
+    // the array, in the order they finish. A last line gives the number of queries, failures and queries/s
+    server.Post("/api/batch", [&workers](const httplib::Request &req, httplib::Response &res) {
+        constexpr size_t max_batch = 10000;
+        nlohmann::json queries;
+        try {
+            queries = nlohmann::json::parse(req.body);
+            if (!queries.is_array()) throw std::invalid_argument("A batch is an array of queries");
+            if (queries.size() > max_batch) {
+                throw std::invalid_argument("A batch holds at most " + std::to_string(max_batch) + " queries");
+            }
+        } catch (const std::exception &e) {
+            nlohmann::json error_json = {{"error", e.what()}};
+            res.status = 400;
+            res.set_content(error_json.dump(), "application/json");
+            return;
+        }
 
-    // Clean up
-    running = false;
-    task_cv.notify_all();
-    worker.join();
+        // Shared with the workers, which may still be running if the client goes away
+        auto stream = std::make_shared<Foliage::Util::BatchStream>(queries.size());
+        auto batch = std::make_shared<Batch>(std::move(queries), stream);
+        // Two queries per worker keep the lane busy, and routes sent meanwhile wait behind those alone
+        const size_t window = 2 * workers.stats(Lane::Query).workers;
+        for (size_t i = 0; i < window; ++i) run_batch(workers, batch);
+        res.set_chunked_content_provider("application/x-ndjson", [stream](size_t, httplib::DataSink &sink) {
+            std::string line;
+            if (!stream->next(line)) {
+                const auto summary = stream->summary();
+                line = nlohmann::json({
+                    {"queries", summary.queries}, {"failed", summary.failed}, {"seconds", summary.seconds},
+                    {"queries_per_second", summary.seconds > 0 ? summary.queries / summary.seconds : 0.0}
+                }).dump();
+                line += '\n';
+                sink.write(line.data(), line.size());
+                sink.done();
+                return true;
+            }
+            line += '\n';
+            return sink.write(line.data(), line.size());
+        });
+    });
+
+    server.listen("0.0.0.0", 9961);
 
+    // The pool finishes the queued tasks as it goes out of scope
     return 0;
 }
@@ -0,0 +1,192 @@
+#include "AbstractDocument.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "object.h"
+#include "ThreadPool.h"
+
+namespace Foliage::DataProvider {
+    namespace {
+        // Nodes and ways reference each other, break the cycles so they can be freed
+        void release_objects(std::unordered_map<int64_t, std::shared_ptr<ObjectType::Node>> &nodes_by_id) {
+            for (const auto &[_, node]: nodes_by_id) {
+                node->ways.clear();
+            }
+        }
+
+        // Fibonacci hashing, so that runs of consecutive ids spread over all shards
+        constexpr int shard_bits = 8;
+        constexpr size_t shard_count = size_t{1} << shard_bits;
+
+        size_t shard_of(const int64_t id) {
+            return static_cast<size_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> (64 - shard_bits));
+        }
+
+        using ShardCounts = std::array<size_t, shard_count>;
+
+        /**
+         * Turns the number of entries every block has in every shard into the position of the block's first
+         * entry of that shard, for a shard-major array in which each shard keeps block order.
+         * @return The start of every shard, plus the total
+         */
+        std::vector<size_t> scatter_offsets(std::vector<ShardCounts> &counts) {
+            std::vector<size_t> shard_offsets(shard_count + 1);
+            size_t total = 0;
+            for (size_t shard = 0; shard < shard_count; ++shard) {
+                shard_offsets[shard] = total;
+                for (auto &block: counts) total += std::exchange(block[shard], total);
+            }
+            shard_offsets[shard_count] = total;
+            return shard_offsets;
+        }
+
+        struct IndexedNode {
+            int64_t id;
+            const std::shared_ptr<ObjectType::Node> *node;
+            size_t group; // Shard of the node's back references, see link()
+        };
+
+        struct BackReference {
+            ObjectType::Node *node;
+            const std::shared_ptr<ObjectType::Way> *way;
+        };
+    }
+
+    AbstractDocument::AbstractDocument() = default;
+
+    AbstractDocument::~AbstractDocument() {
+        release_objects(nodes_by_id);
+    }
+
+    void AbstractDocument::reset() {
+        release_objects(nodes_by_id);
+        nodes_by_id.clear();
+        ways_by_id.clear();
+        timings = {};
+    }
+
+    void AbstractDocument::link(std::vector<DecodedBlock> &blocks) {
+        auto &pool = Util::ThreadPool::shared();
+
+        // Step 1. Every node id into its hash shard, in block order, then sort the shards
+        std::vector<ShardCounts> counts(blocks.size());
+        pool.parallel_for(blocks.size(), [&](size_t block) {
+            counts[block].fill(0);
+            for (const auto &node: blocks[block].nodes) ++counts[block][shard_of(node->id)];
+        });
+        const auto node_shards = scatter_offsets(counts);
+        std::vector<IndexedNode> index(node_shards.back());
+        pool.parallel_for(blocks.size(), [&](size_t block) {
+            auto &next = counts[block];
+            const size_t group = block * shard_count / blocks.size();
+            for (const auto &node: blocks[block].nodes) index[next[shard_of(node->id)]++] = {node->id, &node, group};
+        });
+        pool.parallel_for(shard_count, [&](size_t shard) {
+            // Stable, so the last of several equal ids is the one found below
+            std::stable_sort(index.begin() + node_shards[shard], index.begin() + node_shards[shard + 1],
+                             [](const IndexedNode &a, const IndexedNode &b) { return a.id < b.id; });
+        });
+        auto find = [&](int64_t id) -> const IndexedNode * {
+            const auto shard = shard_of(id);
+            const auto first = index.begin() + node_shards[shard];
+            const auto it = std::upper_bound(first, index.begin() + node_shards[shard + 1], id,
+                                             [](int64_t id, const IndexedNode &node) { return id < node.id; });
+            return it != first && (it - 1)->id == id ? &*(it - 1) : nullptr;
+        };
+        timings.lap("node index");
+
+        // Step 2. Resolve the references of every block. The back references are sharded by the range of blocks
+        // the node came from rather than by id, so that each shard works on nodes that are close in memory
+        std::vector<std::vector<const IndexedNode *>> resolved(blocks.size());
+        pool.parallel_for(blocks.size(), [&](size_t block) {
+            counts[block].fill(0);
+            size_t ref_count = 0;
+            for (const auto &decoded: blocks[block].ways) ref_count += decoded.refs.size();
+            resolved[block].reserve(ref_count);
+            for (auto &[way, refs]: blocks[block].ways) {
+                way->nodes.reserve(refs.size());
+                for (const auto ref: refs) {
+                    const auto node = find(ref);
+                    if (!node) {
+                        throw std::runtime_error("Way " + std::to_string(way->id) +
+                                                 " references unknown node " + std::to_string(ref));
+                    }
+                    way->nodes.push_back(*node->node);
+                    resolved[block].push_back(node);
+                    ++counts[block][node->group];
+                }
+                refs = {};
+            }
+        });
+        const auto reference_shards = scatter_offsets(counts);
+        std::vector<BackReference> back_references(reference_shards.back());
+        pool.parallel_for(blocks.size(), [&](size_t block) {
+            auto &next = counts[block];
+            auto node = resolved[block].begin();
+            for (const auto &decoded: blocks[block].ways) {
+                for (size_t i = 0; i < decoded.way->nodes.size(); ++i, ++node) {
+                    back_references[next[(*node)->group]++] = {(*node)->node->get(), &decoded.way};
+                }
+            }
+            resolved[block] = {};
+        });
+        index = {};
+        timings.lap("way references");
+
+        // Step 3. The id tables only take one writer each, so they are filled alongside the back references,
+        // which each shard adds to its own nodes in file order
+        pool.parallel_for(shard_count + 2, [&](size_t task) {
+            if (task == 0) {
+                nodes_by_id.reserve(nodes_by_id.size() + node_shards.back());
+                for (const auto &block: blocks) {
+                    for (const auto &node: block.nodes) nodes_by_id[node->id] = node;
+                }
+            } else if (task == 1) {
+                size_t way_count = 0;
+                for (const auto &block: blocks) way_count += block.ways.size();
+                ways_by_id.reserve(ways_by_id.size() + way_count);
+                for (const auto &block: blocks) {
+                    for (const auto &decoded: block.ways) ways_by_id[decoded.way->id] = decoded.way;
+                }
+            } else {
+                const auto shard = task - 2;
+                for (auto i = reference_shards[shard]; i < reference_shards[shard + 1]; ++i) {
+                    back_references[i].node->ways.insert(*back_references[i].way);
+                }
+            }
+        });
+        timings.lap("id tables");
+    }
+
+    std::shared_ptr<ObjectType::Object> AbstractDocument::get_object_by_id(int64_t id) const {
+        auto node_it = nodes_by_id.find(id);
+        if (node_it != nodes_by_id.end()) {
+            return node_it->second;
+        }
+        auto way_it = ways_by_id.find(id);
+        if (way_it != ways_by_id.end()) {
+            return way_it->second;
+        }
+        throw std::runtime_error("Object not found");
+    }
+
+    std::shared_ptr<ObjectType::Node> AbstractDocument::get_node_by_id(int64_t id) const {
+        auto it = nodes_by_id.find(id);
+        if (it == nodes_by_id.end()) {
+            throw std::runtime_error("Node not found");
+        }
+        return it->second;
+    }
+
+    std::shared_ptr<ObjectType::Way> AbstractDocument::get_way_by_id(int64_t id) const {
+        auto it = ways_by_id.find(id);
+        if (it == ways_by_id.end()) {
+            throw std::runtime_error("Way not found");
+        }
+        return it->second;
+    }
+}
@@ -4,8 +4,14 @@
 
 #ifndef ABSTRACTDOCUMENT_H
 #define ABSTRACTDOCUMENT_H
+#include <cstdint>
 #include <memory>
-#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "Geometry.h"
+#include "StageTimer.h"
+
 namespace Foliage::ObjectType {
     struct Node;  // Forward declaration of Node
     struct Way;   // Forward declaration of Way
@@ -13,19 +19,51 @@ namespace Foliage::ObjectType {
 }
 
 namespace Foliage::DataProvider {
+    /**
+     * A way as decoded by a data provider, with the ids of its nodes still to be resolved.
+     */
+    struct DecodedWay {
+        std::shared_ptr<ObjectType::Way> way;
+        std::vector<int64_t> refs;
+    };
+
+    /**
+     * The objects of one piece of the input (a PBF block, a range of the XML), in file order.
+     * Pieces are decoded independently, then AbstractDocument::link() puts them together.
+     */
+    struct DecodedBlock {
+        std::vector<std::shared_ptr<ObjectType::Node>> nodes;
+        std::vector<DecodedWay> ways;
+    };
+
     class AbstractDocument {
+    protected:
+        /**
+         * Shared tail of load(): fills the tables from the decoded blocks and resolves the way references.
+         * Works on hash shards of the node ids in parallel. When an id occurs more than once, the last
+         * object in block order wins. Ways may reference nodes from any block.
+         * @throws std::runtime_error If a way references a node that is in none of the blocks
+         */
+        void link(std::vector<DecodedBlock> &blocks);
+
     public:
-        std::map<int64_t, std::shared_ptr<ObjectType::Node>> nodes_by_id;
-        std::map<int64_t, std::shared_ptr<ObjectType::Way>> ways_by_id;
-        virtual void reset() = 0;
+        std::unordered_map<int64_t, std::shared_ptr<ObjectType::Node>> nodes_by_id;
+        std::unordered_map<int64_t, std::shared_ptr<ObjectType::Way>> ways_by_id;
+        Geometry::BoundingBox border;
+        // Wall-clock time of each stage of load() and parse()
+        Util::StageTimer timings;
+
+        AbstractDocument();
+
+        virtual void reset();
         virtual void load() = 0;
         virtual void parse() = 0;
-        [[nodiscard]] virtual std::shared_ptr<ObjectType::Object> get_object_by_id(int64_t id) const = 0;
+        [[nodiscard]] virtual std::shared_ptr<ObjectType::Object> get_object_by_id(int64_t id) const;
 
-        [[nodiscard]] virtual std::shared_ptr<ObjectType::Node> get_node_by_id(int64_t id) const = 0;
+        [[nodiscard]] virtual std::shared_ptr<ObjectType::Node> get_node_by_id(int64_t id) const;
 
-        [[nodiscard]] virtual std::shared_ptr<ObjectType::Way> get_way_by_id(int64_t id) const = 0;
-        virtual ~AbstractDocument() = default;
+        [[nodiscard]] virtual std::shared_ptr<ObjectType::Way> get_way_by_id(int64_t id) const;
+        virtual ~AbstractDocument();
     };
 }
 #endif //ABSTRACTDOCUMENT_H
@@ -0,0 +1,36 @@
+#include "BatchStream.h"
+
+#include <stdexcept>
+
+namespace Foliage::Util {
+    BatchStream::BatchStream(size_t expected): expected(expected) {
+    }
+
+    void BatchStream::push(std::string line, bool failed) {
+        {
+            std::lock_guard lock(mutex);
+            if (pushed == expected) throw std::logic_error("More lines than queries in the batch");
+            lines.push_back(std::move(line));
+            if (failed) ++this->failed;
+            if (++pushed == expected) finished = Clock::now();
+        }
+        pushed_cv.notify_all();
+    }
+
+    bool BatchStream::next(std::string &line) {
+        std::unique_lock lock(mutex);
+        pushed_cv.wait(lock, [&] { return !lines.empty() || taken == expected; });
+        if (lines.empty()) return false;
+        line = std::move(lines.front());
+        lines.pop_front();
+        ++taken;
+        return true;
+    }
+
+    BatchStream::Summary BatchStream::summary() {
+        std::unique_lock lock(mutex);
+        pushed_cv.wait(lock, [&] { return pushed == expected; });
+        const auto end = expected == 0 ? started : finished;
+        return {expected, failed, std::chrono::duration<double>(end - started).count()};
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef BATCHSTREAM_H
+#define BATCHSTREAM_H
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace Foliage::Util {
+    /**
+     * Lines of a batch answer, in the order their queries finish. Workers push one line per query, and
+     * the thread writing the response takes each as soon as it is pushed, so the first results go out
+     * while the rest of the batch is still running.
+     */
+    class BatchStream {
+    public:
+        struct Summary {
+            size_t queries;
+            size_t failed;
+            double seconds; // From construction until the last line was pushed
+        };
+
+        explicit BatchStream(size_t expected);
+
+        void push(std::string line, bool failed = false);
+
+        /**
+         * Blocks until a line is pushed.
+         * @return false, leaving `line` alone, once all the expected lines have been taken
+         */
+        bool next(std::string &line);
+
+        /**
+         * Blocks until every line is pushed.
+         */
+        [[nodiscard]] Summary summary();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        const size_t expected;
+        const Clock::time_point started = Clock::now();
+        std::mutex mutex;
+        std::condition_variable pushed_cv;
+        std::deque<std::string> lines;
+        size_t pushed = 0, taken = 0, failed = 0;
+        Clock::time_point finished;
+    };
+}
+
+#endif //BATCHSTREAM_H
@@ -0,0 +1,96 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace Foliage::Util {
+    /**
+     * Contiguous array that either owns its elements or views memory kept alive by another object,
+     * such as a mapped snapshot file. Views are read-only: any non-const access copies the elements
+     * into owned storage first, so const code never pays for the check.
+     */
+    template<class T>
+    class Buffer {
+        static_assert(std::is_trivially_copyable_v<T>, "Buffers are written and mapped as raw bytes");
+
+    public:
+        using value_type = T;
+        using iterator = T *;
+        using const_iterator = const T *;
+
+        Buffer() = default;
+
+        Buffer(std::vector<T> values): owned(std::move(values)) {
+        }
+
+        Buffer(std::initializer_list<T> values): owned(values) {
+        }
+
+        explicit Buffer(size_t count, const T &value = T()): owned(count, value) {
+        }
+
+        /**
+         * @param owner Keeps `data` alive for as long as any copy of the view exists
+         */
+        static Buffer view(const T *data, size_t size, std::shared_ptr<const void> owner) {
+            Buffer result;
+            result.view_data = data;
+            result.view_size = size;
+            result.owner = std::move(owner);
+            return result;
+        }
+
+        [[nodiscard]] bool is_view() const { return owner != nullptr; }
+
+        [[nodiscard]] size_t size() const { return owner ? view_size : owned.size(); }
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        [[nodiscard]] const T *data() const { return owner ? view_data : owned.data(); }
+        [[nodiscard]] const T *begin() const { return data(); }
+        [[nodiscard]] const T *end() const { return data() + size(); }
+        [[nodiscard]] const T &operator[](size_t index) const { return data()[index]; }
+        [[nodiscard]] const T &front() const { return data()[0]; }
+        [[nodiscard]] const T &back() const { return data()[size() - 1]; }
+
+        [[nodiscard]] T *data() { return own().data(); }
+        [[nodiscard]] T *begin() { return data(); }
+        [[nodiscard]] T *end() { return data() + size(); }
+        [[nodiscard]] T &operator[](size_t index) { return data()[index]; }
+
+        void resize(size_t count) { own().resize(count); }
+        void resize(size_t count, const T &value) { own().resize(count, value); }
+        void assign(size_t count, const T &value) { own().assign(count, value); }
+        void reserve(size_t count) { own().reserve(count); }
+        void push_back(const T &value) { own().push_back(value); }
+
+        void clear() {
+            owner.reset();
+            owned.clear();
+        }
+
+        template<class Iterator>
+        void append(Iterator first, Iterator last) {
+            auto &values = own();
+            values.insert(values.end(), first, last);
+        }
+
+    private:
+        std::vector<T> &own() {
+            if (owner) {
+                owned.assign(view_data, view_data + view_size);
+                owner.reset();
+            }
+            return owned;
+        }
+
+        std::vector<T> owned;
+        const T *view_data = nullptr;
+        size_t view_size = 0;
+        std::shared_ptr<const void> owner;
+    };
+}
+
+#endif //BUFFER_H
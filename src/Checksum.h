@@ -0,0 +1,43 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "Buffer.h"
+
+namespace Foliage::Util {
+    /**
+     * Fast 64-bit checksum for detecting corrupt or mismatched binary data; not cryptographic.
+     * Four independent lanes of multiply-rotate over 8-byte words, so it runs at memory speed.
+     */
+    inline uint64_t checksum(const void *data, size_t size, uint64_t seed = 0) {
+        constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull, prime2 = 0xC2B2AE3D27D4EB4Full;
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        uint64_t lanes[4] = {seed + prime1, seed + prime2, seed, seed - prime1};
+        size_t offset = 0;
+        for (; offset + 32 <= size; offset += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                uint64_t word;
+                std::memcpy(&word, bytes + offset + lane * 8, 8);
+                lanes[lane] = std::rotl(lanes[lane] + word * prime2, 31) * prime1;
+            }
+        }
+        uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) +
+                        std::rotl(lanes[3], 18) + size;
+        for (; offset < size; ++offset) {
+            hash = std::rotl(hash ^ (bytes[offset] * prime1), 11) * prime2;
+        }
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        return hash;
+    }
+
+    template<class T>
+    uint64_t checksum(const Buffer<T> &values, uint64_t seed = 0) {
+        return checksum(values.data(), values.size() * sizeof(T), seed);
+    }
+}
+
+#endif //CHECKSUM_H
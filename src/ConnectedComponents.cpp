@@ -0,0 +1,132 @@
+#include "ConnectedComponents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace Foliage::Graph {
+    namespace {
+        constexpr uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+
+        // Union-find root, halving the paths it walks
+        uint32_t find(std::vector<uint32_t> &parent, uint32_t node) {
+            while (parent[node] != node) {
+                parent[node] = parent[parent[node]];
+                node = parent[node];
+            }
+            return node;
+        }
+    }
+
+    ConnectedComponents ConnectedComponents::build(const RoutingGraph &graph, const std::vector<float> &weights) {
+        if (weights.size() != graph.edge_count()) {
+            throw std::invalid_argument("Expected one weight per edge");
+        }
+        const size_t node_count = graph.node_count();
+        ConnectedComponents result;
+        result.component.assign(node_count, unassigned);
+
+        // Tarjan's algorithm with an explicit stack, since a road can be longer than the call stack is deep.
+        // A node that was visited but has no component yet is still on `stack`
+        std::vector<uint32_t> index(node_count, unassigned), low(node_count);
+        std::vector<NodeIndex> stack, order; // `order` lists the nodes component by component
+        order.reserve(node_count);
+        struct Frame {
+            NodeIndex node;
+            EdgeIndex next_edge;
+        };
+        std::vector<Frame> calls;
+        uint32_t next_index = 0;
+        auto enter = [&](NodeIndex node) {
+            index[node] = low[node] = next_index++;
+            stack.push_back(node);
+            calls.push_back({node, graph.edges_begin(node)});
+        };
+        for (NodeIndex root = 0; root < node_count; ++root) {
+            if (index[root] != unassigned) continue;
+            enter(root);
+            while (!calls.empty()) {
+                auto &[node, next_edge] = calls.back();
+                if (next_edge < graph.edges_end(node)) {
+                    const auto edge = next_edge++;
+                    if (std::isinf(weights[edge])) continue;
+                    const auto target = graph.edge_targets[edge];
+                    if (index[target] == unassigned) enter(target);
+                    else if (result.component[target] == unassigned) low[node] = std::min(low[node], index[target]);
+                    continue;
+                }
+                const NodeIndex done = node;
+                calls.pop_back();
+                if (!calls.empty()) low[calls.back().node] = std::min(low[calls.back().node], low[done]);
+                if (low[done] != index[done]) continue;
+                const auto id = static_cast<uint32_t>(result.sizes.size());
+                uint32_t size = 0;
+                NodeIndex member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    result.component[member] = id;
+                    order.push_back(member);
+                    ++size;
+                } while (member != done);
+                result.sizes.push_back(size);
+            }
+        }
+        if (result.sizes.empty()) return result;
+        result.largest = static_cast<uint32_t>(std::ranges::max_element(result.sizes) - result.sizes.begin());
+
+        // Edges only lead to lower numbers, so walking the components upwards settles each one after everything
+        // it leads to, and downwards after everything that leads to it
+        result.reaches_largest.assign(result.size(), false);
+        result.reached_from_largest.assign(result.size(), false);
+        result.reaches_largest[result.largest] = result.reached_from_largest[result.largest] = true;
+        auto for_each_exit = [&](NodeIndex node, auto &&visit) {
+            for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                const auto target_component = result.component[graph.edge_targets[edge]];
+                if (!std::isinf(weights[edge]) && target_component != result.component[node]) visit(target_component);
+            }
+        };
+        for (const auto node: order) {
+            for_each_exit(node, [&](uint32_t target) {
+                if (result.reaches_largest[target]) result.reaches_largest[result.component[node]] = true;
+            });
+        }
+        for (auto node = order.rbegin(); node != order.rend(); ++node) {
+            if (!result.reached_from_largest[result.component[*node]]) continue;
+            for_each_exit(*node, [&](uint32_t target) { result.reached_from_largest[target] = true; });
+        }
+
+        // Islands ignore directions; a oneway joins its ends as much as any other road
+        result.island.resize(node_count);
+        for (NodeIndex node = 0; node < node_count; ++node) result.island[node] = node;
+        for (NodeIndex node = 0; node < node_count; ++node) {
+            for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                if (std::isinf(weights[edge])) continue;
+                const auto a = find(result.island, node), b = find(result.island, graph.edge_targets[edge]);
+                if (a != b) result.island[std::max(a, b)] = std::min(a, b);
+            }
+        }
+        for (NodeIndex node = 0; node < node_count; ++node) result.island[node] = find(result.island, node);
+        return result;
+    }
+
+    bool ConnectedComponents::may_reach(NodeIndex from, NodeIndex to) const {
+        const auto source = component[from], target = component[to];
+        if (source == target) return true;
+        if (island[from] != island[to]) return false;
+        if (source == largest) return reached_from_largest[target];
+        if (target == largest) return reaches_largest[source];
+        // Through the largest component, or maybe by a way around it
+        return true;
+    }
+
+    bool ConnectedComponents::may_reach(const std::vector<Endpoint> &sources,
+                                        const std::vector<Endpoint> &targets) const {
+        return std::ranges::any_of(sources, [&](const Endpoint &source) {
+            return std::ranges::any_of(targets, [&](const Endpoint &target) {
+                return may_reach(source.node, target.node);
+            });
+        });
+    }
+}
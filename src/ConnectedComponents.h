@@ -0,0 +1,46 @@
+#ifndef CONNECTEDCOMPONENTS_H
+#define CONNECTEDCOMPONENTS_H
+#include <cstdint>
+#include <vector>
+
+#include "RoutingGraph.h"
+
+namespace Foliage::Graph {
+    /**
+     * The strongly connected components of a graph under one set of edge weights, so that oneways count,
+     * and the weakly connected ones, its islands. Queries whose ends no route can join are told apart
+     * from the others in constant time, instead of by a search that runs out of nodes.
+     * Components are numbered sinks first, so no usable edge leads to a component of a higher number.
+     */
+    class ConnectedComponents {
+    public:
+        std::vector<uint32_t> component; // By node
+        std::vector<uint32_t> island; // By node: one node of its island, the same for all of them
+        std::vector<uint32_t> sizes; // Nodes, by component
+        // By component: whether a route leads from it into the largest one, or from the largest one to it
+        std::vector<bool> reaches_largest, reached_from_largest;
+        uint32_t largest = 0;
+
+        /**
+         * @param weights One weight per edge, infinity for edges that cannot be used
+         */
+        static ConnectedComponents build(const RoutingGraph &graph, const std::vector<float> &weights);
+
+        [[nodiscard]] size_t size() const { return sizes.size(); }
+
+        [[nodiscard]] bool in_largest(NodeIndex node) const { return component[node] == largest; }
+
+        /**
+         * @return False if no route leads from one node to the other. True does not promise one, but it
+         * does if the nodes share a component or one of them is in the largest
+         */
+        [[nodiscard]] bool may_reach(NodeIndex from, NodeIndex to) const;
+
+        /**
+         * @return False if no route leads from any of the sources to any of the targets
+         */
+        [[nodiscard]] bool may_reach(const std::vector<Endpoint> &sources, const std::vector<Endpoint> &targets) const;
+    };
+}
+
+#endif //CONNECTEDCOMPONENTS_H
@@ -0,0 +1,481 @@
+#include "ContractionHierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+#include "ThreadPool.h"
+
+namespace Foliage::Graph {
+    namespace {
+        constexpr float infinity = std::numeric_limits<float>::infinity();
+        constexpr size_t nodes_per_block = 256;
+        // Witness searches give up after settling this many nodes or following this many arcs.
+        // A missed witness only costs a redundant shortcut. Priorities only need an estimate.
+        struct SearchLimits {
+            size_t settled;
+            size_t hops;
+        };
+
+        constexpr SearchLimits simulation_limits{64, 3};
+        constexpr SearchLimits contraction_limits{512, 8};
+
+        enum State : uint8_t { Active, Contracting, Contracted };
+
+        using Arc = ContractionHierarchy::Arc;
+        using Arcs = std::vector<Arc>;
+
+        struct Shortcut {
+            NodeIndex from, to;
+            float weight;
+            NodeIndex middle;
+        };
+
+        // Keeps one arc per target, the cheapest
+        void add_arc(Arcs &arcs, NodeIndex target, float weight, NodeIndex middle) {
+            for (auto &arc: arcs) {
+                if (arc.target == target) {
+                    if (weight < arc.weight) arc = {target, weight, middle};
+                    return;
+                }
+            }
+            arcs.push_back({target, weight, middle});
+        }
+
+        // Scrambles node indices so that ties in priority do not follow the id order of the input
+        uint32_t tie_breaker(NodeIndex node) {
+            uint32_t x = node * 0x9E3779B1u;
+            x ^= x >> 16;
+            return x * 0x85EBCA6Bu;
+        }
+
+        // Dijkstra over the active nodes until every target is settled or a limit is hit.
+        // Kept per thread and reset through `touched`
+        class WitnessSearch {
+        public:
+            void run(const std::vector<Arcs> &out, const std::vector<uint8_t> &state, NodeIndex source,
+                     NodeIndex avoid, const Arcs &targets, float max_distance, SearchLimits limits) {
+                if (distances.size() != out.size()) {
+                    distances.assign(out.size(), infinity);
+                    hops.assign(out.size(), 0);
+                    is_target.assign(out.size(), 0);
+                }
+                for (const auto node: touched) distances[node] = infinity;
+                touched.clear();
+                heap.clear();
+                size_t unsettled_targets = 0;
+                for (const auto &arc: targets) {
+                    if (arc.target != source && state[arc.target] == Active && !is_target[arc.target]) {
+                        is_target[arc.target] = 1;
+                        ++unsettled_targets;
+                    }
+                }
+
+                distances[source] = 0;
+                hops[source] = 0;
+                touched.push_back(source);
+                heap.emplace_back(0.0f, source);
+                for (size_t settled = 0; !heap.empty() && settled < limits.settled && unsettled_targets; ++settled) {
+                    std::ranges::pop_heap(heap, std::greater<>());
+                    const auto [distance, node] = heap.back();
+                    heap.pop_back();
+                    if (distance > distances[node]) continue;
+                    if (distance > max_distance) break;
+                    if (is_target[node]) --unsettled_targets;
+                    if (hops[node] >= limits.hops) continue;
+                    for (const auto &arc: out[node]) {
+                        if (arc.target == avoid || state[arc.target] != Active) continue;
+                        const float candidate = distance + arc.weight;
+                        if (candidate < distances[arc.target]) {
+                            if (distances[arc.target] == infinity) touched.push_back(arc.target);
+                            distances[arc.target] = candidate;
+                            hops[arc.target] = hops[node] + 1;
+                            heap.emplace_back(candidate, arc.target);
+                            std::ranges::push_heap(heap, std::greater<>());
+                        }
+                    }
+                }
+                for (const auto &arc: targets) is_target[arc.target] = 0;
+            }
+
+            [[nodiscard]] float distance(NodeIndex node) const { return distances[node]; }
+
+        private:
+            using Entry = std::pair<float, NodeIndex>;
+            std::vector<float> distances;
+            std::vector<NodeIndex> touched;
+            std::vector<uint8_t> is_target;
+            std::vector<uint8_t> hops;
+            std::vector<Entry> heap; // Min-heap, reused between searches
+        };
+
+        // Labels and heaps of both sides of a query, dense over the nodes. Kept per thread and reset through `touched`,
+        // so a query allocates nothing for its search once the thread has served one on a graph that large
+        struct QuerySearch {
+            struct Label {
+                float distance = infinity;
+                NodeIndex parent = invalid_node;
+                NodeIndex middle = invalid_node;
+            };
+
+            using Entry = std::pair<float, NodeIndex>;
+            std::vector<Label> labels[2];
+            std::vector<NodeIndex> touched[2];
+            std::vector<Entry> heaps[2]; // Min-heaps
+
+            void reset(size_t nodes) {
+                for (int side = 0; side < 2; ++side) {
+                    if (labels[side].size() != nodes) {
+                        labels[side].assign(nodes, Label{});
+                    } else {
+                        for (const auto node: touched[side]) labels[side][node] = Label{};
+                    }
+                    touched[side].clear();
+                    heaps[side].clear();
+                }
+            }
+
+            void label(int side, NodeIndex node, Label label) {
+                if (labels[side][node].distance == infinity) touched[side].push_back(node);
+                labels[side][node] = label;
+                heaps[side].emplace_back(label.distance, node);
+                std::ranges::push_heap(heaps[side], std::greater<>());
+            }
+
+            // Runs the search of one side until its heap is empty, calling settle(node, distance) for every node
+            // it settles without being stalled. Side 0 follows the up arcs, side 1 the down arcs
+            template<typename F>
+            void exhaust(const ContractionHierarchy &hierarchy, int side, std::span<const Endpoint> endpoints,
+                         F &&settle) {
+                const auto &offsets = side == 0 ? hierarchy.up_offsets : hierarchy.down_offsets;
+                const auto &arcs = side == 0 ? hierarchy.up_arcs : hierarchy.down_arcs;
+                const auto &stall_offsets = side == 0 ? hierarchy.down_offsets : hierarchy.up_offsets;
+                const auto &stall_arcs = side == 0 ? hierarchy.down_arcs : hierarchy.up_arcs;
+                auto &heap = heaps[side];
+                auto &side_labels = labels[side];
+                for (const auto &[node, cost]: endpoints) {
+                    if (cost < side_labels[node].distance) label(side, node, {cost, invalid_node, invalid_node});
+                }
+                while (!heap.empty()) {
+                    std::ranges::pop_heap(heap, std::greater<>());
+                    const auto [key, node] = heap.back();
+                    heap.pop_back();
+                    if (key > side_labels[node].distance) continue;
+                    bool stalled = false;
+                    for (auto e = stall_offsets[node]; e < stall_offsets[node + 1] && !stalled; ++e) {
+                        stalled = side_labels[stall_arcs[e].target].distance + stall_arcs[e].weight < key;
+                    }
+                    if (stalled) continue;
+                    settle(node, key);
+                    for (auto e = offsets[node]; e < offsets[node + 1]; ++e) {
+                        const auto &arc = arcs[e];
+                        if (key + arc.weight < side_labels[arc.target].distance) {
+                            label(side, arc.target, {key + arc.weight, node, arc.middle});
+                        }
+                    }
+                }
+            }
+        };
+
+        // Calls emit(shortcut) for every pair of neighbors that has no witness path avoiding `node`
+        template<typename F>
+        void find_shortcuts(NodeIndex node, const std::vector<Arcs> &out, const std::vector<Arcs> &in,
+                            const std::vector<uint8_t> &state, SearchLimits limits, F &&emit) {
+            float max_outgoing = 0;
+            for (const auto &arc: out[node]) {
+                if (state[arc.target] == Active) max_outgoing = std::max(max_outgoing, arc.weight);
+            }
+            thread_local WitnessSearch search;
+            for (const auto &incoming: in[node]) {
+                const auto source = incoming.target;
+                if (state[source] != Active) continue;
+                search.run(out, state, source, node, out[node], incoming.weight + max_outgoing, limits);
+                for (const auto &outgoing: out[node]) {
+                    if (outgoing.target == source || state[outgoing.target] != Active) continue;
+                    const float via = incoming.weight + outgoing.weight;
+                    if (search.distance(outgoing.target) > via) emit(Shortcut{source, outgoing.target, via, node});
+                }
+            }
+        }
+
+        // Edge difference plus the number of already contracted neighbors, which spreads contraction evenly
+        int64_t compute_priority(NodeIndex node, const std::vector<Arcs> &out, const std::vector<Arcs> &in,
+                                 const std::vector<uint8_t> &state, const std::vector<uint32_t> &deleted_neighbors) {
+            int64_t shortcuts = 0, degree = 0;
+            find_shortcuts(node, out, in, state, simulation_limits, [&](const Shortcut &) { ++shortcuts; });
+            for (const auto &arc: out[node]) degree += state[arc.target] == Active;
+            for (const auto &arc: in[node]) degree += state[arc.target] == Active;
+            return shortcuts - degree + deleted_neighbors[node];
+        }
+
+        void flatten(const std::vector<Arcs> &lists, Util::Buffer<EdgeIndex> &offsets, Util::Buffer<Arc> &arcs) {
+            offsets.assign(lists.size() + 1, 0);
+            for (size_t u = 0; u < lists.size(); ++u) offsets[u + 1] = offsets[u] + lists[u].size();
+            arcs.reserve(offsets.back());
+            for (const auto &list: lists) arcs.append(list.begin(), list.end());
+        }
+    }
+
+    ContractionHierarchy ContractionHierarchy::build(const RoutingGraph &graph, const ProfileWeights &weights) {
+        ContractionHierarchy hierarchy;
+        hierarchy.profile = weights.profile.name;
+        hierarchy.weights_checksum = weights.checksum;
+        auto &pool = Util::ThreadPool::shared();
+        const size_t n = graph.node_count();
+        auto for_each_index = [&](size_t count, auto &&body) {
+            pool.parallel_for((count + nodes_per_block - 1) / nodes_per_block, [&](size_t block) {
+                const size_t end = std::min(count, (block + 1) * nodes_per_block);
+                for (size_t i = block * nodes_per_block; i < end; ++i) body(i);
+            });
+        };
+
+        // Step 1. Usable edges as arc lists in both directions, one arc per neighbor
+        std::vector<Arcs> out(n), in(n);
+        for_each_index(n, [&](size_t u) {
+            for (auto edge = graph.edges_begin(u); edge < graph.edges_end(u); ++edge) {
+                const auto v = graph.edge_targets[edge];
+                if (v != u && std::isfinite(weights[edge])) add_arc(out[u], v, weights[edge], invalid_node);
+                // Edges are sorted by target, so the edges back from v are found by binary search
+                const auto first = graph.edge_targets.begin() + graph.edges_begin(v);
+                const auto last = graph.edge_targets.begin() + graph.edges_end(v);
+                for (auto it = std::lower_bound(first, last, u); it != last && *it == u; ++it) {
+                    const auto back = static_cast<EdgeIndex>(it - graph.edge_targets.begin());
+                    if (v != u && std::isfinite(weights[back])) add_arc(in[u], v, weights[back], invalid_node);
+                }
+            }
+        });
+
+        std::vector<uint8_t> state(n, Active);
+        std::vector<uint32_t> deleted_neighbors(n, 0);
+        std::vector<int64_t> priority(n);
+        for_each_index(n, [&](size_t v) { priority[v] = compute_priority(v, out, in, state, deleted_neighbors); });
+        auto precedes = [&](NodeIndex a, NodeIndex b) {
+            return std::tuple(priority[a], tie_breaker(a), a) < std::tuple(priority[b], tie_breaker(b), b);
+        };
+
+        std::vector<Arcs> up(n), down(n);
+        hierarchy.rank.assign(n, 0);
+        uint32_t next_rank = 0;
+        std::vector<NodeIndex> remaining(n);
+        std::iota(remaining.begin(), remaining.end(), 0);
+        std::vector<uint8_t> is_neighbor(n, 0);
+        while (!remaining.empty()) {
+            // Step 2. Independent set: every node that precedes all of its active neighbors
+            std::vector<uint8_t> is_selected(remaining.size());
+            for_each_index(remaining.size(), [&](size_t i) {
+                const auto v = remaining[i];
+                bool minimal = true;
+                for (const auto *arcs: {&out[v], &in[v]}) {
+                    for (const auto &arc: *arcs) {
+                        if (state[arc.target] == Active && precedes(arc.target, v)) minimal = false;
+                    }
+                }
+                is_selected[i] = minimal;
+            });
+            std::vector<NodeIndex> selected, next_remaining;
+            for (size_t i = 0; i < remaining.size(); ++i) {
+                (is_selected[i] ? selected : next_remaining).push_back(remaining[i]);
+            }
+            for (const auto v: selected) state[v] = Contracting;
+
+            // Step 3. Shortcuts for the whole set, searched on the graph without any of its nodes
+            const size_t blocks = (selected.size() + nodes_per_block - 1) / nodes_per_block;
+            std::vector<std::vector<Shortcut>> shortcuts(blocks);
+            pool.parallel_for(blocks, [&](size_t block) {
+                const size_t end = std::min(selected.size(), (block + 1) * nodes_per_block);
+                for (size_t i = block * nodes_per_block; i < end; ++i) {
+                    const auto v = selected[i];
+                    find_shortcuts(v, out, in, state, contraction_limits, [&](const Shortcut &shortcut) {
+                        shortcuts[block].push_back(shortcut);
+                    });
+                    // Whatever is still active will be contracted later, so these arcs all lead upward
+                    for (const auto &arc: out[v]) if (state[arc.target] == Active) up[v].push_back(arc);
+                    for (const auto &arc: in[v]) if (state[arc.target] == Active) down[v].push_back(arc);
+                }
+            });
+            for (const auto v: selected) {
+                state[v] = Contracted;
+                hierarchy.rank[v] = next_rank++;
+                out[v] = {};
+                in[v] = {};
+            }
+            for (const auto &block: shortcuts) {
+                for (const auto &[from, to, weight, middle]: block) {
+                    add_arc(out[from], to, weight, middle);
+                    add_arc(in[to], from, weight, middle);
+                }
+            }
+
+            // Step 4. Neighbors lose their arcs into the set and get a new priority
+            std::vector<NodeIndex> neighbors;
+            for (const auto v: selected) {
+                for (const auto *arcs: {&up[v], &down[v]}) {
+                    for (const auto &arc: *arcs) {
+                        ++deleted_neighbors[arc.target];
+                        if (!is_neighbor[arc.target]) {
+                            is_neighbor[arc.target] = 1;
+                            neighbors.push_back(arc.target);
+                        }
+                    }
+                }
+            }
+            for_each_index(neighbors.size(), [&](size_t i) {
+                const auto x = neighbors[i];
+                std::erase_if(out[x], [&](const Arc &arc) { return state[arc.target] == Contracted; });
+                std::erase_if(in[x], [&](const Arc &arc) { return state[arc.target] == Contracted; });
+            });
+            for_each_index(neighbors.size(), [&](size_t i) {
+                priority[neighbors[i]] = compute_priority(neighbors[i], out, in, state, deleted_neighbors);
+            });
+            for (const auto x: neighbors) is_neighbor[x] = 0;
+            remaining.swap(next_remaining);
+        }
+
+        flatten(up, hierarchy.up_offsets, hierarchy.up_arcs);
+        flatten(down, hierarchy.down_offsets, hierarchy.down_arcs);
+        return hierarchy;
+    }
+
+    size_t ContractionHierarchy::shortcut_count() const {
+        auto is_shortcut = [](const Arc &arc) { return arc.middle != invalid_node; };
+        return std::ranges::count_if(up_arcs, is_shortcut) + std::ranges::count_if(down_arcs, is_shortcut);
+    }
+
+    std::vector<NodeIndex> ContractionHierarchy::shortest_path(NodeIndex source, NodeIndex target,
+                                                               float *distance) const {
+        const Endpoint sources[] = {{source, 0}}, targets[] = {{target, 0}};
+        return shortest_path(sources, targets, distance);
+    }
+
+    std::vector<NodeIndex> ContractionHierarchy::shortest_path(std::span<const Endpoint> sources,
+                                                               std::span<const Endpoint> targets,
+                                                               float *distance) const {
+        // Index 0 searches up from the source, index 1 searches up from the target against the arc direction.
+        // The labels are reused by every query of the thread
+        thread_local QuerySearch search;
+        auto &labels = search.labels;
+        auto &heaps = search.heaps;
+        search.reset(node_count());
+        const Util::Buffer<EdgeIndex> *offsets[2] = {&up_offsets, &down_offsets};
+        const Util::Buffer<Arc> *arcs[2] = {&up_arcs, &down_arcs};
+        const std::span<const Endpoint> endpoints[2] = {sources, targets};
+        for (int side = 0; side < 2; ++side) {
+            for (const auto &[node, cost]: endpoints[side]) {
+                if (cost >= labels[side][node].distance) continue;
+                search.label(side, node, {cost, invalid_node, invalid_node});
+            }
+        }
+
+        float best = infinity;
+        NodeIndex meeting = invalid_node;
+        while (!heaps[0].empty() || !heaps[1].empty()) {
+            const int side = heaps[1].empty() || (!heaps[0].empty() && heaps[0].front() < heaps[1].front()) ? 0 : 1;
+            const auto [key, node] = heaps[side].front();
+            // Both searches only go up, so nothing cheaper than `best` can be found past this point
+            if (key >= best) break;
+            std::ranges::pop_heap(heaps[side], std::greater<>());
+            heaps[side].pop_back();
+            if (key > labels[side][node].distance) continue;
+            if (key + labels[1 - side][node].distance < best) {
+                best = key + labels[1 - side][node].distance;
+                meeting = node;
+            }
+            // Stall-on-demand: a higher node already reached this one more cheaply, so its arcs cannot help
+            bool stalled = false;
+            for (auto e = (*offsets[1 - side])[node]; e < (*offsets[1 - side])[node + 1] && !stalled; ++e) {
+                const auto &arc = (*arcs[1 - side])[e];
+                stalled = labels[side][arc.target].distance + arc.weight < key;
+            }
+            if (stalled) continue;
+            for (auto e = (*offsets[side])[node]; e < (*offsets[side])[node + 1]; ++e) {
+                const auto &arc = (*arcs[side])[e];
+                const float candidate = key + arc.weight;
+                if (candidate < labels[side][arc.target].distance) {
+                    search.label(side, arc.target, {candidate, node, arc.middle});
+                }
+            }
+        }
+        if (distance) *distance = best;
+        if (meeting == invalid_node) return {};
+
+        std::vector<std::tuple<NodeIndex, NodeIndex, NodeIndex>> upward; // (from, to, middle) from meeting down to source
+        for (auto node = meeting; labels[0][node].parent != invalid_node; node = labels[0][node].parent) {
+            upward.emplace_back(labels[0][node].parent, node, labels[0][node].middle);
+        }
+        std::vector<NodeIndex> path{upward.empty() ? meeting : std::get<0>(upward.back())};
+        for (auto it = upward.rbegin(); it != upward.rend(); ++it) {
+            unpack(std::get<0>(*it), std::get<1>(*it), std::get<2>(*it), path);
+        }
+        for (auto node = meeting; labels[1][node].parent != invalid_node; node = labels[1][node].parent) {
+            unpack(node, labels[1][node].parent, labels[1][node].middle, path);
+        }
+        return path;
+    }
+
+    std::vector<float> ContractionHierarchy::distance_table(std::span<const std::vector<Endpoint>> sources,
+                                                            std::span<const std::vector<Endpoint>> targets) const {
+        struct BucketEntry {
+            uint32_t target;
+            float cost; // From the bucket's node to the target
+        };
+        // What each target's search settled, then gathered into one bucket per node, target by target
+        std::vector<std::vector<std::pair<NodeIndex, float>>> settled(targets.size());
+        Util::ThreadPool::shared().parallel_for(targets.size(), [&](size_t target) {
+            thread_local QuerySearch search;
+            search.reset(node_count());
+            search.exhaust(*this, 1, targets[target], [&](NodeIndex node, float cost) {
+                settled[target].emplace_back(node, cost);
+            });
+        });
+        // Every target can leave an entry at every node, so the counts can pass 2^32 on a large table
+        std::vector<size_t> bucket_offsets(node_count() + 1, 0);
+        for (const auto &nodes: settled) {
+            for (const auto &[node, cost]: nodes) ++bucket_offsets[node + 1];
+        }
+        std::partial_sum(bucket_offsets.begin(), bucket_offsets.end(), bucket_offsets.begin());
+        std::vector<BucketEntry> buckets(bucket_offsets.back());
+        {
+            auto next = bucket_offsets;
+            for (uint32_t target = 0; target < targets.size(); ++target) {
+                for (const auto &[node, cost]: settled[target]) buckets[next[node]++] = {target, cost};
+            }
+            settled.clear();
+        }
+
+        std::vector<float> costs(sources.size() * targets.size(), infinity);
+        Util::ThreadPool::shared().parallel_for(sources.size(), [&](size_t source) {
+            thread_local QuerySearch search;
+            search.reset(node_count());
+            float *row = costs.data() + source * targets.size();
+            search.exhaust(*this, 0, sources[source], [&](NodeIndex node, float cost) {
+                for (auto i = bucket_offsets[node]; i < bucket_offsets[node + 1]; ++i) {
+                    row[buckets[i].target] = std::min(row[buckets[i].target], cost + buckets[i].cost);
+                }
+            });
+        });
+        return costs;
+    }
+
+    void ContractionHierarchy::unpack(NodeIndex from, NodeIndex to, NodeIndex middle,
+                                      std::vector<NodeIndex> &path) const {
+        if (middle == invalid_node) {
+            path.push_back(to);
+            return;
+        }
+        // The bypassed node was contracted first: from -> middle is stored at middle as a down arc,
+        // middle -> to as an up arc
+        const auto find = [&](const Util::Buffer<EdgeIndex> &offsets, const Util::Buffer<Arc> &list, NodeIndex target) {
+            const auto first = list.begin() + offsets[middle];
+            const auto last = list.begin() + offsets[middle + 1];
+            const auto it = std::find_if(first, last, [&](const Arc &arc) { return arc.target == target; });
+            if (it == last) throw std::logic_error("Shortcut without its halves");
+            return *it;
+        };
+        unpack(from, middle, find(down_offsets, down_arcs, from).middle, path);
+        unpack(middle, to, find(up_offsets, up_arcs, to).middle, path);
+    }
+}
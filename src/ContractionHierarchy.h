@@ -0,0 +1,78 @@
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Buffer.h"
+#include "RoutingGraph.h"
+#include "RoutingProfile.h"
+
+namespace Foliage::Graph {
+    /**
+     * Contraction hierarchy over the weights of one profile.
+     * Nodes are contracted in rounds of independent sets, lowest edge difference first, and
+     * shortcuts are added wherever a witness search finds no path that avoids the contracted node.
+     * Queries search upward from both ends, so only arcs towards more important nodes are kept.
+     */
+    class ContractionHierarchy {
+    public:
+        struct Arc {
+            NodeIndex target;
+            float weight;
+            NodeIndex middle; // Node bypassed by a shortcut, invalid_node for an original edge
+        };
+
+        std::string profile;
+        uint64_t weights_checksum = 0; // Of the profile weights the hierarchy was contracted with
+        Util::Buffer<uint32_t> rank; // Contraction order, higher is more important
+
+        // Arcs u -> target with rank[target] > rank[u], for the search from the source
+        Util::Buffer<EdgeIndex> up_offsets;
+        Util::Buffer<Arc> up_arcs;
+        // Arcs target -> u with rank[target] > rank[u], stored at u, for the search from the target
+        Util::Buffer<EdgeIndex> down_offsets;
+        Util::Buffer<Arc> down_arcs;
+
+        /**
+         * Contracts the whole graph. Witness searches and priority updates run on the shared thread pool.
+         */
+        static ContractionHierarchy build(const RoutingGraph &graph, const ProfileWeights &weights);
+
+        [[nodiscard]] size_t node_count() const { return rank.size(); }
+
+        [[nodiscard]] size_t shortcut_count() const;
+
+        /**
+         * Bidirectional upward search with shortcuts unpacked.
+         * @return The nodes of the cheapest path from source to target, empty if there is none
+         */
+        [[nodiscard]] std::vector<NodeIndex> shortest_path(NodeIndex source, NodeIndex target,
+                                                           float *distance = nullptr) const;
+
+        /**
+         * Same search, started from several sources and targets at once, each with an initial cost.
+         * @return The nodes of the cheapest path from one of the sources to one of the targets
+         */
+        [[nodiscard]] std::vector<NodeIndex> shortest_path(std::span<const Endpoint> sources,
+                                                           std::span<const Endpoint> targets,
+                                                           float *distance = nullptr) const;
+
+        /**
+         * Costs between every source and every target, with buckets: an upward search against the arcs from
+         * each target leaves its cost at every node it settles, and an upward search from each source picks
+         * them up. The searches run on the shared thread pool.
+         * @param sources The endpoints of every source, as shortest_path takes them
+         * @return costs[s * targets.size() + t], infinity where there is no path
+         */
+        [[nodiscard]] std::vector<float> distance_table(std::span<const std::vector<Endpoint>> sources,
+                                                        std::span<const std::vector<Endpoint>> targets) const;
+
+    private:
+        // Appends the nodes after `from` on the arc from -> to, expanding shortcuts recursively
+        void unpack(NodeIndex from, NodeIndex to, NodeIndex middle, std::vector<NodeIndex> &path) const;
+    };
+}
+
+#endif //CONTRACTIONHIERARCHY_H
@@ -0,0 +1,131 @@
+#include "ContractionHierarchyPathfinder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "ThreadPool.h"
+
+namespace Foliage::Pathfinder {
+    std::vector<std::shared_ptr<const ObjectType::Node> > ContractionHierarchyPathfinder::get_path(
+        Geometry::Position start,
+        Geometry::Position end,
+        std::map<std::string, std::string> preferences
+    ) {
+        return get_path(start, end, preferences, nullptr);
+    }
+
+    std::vector<std::shared_ptr<const ObjectType::Node> > ContractionHierarchyPathfinder::get_path(
+        Geometry::Position start,
+        Geometry::Position end,
+        const std::map<std::string, std::string> &preferences,
+        bool *relocated
+    ) {
+        if (relocated) *relocated = false;
+        if (!astar || !astar->graph) throw std::runtime_error("No map loaded");
+        const auto profile = Graph::RoutingProfile::from_preferences(preferences);
+        const auto it = hierarchies.find(profile.name);
+        if (it == hierarchies.end()) return astar->get_path(start, end, preferences, relocated);
+
+        const auto weights = astar->profiles->get(preferences);
+        const auto terminals = astar->locate(start, end, *weights, astar->snap_distance(preferences));
+        if (!terminals) {
+            std::cerr << "Start or goal node not found on highways.\n";
+            return {};
+        }
+        if (relocated) *relocated = terminals->relocated;
+        if (terminals->direct) return astar->make_path(*terminals, {});
+        LayeredAStarPathfinder::require_route(*terminals, *weights);
+
+        const auto nodes = it->second->shortest_path(terminals->sources, terminals->targets);
+        if (nodes.empty()) {
+            std::cerr << "No solution\n";
+            return {};
+        }
+        return astar->make_path(*terminals, nodes);
+    }
+
+    std::vector<float> ContractionHierarchyPathfinder::table(const std::vector<Geometry::Position> &sources,
+                                                             const std::vector<Geometry::Position> &targets,
+                                                             const std::map<std::string, std::string> &preferences) {
+        require_table_size(sources.size(), targets.size());
+        if (!astar || !astar->graph) throw std::runtime_error("No map loaded");
+        const auto profile = Graph::RoutingProfile::from_preferences(preferences);
+        const auto it = hierarchies.find(profile.name);
+        if (it == hierarchies.end()) {
+            throw std::invalid_argument("No contraction hierarchy for profile " + profile.name);
+        }
+        const auto weights = astar->profiles->get(preferences);
+        const double max_distance = astar->snap_distance(preferences);
+
+        // Snapped like the ends of a query, onto segments if there is an index. Points off the network get no endpoints
+        struct Snapped {
+            std::optional<Graph::EdgePoint> point;
+            std::vector<Graph::Endpoint> endpoints;
+        };
+        auto snap_all = [&](const std::vector<Geometry::Position> &positions, bool departing) {
+            std::vector<Snapped> snapped(positions.size());
+            Util::ThreadPool::shared().parallel_for(positions.size(), [&](size_t i) {
+                if (!astar->segments) {
+                    const auto node = astar->snap(positions[i], weights.get(), max_distance);
+                    if (node != Graph::invalid_node) snapped[i].endpoints = {{node, 0}};
+                    return;
+                }
+                snapped[i].point = astar->segments->nearest(*astar->graph, positions[i], max_distance, *weights);
+                if (!snapped[i].point) return;
+                snapped[i].endpoints = departing
+                                           ? snapped[i].point->departures(*weights)
+                                           : snapped[i].point->arrivals(*weights);
+            });
+            return snapped;
+        };
+        const auto snapped_sources = snap_all(sources, true), snapped_targets = snap_all(targets, false);
+
+        auto endpoints_of = [](const std::vector<Snapped> &snapped) {
+            std::vector<std::vector<Graph::Endpoint> > endpoints;
+            endpoints.reserve(snapped.size());
+            for (const auto &point: snapped) endpoints.push_back(point.endpoints);
+            return endpoints;
+        };
+        auto costs = it->second->distance_table(endpoints_of(snapped_sources), endpoints_of(snapped_targets));
+
+        // A source and a target on one segment may also go straight along it, as get_path would
+        for (size_t s = 0; s < sources.size(); ++s) {
+            const auto &start = snapped_sources[s].point;
+            if (!start) continue;
+            for (size_t t = 0; t < targets.size(); ++t) {
+                const auto &goal = snapped_targets[t].point;
+                if (!goal || goal->forward != start->forward) continue;
+                const auto edge = start->fraction <= goal->fraction ? start->forward : start->backward;
+                const float direct = static_cast<float>(std::abs(goal->fraction - start->fraction) * (*weights)[edge]);
+                if (std::isfinite(direct)) {
+                    costs[s * targets.size() + t] = std::min(costs[s * targets.size() + t], direct);
+                }
+            }
+        }
+        return costs;
+    }
+
+    void ContractionHierarchyPathfinder::require_table_size(size_t sources, size_t targets) {
+        if (sources > max_table_points || targets > max_table_points) {
+            throw std::invalid_argument("A matrix has at most " + std::to_string(max_table_points) +
+                                        " sources and as many targets");
+        }
+    }
+
+    void ContractionHierarchyPathfinder::build(const std::vector<std::map<std::string, std::string> > &profiles,
+                                               const Hierarchies &prebuilt) {
+        if (!astar || !astar->graph || !astar->profiles) throw std::runtime_error("No map loaded");
+        hierarchies.clear();
+        for (const auto &preferences: profiles) {
+            const auto weights = astar->profiles->get(preferences);
+            if (const auto it = prebuilt.find(weights->profile.name);
+                it != prebuilt.end() && it->second->weights_checksum == weights->checksum) {
+                hierarchies[weights->profile.name] = it->second;
+                continue;
+            }
+            hierarchies[weights->profile.name] = std::make_shared<const Graph::ContractionHierarchy>(
+                Graph::ContractionHierarchy::build(*astar->graph, *weights));
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef CONTRACTIONHIERARCHYPATHFINDER_H
+#define CONTRACTIONHIERARCHYPATHFINDER_H
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AbstractPathfinder.h"
+#include "ContractionHierarchy.h"
+#include "LayeredAStarPathfinder.h"
+
+namespace Foliage::Pathfinder {
+    /**
+     * Answers queries from precomputed contraction hierarchies, one per profile.
+     * Queries for a profile without a hierarchy go to the A* pathfinder, which also does the snapping.
+     */
+    class ContractionHierarchyPathfinder : public AbstractPathfinder {
+    public:
+        explicit ContractionHierarchyPathfinder(std::shared_ptr<LayeredAStarPathfinder> astar = nullptr):
+            astar(astar) {
+        }
+
+        std::vector<std::shared_ptr<const ObjectType::Node> > get_path(
+            Geometry::Position start,
+            Geometry::Position end,
+            std::map<std::string, std::string> preferences
+        ) override;
+
+        /**
+         * @param relocated When given, set to whether the ends moved into the largest component, as with A*
+         */
+        std::vector<std::shared_ptr<const ObjectType::Node> > get_path(
+            Geometry::Position start,
+            Geometry::Position end,
+            const std::map<std::string, std::string> &preferences,
+            bool *relocated
+        );
+
+        // Most sources, and most targets, of one table. Each target keeps what its search settled until the
+        // table is done, so the sides are bounded on their own rather than only by their product
+        static constexpr size_t max_table_points = 2048;
+
+        /**
+         * @throws std::invalid_argument If either side has more than max_table_points points
+         */
+        static void require_table_size(size_t sources, size_t targets);
+
+        /**
+         * Route costs from every source to every target under the profile of `preferences`. Every point is
+         * snapped once, then the hierarchy fills the whole table with one search per point.
+         * @return costs[s * targets.size() + t], infinity where there is no route or a point is off the network
+         * @throws std::invalid_argument If the profile has no hierarchy, or the table is too large
+         */
+        std::vector<float> table(const std::vector<Geometry::Position> &sources,
+                                 const std::vector<Geometry::Position> &targets,
+                                 const std::map<std::string, std::string> &preferences);
+
+        using Hierarchies = std::map<std::string, std::shared_ptr<const Graph::ContractionHierarchy>, std::less<> >;
+
+        /**
+         * Contracts the graph of the A* pathfinder for each of the given profiles, replacing any earlier hierarchies.
+         * @param prebuilt Hierarchies by profile name, e.g. from a snapshot, reused if their weights still match
+         */
+        void build(const std::vector<std::map<std::string, std::string> > &profiles, const Hierarchies &prebuilt = {});
+
+        std::shared_ptr<LayeredAStarPathfinder> astar;
+        Hierarchies hierarchies; // By profile name
+    };
+}
+
+#endif //CONTRACTIONHIERARCHYPATHFINDER_H
@@ -0,0 +1,135 @@
+#include "FlatQuadTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace Foliage::Util {
+    namespace {
+        // Spreads the 32 bits of `value` over the even bits of the result
+        uint64_t spread_bits(uint64_t value) {
+            value = (value | value << 16) & 0x0000FFFF0000FFFFull;
+            value = (value | value << 8) & 0x00FF00FF00FF00FFull;
+            value = (value | value << 4) & 0x0F0F0F0F0F0F0F0Full;
+            value = (value | value << 2) & 0x3333333333333333ull;
+            value = (value | value << 1) & 0x5555555555555555ull;
+            return value;
+        }
+
+        // Latitude takes the odd bits, so the two bits of a level number the quadrants SW, SE, NW, NE
+        uint64_t morton_key(uint32_t x, uint32_t y) {
+            return spread_bits(y) << 1 | spread_bits(x);
+        }
+
+        double scale_for(double extent) {
+            return extent > 0 ? 4294967295.0 / extent : 1;
+        }
+    }
+
+    FlatQuadTree FlatQuadTree::build(std::span<const int32_t> latitudes, std::span<const int32_t> longitudes,
+                                     const Geometry::LocalProjection &projection, uint32_t leaf_size) {
+        if (latitudes.size() != longitudes.size()) throw std::invalid_argument("Coordinate arrays differ in size");
+        if (latitudes.size() >= npos) throw std::invalid_argument("Too many points for a FlatQuadTree");
+        leaf_size = std::max(leaf_size, 1u);
+        FlatQuadTree tree;
+        tree.shape.projection = projection;
+        if (latitudes.empty()) return tree;
+
+        const auto [min_latitude, max_latitude] = std::ranges::minmax(latitudes);
+        const auto [min_longitude, max_longitude] = std::ranges::minmax(longitudes);
+        const Geometry::Position min(Geometry::from_fixed(min_latitude), Geometry::from_fixed(min_longitude));
+        const Geometry::Position max(Geometry::from_fixed(max_latitude), Geometry::from_fixed(max_longitude));
+        tree.shape = {min, scale_for(max.latitude - min.latitude), scale_for(max.longitude - min.longitude), projection};
+
+        struct Keyed {
+            uint64_t key;
+            uint32_t index;
+        };
+        std::vector<Keyed> keyed(latitudes.size());
+        for (uint32_t i = 0; i < latitudes.size(); ++i) {
+            keyed[i] = {morton_key(tree.quantize_longitude(Geometry::from_fixed(longitudes[i])),
+                                   tree.quantize_latitude(Geometry::from_fixed(latitudes[i]))), i};
+        }
+        std::ranges::sort(keyed, [](const Keyed &a, const Keyed &b) {
+            return a.key < b.key || (a.key == b.key && a.index < b.index);
+        });
+
+        // Breadth first, so that the four children of a cell are adjacent
+        std::vector<Cell> cells = {{0, static_cast<uint32_t>(latitudes.size()), 0}};
+        std::vector<uint8_t> levels = {0};
+        for (size_t c = 0; c < cells.size(); ++c) {
+            const auto [begin, end, _] = cells[c];
+            const auto level = levels[c];
+            if (end - begin <= leaf_size || level == 32) continue;
+
+            const int shift = 62 - 2 * level;
+            cells[c].first_child = static_cast<uint32_t>(cells.size());
+            auto first = keyed.begin() + begin;
+            for (uint64_t quadrant = 0; quadrant < 4; ++quadrant) {
+                const auto last = quadrant == 3
+                                      ? keyed.begin() + end
+                                      : std::partition_point(first, keyed.begin() + end, [&](const Keyed &point) {
+                                          return (point.key >> shift & 3) <= quadrant;
+                                      });
+                cells.push_back({static_cast<uint32_t>(first - keyed.begin()),
+                                 static_cast<uint32_t>(last - keyed.begin()), 0});
+                levels.push_back(level + 1);
+                first = last;
+            }
+        }
+
+        std::vector<uint32_t> items(keyed.size());
+        std::vector<int32_t> item_latitudes(keyed.size()), item_longitudes(keyed.size());
+        for (size_t i = 0; i < keyed.size(); ++i) {
+            items[i] = keyed[i].index;
+            item_latitudes[i] = latitudes[keyed[i].index];
+            item_longitudes[i] = longitudes[keyed[i].index];
+        }
+        tree.cells = std::move(cells);
+        tree.items = std::move(items);
+        tree.latitudes = std::move(item_latitudes);
+        tree.longitudes = std::move(item_longitudes);
+        return tree;
+    }
+
+    FlatQuadTree FlatQuadTree::build(std::span<const Geometry::Position> points, uint32_t leaf_size) {
+        std::vector<int32_t> latitudes(points.size()), longitudes(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            latitudes[i] = Geometry::to_fixed(points[i].latitude);
+            longitudes[i] = Geometry::to_fixed(points[i].longitude);
+        }
+        Geometry::LocalProjection projection;
+        if (!points.empty()) {
+            const auto [min_latitude, max_latitude] = std::ranges::minmax(latitudes);
+            const auto [min_longitude, max_longitude] = std::ranges::minmax(longitudes);
+            projection = Geometry::LocalProjection::around(min_latitude, max_latitude, min_longitude, max_longitude);
+        }
+        return build(latitudes, longitudes, projection, leaf_size);
+    }
+
+    void FlatQuadTree::query(const Geometry::BoundingBox &box, std::vector<uint32_t> &result) const {
+        visit(box, [&](uint32_t index, const Geometry::Position &) { result.push_back(index); });
+    }
+
+    uint32_t FlatQuadTree::nearest(Geometry::Position position, double max_distance) const {
+        std::vector<Neighbor> result;
+        nearest(position, 1, max_distance, [](uint32_t) { return true; }, result);
+        return result.empty() ? npos : result.front().index;
+    }
+
+    double FlatQuadTree::distance_to_cell(Geometry::Position position, uint32_t level, uint64_t x,
+                                          uint64_t y) const {
+        // A point in the cell quantizes into [x, x + size), so it lies within [x, x + size] / scale of the origin
+        const double size = static_cast<double>(uint64_t{1} << (32 - level));
+        const double min_latitude = shape.origin.latitude + static_cast<double>(y) / shape.latitude_scale;
+        const double max_latitude = shape.origin.latitude + (static_cast<double>(y) + size) / shape.latitude_scale;
+        const double min_longitude = shape.origin.longitude + static_cast<double>(x) / shape.longitude_scale;
+        const double max_longitude = shape.origin.longitude + (static_cast<double>(x) + size) / shape.longitude_scale;
+        const double latitude = std::max({0.0, min_latitude - position.latitude, position.latitude - max_latitude});
+        const double longitude = std::max({0.0, min_longitude - position.longitude, position.longitude - max_longitude});
+        const double north = latitude * shape.projection.metres_per_latitude;
+        const double east = longitude * shape.projection.metres_per_longitude;
+        // Less a tiny margin for the rounding of the bounds above, far below any distance that matters
+        return std::max(0.0, std::sqrt(north * north + east * east) - 1e-6);
+    }
+}
@@ -0,0 +1,235 @@
+#ifndef FLATQUADTREE_H
+#define FLATQUADTREE_H
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "Buffer.h"
+#include "Geometry.h"
+#include "GeometryKernels.h"
+
+namespace Foliage::Util {
+    /**
+     * Point quadtree over a fixed set of positions, such as the nodes of a routing graph, in three flat
+     * arrays and without any pointers, so it can be mapped from a snapshot as it is.
+     * It is built in one go: points are sorted by the Morton key of their quantized coordinates, which puts
+     * every cell's points in one contiguous range, and cells are split top-down over those ranges.
+     * Leaves store the point indices together with their fixed-point coordinates, so queries scan them in
+     * order. Distances are in metres on a LocalProjection.
+     */
+    class FlatQuadTree {
+    public:
+        static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+        static constexpr uint32_t default_leaf_size = 16;
+        static constexpr uint32_t scan_chunk = 64; // Points a leaf scan hands to a kernel at a time
+
+        struct Cell {
+            uint32_t begin, end; // Range of `items` in the cell
+            uint32_t first_child; // First of four consecutive children (SW, SE, NW, NE), 0 for leaves
+        };
+
+        // Maps positions onto 32-bit integer coordinates along each axis, and onto metres
+        struct Shape {
+            Geometry::Position origin{0, 0};
+            double latitude_scale = 1, longitude_scale = 1; // Units per degree
+            Geometry::LocalProjection projection;
+        };
+
+        Shape shape;
+        Buffer<Cell> cells; // The root is cell 0, children come after their parent
+        Buffer<uint32_t> items; // Point indices in Morton order
+        Buffer<int32_t> latitudes, longitudes; // Of every entry of `items`, in 1e-7 degree units
+
+        /**
+         * @param latitudes, longitudes Fixed-point coordinates of every point
+         * @param projection Measures distances, e.g. that of the graph the points come from
+         * @param leaf_size Cells with more points are split, unless they cannot be split any further
+         */
+        static FlatQuadTree build(std::span<const int32_t> latitudes, std::span<const int32_t> longitudes,
+                                  const Geometry::LocalProjection &projection,
+                                  uint32_t leaf_size = default_leaf_size);
+
+        /**
+         * Rounds `points` to fixed point and measures distances around the centre of their bounds.
+         */
+        static FlatQuadTree build(std::span<const Geometry::Position> points, uint32_t leaf_size = default_leaf_size);
+
+        /**
+         * Calls visitor(index, position) for every point inside `box`, edges included.
+         */
+        template<class Visitor>
+        void visit(const Geometry::BoundingBox &box, Visitor &&visitor) const;
+
+        /**
+         * Appends the indices of the points inside `box` to `result`, in Morton order.
+         */
+        void query(const Geometry::BoundingBox &box, std::vector<uint32_t> &result) const;
+
+        struct Neighbor {
+            uint32_t index;
+            double distance; // To the query position, in metres
+        };
+
+        /**
+         * Best-first search for the `k` points closest to `position` that are at most `max_distance`
+         * away and pass filter(index). Cells are visited in order of their distance, and the search stops
+         * at the first one farther than the k-th point found, so its cost does not depend on how dense
+         * the points around `position` are.
+         * @param result Replaced by the neighbors, closest first, the lower index first on ties
+         */
+        template<class Filter>
+        void nearest(Geometry::Position position, size_t k, double max_distance, Filter &&filter,
+                     std::vector<Neighbor> &result) const;
+
+        /**
+         * @return The point closest to `position`, at most `max_distance` away, or npos if there is none
+         */
+        [[nodiscard]] uint32_t nearest(Geometry::Position position, double max_distance) const;
+
+        [[nodiscard]] uint32_t quantize_latitude(double latitude) const {
+            return quantize(latitude - shape.origin.latitude, shape.latitude_scale);
+        }
+
+        [[nodiscard]] uint32_t quantize_longitude(double longitude) const {
+            return quantize(longitude - shape.origin.longitude, shape.longitude_scale);
+        }
+
+    private:
+        /**
+         * @return A lower bound on the distance from `position` to the points of a cell
+         */
+        [[nodiscard]] double distance_to_cell(Geometry::Position position, uint32_t level, uint64_t x,
+                                              uint64_t y) const;
+
+        // Monotonic, so a point inside a box is always inside the quantized box
+        static uint32_t quantize(double offset, double scale) {
+            const double value = offset * scale;
+            if (!(value > 0)) return 0;
+            if (value >= 4294967295.0) return std::numeric_limits<uint32_t>::max();
+            return static_cast<uint32_t>(value);
+        }
+    };
+
+    template<class Visitor>
+    void FlatQuadTree::visit(const Geometry::BoundingBox &box, Visitor &&visitor) const {
+        if (cells.empty()) return;
+        const uint64_t x0 = quantize_longitude(box.min_position.longitude);
+        const uint64_t x1 = quantize_longitude(box.max_position.longitude);
+        const uint64_t y0 = quantize_latitude(box.min_position.latitude);
+        const uint64_t y1 = quantize_latitude(box.max_position.latitude);
+        if (x0 > x1 || y0 > y1) return;
+        const auto fixed_box = Geometry::FixedBox::enclosed_by(box);
+
+        struct Frame {
+            uint32_t cell;
+            uint32_t level;
+            uint64_t x, y;
+        };
+        // A cell pushes at most four children, and there are at most 32 levels below the root
+        std::array<Frame, 4 * 33> stack;
+        size_t top = 0;
+        stack[top++] = {0, 0, 0, 0};
+        while (top > 0) {
+            const auto [index, level, x, y] = stack[--top];
+            const auto &cell = cells[index];
+            const uint64_t last = (uint64_t{1} << (32 - level)) - 1; // Offset of the cell's last unit
+            if (x > x1 || x + last < x0 || y > y1 || y + last < y0) continue;
+            if (cell.first_child != 0) {
+                const uint64_t half = (last + 1) / 2;
+                for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+                    stack[top++] = {cell.first_child + quadrant, level + 1,
+                                    x + (quadrant & 1) * half, y + (quadrant >> 1) * half};
+                }
+                continue;
+            }
+            auto visit_item = [&](uint32_t i) {
+                visitor(items[i], Geometry::Position(Geometry::from_fixed(latitudes[i]), Geometry::from_fixed(longitudes[i])));
+            };
+            // Strictly inside in quantized units means inside in degrees too
+            if (x0 < x && x + last < x1 && y0 < y && y + last < y1) {
+                for (auto i = cell.begin; i < cell.end; ++i) visit_item(i);
+                continue;
+            }
+            std::array<uint32_t, scan_chunk> selected;
+            for (auto begin = cell.begin; begin < cell.end; begin += scan_chunk) {
+                const size_t count = std::min(cell.end - begin, scan_chunk);
+                const size_t found = Geometry::Kernels::select_in_box(fixed_box, {latitudes.data() + begin, count},
+                                                                      {longitudes.data() + begin, count},
+                                                                      selected.data());
+                for (size_t j = 0; j < found; ++j) visit_item(begin + selected[j]);
+            }
+        }
+    }
+
+    template<class Filter>
+    void FlatQuadTree::nearest(Geometry::Position position, size_t k, double max_distance, Filter &&filter,
+                               std::vector<Neighbor> &result) const {
+        result.clear();
+        if (cells.empty() || k == 0 || !(max_distance >= 0)) return;
+
+        struct Pending {
+            double distance;
+            uint32_t cell;
+            uint32_t level;
+            uint64_t x, y;
+        };
+        auto closer_on_top = [](const Pending &a, const Pending &b) { return a.distance > b.distance; };
+        // `result` is a max-heap of the best points so far until the end, so the k-th is at the front
+        auto farther = [](const Neighbor &a, const Neighbor &b) {
+            return a.distance < b.distance || (a.distance == b.distance && a.index < b.index);
+        };
+        auto limit = [&] {
+            return result.size() < k ? max_distance : std::min(max_distance, result.front().distance);
+        };
+
+        const Geometry::Kernels::Probe probe(shape.projection, position);
+        std::array<double, scan_chunk> distances;
+        std::vector<Pending> pending;
+        pending.push_back({distance_to_cell(position, 0, 0, 0), 0, 0, 0, 0});
+        while (!pending.empty()) {
+            std::ranges::pop_heap(pending, closer_on_top);
+            const auto [distance, index, level, x, y] = pending.back();
+            pending.pop_back();
+            // Cells at exactly the limit may still hold a tie with a lower index
+            if (distance > limit()) break;
+
+            const auto &cell = cells[index];
+            if (cell.first_child != 0) {
+                const uint64_t half = uint64_t{1} << (31 - level);
+                for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+                    const uint64_t child_x = x + (quadrant & 1) * half, child_y = y + (quadrant >> 1) * half;
+                    const double child_distance = distance_to_cell(position, level + 1, child_x, child_y);
+                    if (child_distance > limit()) continue;
+                    pending.push_back({child_distance, cell.first_child + quadrant, level + 1, child_x, child_y});
+                    std::ranges::push_heap(pending, closer_on_top);
+                }
+                continue;
+            }
+            for (auto begin = cell.begin; begin < cell.end; begin += scan_chunk) {
+                const size_t count = std::min(cell.end - begin, scan_chunk);
+                Geometry::Kernels::distances(probe, {latitudes.data() + begin, count},
+                                             {longitudes.data() + begin, count},
+                                             {distances.data(), count});
+                for (size_t j = 0; j < count; ++j) {
+                    const Neighbor candidate{items[begin + j], distances[j]};
+                    if (candidate.distance > max_distance || !filter(candidate.index)) continue;
+                    if (result.size() < k) {
+                        result.push_back(candidate);
+                        std::ranges::push_heap(result, farther);
+                    } else if (farther(candidate, result.front())) {
+                        std::ranges::pop_heap(result, farther);
+                        result.back() = candidate;
+                        std::ranges::push_heap(result, farther);
+                    }
+                }
+            }
+        }
+        std::ranges::sort_heap(result, farther);
+    }
+}
+
+#endif //FLATQUADTREE_H
@@ -0,0 +1,82 @@
+#include "Generation.h"
+
+#include <stdexcept>
+
+namespace Foliage::Pathfinder {
+    std::shared_ptr<Generation> Generation::build(const DataProvider::AbstractDocument &document,
+                                                  Util::StageTimer &timings) {
+        auto generation = std::make_shared<Generation>();
+        auto &astar = *generation->astar;
+        astar.graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(document, &timings));
+        astar.node_tree = std::make_shared<const Util::FlatQuadTree>(
+            Util::FlatQuadTree::build(astar.graph->latitudes, astar.graph->longitudes, astar.graph->projection));
+        timings.lap("node tree");
+        astar.segments = std::make_shared<const Graph::SegmentIndex>(Graph::SegmentIndex::build(*astar.graph));
+        timings.lap("segments");
+        astar.profiles = std::make_shared<Graph::ProfileSet>(astar.graph);
+        timings.lap("profiles");
+        // Contraction runs on the shared thread pool; other profiles are routed with A*
+        generation->ch->build({{{"profile", "car"}}});
+        timings.lap("contraction");
+        generation->bounds = document.border;
+        return generation;
+    }
+
+    std::shared_ptr<Generation> Generation::load(const std::string &snapshot_path, Util::StageTimer &timings) {
+        auto generation = std::make_shared<Generation>();
+        auto &astar = *generation->astar;
+        auto snapshot = Graph::Snapshot::load(snapshot_path);
+        timings.lap("snapshot");
+        astar.graph = snapshot.graph;
+        astar.node_tree = snapshot.node_tree;
+        astar.segments = snapshot.segments;
+        astar.profiles = std::make_shared<Graph::ProfileSet>(astar.graph, 8, 8, snapshot.landmarks);
+        timings.lap("profiles");
+        generation->ch->build({{{"profile", "car"}}}, snapshot.hierarchies);
+        timings.lap("contraction");
+        generation->bounds = snapshot.bounds;
+        return generation;
+    }
+
+    Graph::Snapshot Generation::snapshot() const {
+        if (!astar->graph || !astar->node_tree || !astar->segments || !astar->profiles) {
+            throw std::runtime_error("No map loaded");
+        }
+        Graph::Snapshot snapshot;
+        snapshot.bounds = bounds;
+        snapshot.graph = astar->graph;
+        snapshot.node_tree = astar->node_tree;
+        snapshot.segments = astar->segments;
+        for (const auto &[name, weights]: astar->profiles->builtin_profiles()) {
+            if (weights->landmarks) snapshot.landmarks[name] = weights->landmarks;
+        }
+        snapshot.hierarchies.insert(ch->hierarchies.begin(), ch->hierarchies.end());
+        return snapshot;
+    }
+
+    std::shared_ptr<const Generation> GenerationSlot::pin() const {
+        // Weak, so that an idle thread does not keep a replaced generation alive
+        thread_local struct {
+            uint64_t slot = 0, number = 0;
+            std::weak_ptr<const Generation> generation;
+        } cache;
+        const auto number = published.load(std::memory_order_acquire);
+        if (cache.slot == id && cache.number == number) {
+            if (auto generation = cache.generation.lock()) return generation;
+        }
+        // Published after the pointer, so this is that generation or a newer one
+        auto generation = current.load(std::memory_order_acquire);
+        cache.slot = id;
+        cache.number = number;
+        cache.generation = generation;
+        return generation;
+    }
+
+    uint64_t GenerationSlot::publish(std::shared_ptr<Generation> next) {
+        next->number = next_number++;
+        const auto number = next->number;
+        current.store(std::move(next), std::memory_order_release);
+        published.store(number, std::memory_order_release);
+        return number;
+    }
+}
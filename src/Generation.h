@@ -0,0 +1,78 @@
+#ifndef GENERATION_H
+#define GENERATION_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "AbstractDocument.h"
+#include "ContractionHierarchyPathfinder.h"
+#include "LayeredAStarPathfinder.h"
+#include "Snapshot.h"
+#include "StageTimer.h"
+
+namespace Foliage::Pathfinder {
+    /**
+     * One loaded region with everything queries need: the graph, its indexes, compiled profiles and
+     * hierarchies. A generation is built completely before it is published and never changes after,
+     * so any number of queries can use it without locks.
+     */
+    struct Generation {
+        uint64_t number = 0; // Set when published, counting from 1
+        Geometry::BoundingBox bounds;
+        std::shared_ptr<LayeredAStarPathfinder> astar = std::make_shared<LayeredAStarPathfinder>();
+        std::shared_ptr<ContractionHierarchyPathfinder> ch = std::make_shared<ContractionHierarchyPathfinder>(astar);
+
+        /**
+         * Builds the graph, its indexes and profiles from a parsed document, and a hierarchy for the car profile.
+         */
+        static std::shared_ptr<Generation> build(const DataProvider::AbstractDocument &document,
+                                                 Util::StageTimer &timings);
+
+        /**
+         * Maps a snapshot, rebuilding what no longer matches the profile weights.
+         */
+        static std::shared_ptr<Generation> load(const std::string &snapshot_path, Util::StageTimer &timings);
+
+        /**
+         * @throws std::runtime_error If nothing is loaded
+         */
+        [[nodiscard]] Graph::Snapshot snapshot() const;
+    };
+
+    /**
+     * Holds the generation being served. Readers pin it and keep it for as long as they use it; publishing
+     * swaps in the next one atomically, and the old one is freed when its last reader lets go, so a reload
+     * never waits for the queries in flight, nor they for the reload.
+     *
+     * std::atomic<std::shared_ptr> is not lock-free in libstdc++: a load or store takes an internal spinlock.
+     * So each thread remembers the generation it last pinned, weakly and with its number, and pinning is an
+     * atomic load of the published number and a reference count increment while that number stands. Only the
+     * first pin of a thread after a publish loads the shared pointer.
+     */
+    class GenerationSlot {
+    public:
+        GenerationSlot(): current(std::make_shared<const Generation>()) {
+        }
+
+        /**
+         * @return The current generation, which stays valid however many are published after it
+         */
+        [[nodiscard]] std::shared_ptr<const Generation> pin() const;
+
+        /**
+         * Numbers `next` and makes it the current generation. Publishers take turns, e.g. on one load lane.
+         * @return Its number
+         */
+        uint64_t publish(std::shared_ptr<Generation> next);
+
+    private:
+        std::atomic<std::shared_ptr<const Generation>> current;
+        std::atomic<uint64_t> published{0}; // Number of the current generation, stored after it
+        std::atomic<uint64_t> next_number{1};
+        const uint64_t id = next_id++; // Tells the slots apart in the threads' caches, unlike addresses
+        static inline std::atomic<uint64_t> next_id{1};
+    };
+}
+
+#endif //GENERATION_H
@@ -4,6 +4,7 @@
 
 #include "Geometry.h"
 #include <cmath>
+#include <limits>
 
 namespace Foliage::Geometry {
     bool BoundingBox::contains(Position p) const {
@@ -19,6 +20,34 @@ namespace Foliage::Geometry {
         // If no overlap, they don't intersect
         return !no_overlap;
     }
+    namespace {
+        // The first fixed-point coordinate at or past `degrees`, towards +infinity or -infinity
+        int32_t fixed_bound(double degrees, bool upwards) {
+            constexpr double lowest = std::numeric_limits<int32_t>::min();
+            constexpr double highest = std::numeric_limits<int32_t>::max();
+            constexpr int32_t first = std::numeric_limits<int32_t>::min(), last = std::numeric_limits<int32_t>::max();
+            if (std::isnan(degrees)) return upwards ? last : first; // Encloses nothing
+            const double guess = degrees * fixed_units_per_degree;
+            if (!(guess > lowest)) return first;
+            if (!(guess < highest)) return last;
+            auto units = static_cast<int32_t>(upwards ? std::ceil(guess) : std::floor(guess));
+            // The guess is rounded; from_fixed is what decides
+            if (upwards) {
+                while (units > lowest && from_fixed(units - 1) >= degrees) --units;
+                while (units < highest && from_fixed(units) < degrees) ++units;
+            } else {
+                while (units < highest && from_fixed(units + 1) <= degrees) ++units;
+                while (units > lowest && from_fixed(units) > degrees) --units;
+            }
+            return units;
+        }
+    }
+
+    FixedBox FixedBox::enclosed_by(const BoundingBox &box) {
+        return {fixed_bound(box.min_position.latitude, true), fixed_bound(box.min_position.longitude, true),
+                fixed_bound(box.max_position.latitude, false), fixed_bound(box.max_position.longitude, false)};
+    }
+
     double compute_distance(Geometry::Position start, Geometry::Position goal) {
         return std::sqrt((start.latitude - goal.latitude) * (start.latitude - goal.latitude) + (start.longitude - goal.longitude)
                * (start.longitude - goal.longitude));
@@ -5,6 +5,9 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
 
 namespace Foliage::Geometry {
 
@@ -27,7 +30,90 @@ namespace Foliage::Geometry {
         bool intersects(const BoundingBox &b) const;
     };
 
+    // Euclidean, in degrees
     double compute_distance(Geometry::Position start, Geometry::Position goal);
+
+    // OSM stores coordinates with 7 decimals, so they fit an int32 of 1e-7 degree units exactly
+    constexpr double fixed_units_per_degree = 1e7;
+
+    inline int32_t to_fixed(double degrees) {
+        return static_cast<int32_t>(std::lround(degrees * fixed_units_per_degree));
+    }
+
+    inline double from_fixed(int32_t units) {
+        return units / fixed_units_per_degree;
+    }
+
+    // Metres east (x) and north (y) of the origin of a LocalProjection
+    struct Point {
+        double x;
+        double y;
+    };
+
+    inline double distance(Point a, Point b) {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    }
+
+    /**
+     * Equirectangular projection around an origin: metres per degree of longitude are scaled by the cosine
+     * of the origin's latitude. Within a few degrees of the origin, distances are off by well under a
+     * percent, and projecting a position takes two subtractions and two multiplications.
+     */
+    struct LocalProjection {
+        static constexpr double earth_radius = 6371008.8; // Mean radius, in metres
+        static constexpr double metres_per_degree = earth_radius * std::numbers::pi / 180;
+
+        Position origin{0, 0};
+        double metres_per_latitude = metres_per_degree;
+        double metres_per_longitude = metres_per_degree;
+
+        static LocalProjection around(Position origin) {
+            return {origin, metres_per_degree, metres_per_degree * std::cos(origin.latitude * std::numbers::pi / 180)};
+        }
+
+        // Around the centre of fixed-point bounds
+        static LocalProjection around(int32_t min_latitude, int32_t max_latitude, int32_t min_longitude,
+                                      int32_t max_longitude) {
+            return around({(from_fixed(min_latitude) + from_fixed(max_latitude)) / 2,
+                           (from_fixed(min_longitude) + from_fixed(max_longitude)) / 2});
+        }
+
+        [[nodiscard]] Point project(Position position) const {
+            return {(position.longitude - origin.longitude) * metres_per_longitude,
+                    (position.latitude - origin.latitude) * metres_per_latitude};
+        }
+
+        // As projecting from_fixed() of both, up to rounding, but without the divisions
+        [[nodiscard]] Point project(int32_t latitude, int32_t longitude) const {
+            constexpr double degrees_per_unit = 1 / fixed_units_per_degree;
+            return {(longitude * degrees_per_unit - origin.longitude) * metres_per_longitude,
+                    (latitude * degrees_per_unit - origin.latitude) * metres_per_latitude};
+        }
+
+        [[nodiscard]] Position unproject(Point point) const {
+            return {origin.latitude + point.y / metres_per_latitude, origin.longitude + point.x / metres_per_longitude};
+        }
+
+        // In metres
+        [[nodiscard]] double distance(Position a, Position b) const {
+            return Geometry::distance(project(a), project(b));
+        }
+    };
+
+    // Box over fixed-point coordinates, edges included
+    struct FixedBox {
+        int32_t min_latitude, min_longitude, max_latitude, max_longitude;
+
+        /**
+         * @return The box of exactly those fixed-point coordinates whose position `box` contains
+         */
+        static FixedBox enclosed_by(const BoundingBox &box);
+
+        [[nodiscard]] bool contains(int32_t latitude, int32_t longitude) const {
+            return min_latitude <= latitude && latitude <= max_latitude &&
+                   min_longitude <= longitude && longitude <= max_longitude;
+        }
+    };
 }
 
 #endif //GEOMETRY_H
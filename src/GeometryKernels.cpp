@@ -0,0 +1,228 @@
+#include "GeometryKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FOLIAGE_KERNELS_AVX2 1
+#endif
+
+namespace Foliage::Geometry::Kernels {
+    namespace {
+        struct Table {
+            void (*distances)(const Probe &, const int32_t *, const int32_t *, size_t, double *);
+            void (*box_distances)(const Probe &, const FixedBox *, size_t, double *);
+            size_t (*select_in_box)(const FixedBox &, const int32_t *, const int32_t *, size_t, uint32_t *);
+        };
+
+        double scalar_distance(const Probe &probe, int32_t latitude, int32_t longitude) {
+            const double north = (latitude - probe.latitude) * probe.metres_per_latitude_unit;
+            const double east = (longitude - probe.longitude) * probe.metres_per_longitude_unit;
+            return std::sqrt(north * north + east * east);
+        }
+
+        double scalar_box_distance(const Probe &probe, const FixedBox &box) {
+            // The projection is linear along each axis, so the gap in units scales to the gap in metres
+            const double north = std::max(std::max(0.0, box.min_latitude - probe.latitude),
+                                          probe.latitude - box.max_latitude) * probe.metres_per_latitude_unit;
+            const double east = std::max(std::max(0.0, box.min_longitude - probe.longitude),
+                                         probe.longitude - box.max_longitude) * probe.metres_per_longitude_unit;
+            return std::sqrt(north * north + east * east);
+        }
+
+        void scalar_distances(const Probe &probe, const int32_t *latitudes, const int32_t *longitudes, size_t count,
+                              double *result) {
+            for (size_t i = 0; i < count; ++i) result[i] = scalar_distance(probe, latitudes[i], longitudes[i]);
+        }
+
+        void scalar_box_distances(const Probe &probe, const FixedBox *boxes, size_t count, double *result) {
+            for (size_t i = 0; i < count; ++i) result[i] = scalar_box_distance(probe, boxes[i]);
+        }
+
+        size_t scalar_select_in_box(const FixedBox &box, const int32_t *latitudes, const int32_t *longitudes,
+                                    size_t count, uint32_t *result) {
+            size_t found = 0;
+            for (size_t i = 0; i < count; ++i) {
+                result[found] = static_cast<uint32_t>(i);
+                found += box.contains(latitudes[i], longitudes[i]);
+            }
+            return found;
+        }
+
+        constexpr Table scalar_table{scalar_distances, scalar_box_distances, scalar_select_in_box};
+
+#ifdef FOLIAGE_KERNELS_AVX2
+        // Same operations in the same order as the scalar versions, four doubles at a time
+        __attribute__((target("avx2")))
+        __m256d avx2_hypot(__m256d north, __m256d east) {
+            return _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(north, north), _mm256_mul_pd(east, east)));
+        }
+
+        __attribute__((target("avx2")))
+        void avx2_distances(const Probe &probe, const int32_t *latitudes, const int32_t *longitudes, size_t count,
+                            double *result) {
+            const __m256d latitude = _mm256_set1_pd(probe.latitude);
+            const __m256d longitude = _mm256_set1_pd(probe.longitude);
+            const __m256d latitude_scale = _mm256_set1_pd(probe.metres_per_latitude_unit);
+            const __m256d longitude_scale = _mm256_set1_pd(probe.metres_per_longitude_unit);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m256d lat = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(latitudes + i)));
+                const __m256d lon = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(longitudes + i)));
+                const __m256d north = _mm256_mul_pd(_mm256_sub_pd(lat, latitude), latitude_scale);
+                const __m256d east = _mm256_mul_pd(_mm256_sub_pd(lon, longitude), longitude_scale);
+                _mm256_storeu_pd(result + i, avx2_hypot(north, east));
+            }
+            for (; i < count; ++i) result[i] = scalar_distance(probe, latitudes[i], longitudes[i]);
+        }
+
+        __attribute__((target("avx2")))
+        void avx2_box_distances(const Probe &probe, const FixedBox *boxes, size_t count, double *result) {
+            static_assert(sizeof(FixedBox) == 4 * sizeof(int32_t));
+            const __m256d zero = _mm256_setzero_pd();
+            const __m256d latitude = _mm256_set1_pd(probe.latitude);
+            const __m256d longitude = _mm256_set1_pd(probe.longitude);
+            const __m256d latitude_scale = _mm256_set1_pd(probe.metres_per_latitude_unit);
+            const __m256d longitude_scale = _mm256_set1_pd(probe.metres_per_longitude_unit);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                // Four boxes are a 4x4 matrix of integers; transposed, each row is one field of all four
+                const auto *fields = reinterpret_cast<const __m128i *>(boxes + i);
+                const __m128i a = _mm_loadu_si128(fields), b = _mm_loadu_si128(fields + 1);
+                const __m128i c = _mm_loadu_si128(fields + 2), d = _mm_loadu_si128(fields + 3);
+                const __m128i ab_low = _mm_unpacklo_epi32(a, b), cd_low = _mm_unpacklo_epi32(c, d);
+                const __m128i ab_high = _mm_unpackhi_epi32(a, b), cd_high = _mm_unpackhi_epi32(c, d);
+                const __m256d min_latitude = _mm256_cvtepi32_pd(_mm_unpacklo_epi64(ab_low, cd_low));
+                const __m256d min_longitude = _mm256_cvtepi32_pd(_mm_unpackhi_epi64(ab_low, cd_low));
+                const __m256d max_latitude = _mm256_cvtepi32_pd(_mm_unpacklo_epi64(ab_high, cd_high));
+                const __m256d max_longitude = _mm256_cvtepi32_pd(_mm_unpackhi_epi64(ab_high, cd_high));
+
+                const __m256d north = _mm256_mul_pd(
+                    _mm256_max_pd(_mm256_max_pd(zero, _mm256_sub_pd(min_latitude, latitude)),
+                                  _mm256_sub_pd(latitude, max_latitude)), latitude_scale);
+                const __m256d east = _mm256_mul_pd(
+                    _mm256_max_pd(_mm256_max_pd(zero, _mm256_sub_pd(min_longitude, longitude)),
+                                  _mm256_sub_pd(longitude, max_longitude)), longitude_scale);
+                _mm256_storeu_pd(result + i, avx2_hypot(north, east));
+            }
+            for (; i < count; ++i) result[i] = scalar_box_distance(probe, boxes[i]);
+        }
+
+        __attribute__((target("avx2")))
+        size_t avx2_select_in_box(const FixedBox &box, const int32_t *latitudes, const int32_t *longitudes,
+                                  size_t count, uint32_t *result) {
+            const __m256i min_latitude = _mm256_set1_epi32(box.min_latitude);
+            const __m256i max_latitude = _mm256_set1_epi32(box.max_latitude);
+            const __m256i min_longitude = _mm256_set1_epi32(box.min_longitude);
+            const __m256i max_longitude = _mm256_set1_epi32(box.max_longitude);
+            size_t found = 0, i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256i lat = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(latitudes + i));
+                const __m256i lon = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(longitudes + i));
+                const __m256i outside = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpgt_epi32(min_latitude, lat), _mm256_cmpgt_epi32(lat, max_latitude)),
+                    _mm256_or_si256(_mm256_cmpgt_epi32(min_longitude, lon), _mm256_cmpgt_epi32(lon, max_longitude)));
+                auto inside = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) & 0xFFu;
+                for (; inside != 0; inside &= inside - 1) {
+                    result[found++] = static_cast<uint32_t>(i) + static_cast<uint32_t>(__builtin_ctz(inside));
+                }
+            }
+            for (; i < count; ++i) {
+                result[found] = static_cast<uint32_t>(i);
+                found += box.contains(latitudes[i], longitudes[i]);
+            }
+            return found;
+        }
+
+        constexpr Table avx2_table{avx2_distances, avx2_box_distances, avx2_select_in_box};
+#endif
+
+        const Table &table_for(Isa isa) {
+#ifdef FOLIAGE_KERNELS_AVX2
+            if (isa == Isa::AVX2) return avx2_table;
+#endif
+            return scalar_table;
+        }
+
+        std::atomic<const Table *> active_table{nullptr};
+        std::atomic<Isa> active{Isa::Scalar};
+
+        const Table &table() {
+            const Table *current = active_table.load(std::memory_order_acquire);
+            if (current) return *current;
+            use_isa(supported_isa());
+            return *active_table.load(std::memory_order_acquire);
+        }
+
+        void check_sizes(size_t a, size_t b) {
+            if (a != b) throw std::invalid_argument("Coordinate arrays differ in size");
+        }
+    }
+
+    Probe::Probe(const LocalProjection &projection, Position position):
+        latitude(position.latitude * fixed_units_per_degree),
+        longitude(position.longitude * fixed_units_per_degree),
+        metres_per_latitude_unit(projection.metres_per_latitude / fixed_units_per_degree),
+        metres_per_longitude_unit(projection.metres_per_longitude / fixed_units_per_degree) {
+    }
+
+    Isa supported_isa() {
+#ifdef FOLIAGE_KERNELS_AVX2
+        static const bool avx2 = [] {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+        }();
+        if (avx2) return Isa::AVX2;
+#endif
+        return Isa::Scalar;
+    }
+
+    Isa active_isa() {
+        table();
+        return active.load(std::memory_order_relaxed);
+    }
+
+    void use_isa(Isa isa) {
+        if (isa > supported_isa()) throw std::invalid_argument("Instruction set not supported by this CPU");
+        active.store(isa, std::memory_order_relaxed);
+        active_table.store(&table_for(isa), std::memory_order_release);
+    }
+
+    void distances(const Probe &probe, std::span<const int32_t> latitudes, std::span<const int32_t> longitudes,
+                   std::span<double> result) {
+        check_sizes(latitudes.size(), longitudes.size());
+        check_sizes(latitudes.size(), result.size());
+        table().distances(probe, latitudes.data(), longitudes.data(), latitudes.size(), result.data());
+    }
+
+    void box_distances(const Probe &probe, std::span<const FixedBox> boxes, std::span<double> result) {
+        check_sizes(boxes.size(), result.size());
+        table().box_distances(probe, boxes.data(), boxes.size(), result.data());
+    }
+
+    size_t select_in_box(const FixedBox &box, std::span<const int32_t> latitudes,
+                         std::span<const int32_t> longitudes, uint32_t *result) {
+        check_sizes(latitudes.size(), longitudes.size());
+        return table().select_in_box(box, latitudes.data(), longitudes.data(), latitudes.size(), result);
+    }
+
+    void haversine_distances(Position from, std::span<const int32_t> latitudes, std::span<const int32_t> longitudes,
+                             std::span<double> result) {
+        check_sizes(latitudes.size(), longitudes.size());
+        check_sizes(latitudes.size(), result.size());
+        constexpr double radians_per_unit = std::numbers::pi / 180 / fixed_units_per_degree;
+        const double from_latitude = from.latitude * std::numbers::pi / 180;
+        const double from_longitude = from.longitude * std::numbers::pi / 180;
+        const double cos_from = std::cos(from_latitude);
+        for (size_t i = 0; i < latitudes.size(); ++i) {
+            const double latitude = latitudes[i] * radians_per_unit;
+            const double half_north = std::sin((latitude - from_latitude) / 2);
+            const double half_east = std::sin((longitudes[i] * radians_per_unit - from_longitude) / 2);
+            const double a = half_north * half_north + cos_from * std::cos(latitude) * half_east * half_east;
+            result[i] = 2 * LocalProjection::earth_radius * std::asin(std::min(1.0, std::sqrt(a)));
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef GEOMETRYKERNELS_H
+#define GEOMETRYKERNELS_H
+#include <cstdint>
+#include <span>
+
+#include "Geometry.h"
+
+/**
+ * Batch kernels over fixed-point coordinate arrays, for the inner loops of the spatial indexes.
+ * Every kernel has a scalar version and an AVX2 one; the AVX2 versions are used when the CPU
+ * supports them, which is checked once at run time. Both give bit-identical results: they
+ * perform the same operations in the same order, without fused multiply-adds.
+ */
+namespace Foliage::Geometry::Kernels {
+    enum class Isa : uint8_t {
+        Scalar,
+        AVX2
+    };
+
+    /**
+     * A position prepared for measuring fixed-point coordinates against it, in metres on a
+     * LocalProjection: the position in 1e-7 degree units, and the metres a unit spans along each axis.
+     */
+    struct Probe {
+        double latitude, longitude;
+        double metres_per_latitude_unit, metres_per_longitude_unit;
+
+        Probe(const LocalProjection &projection, Position position);
+    };
+
+    /**
+     * @return The best instruction set this CPU supports
+     */
+    Isa supported_isa();
+
+    /**
+     * @return The instruction set the kernels currently use, supported_isa() unless changed
+     */
+    Isa active_isa();
+
+    /**
+     * Switches every kernel to another instruction set, e.g. to compare them. Not safe while kernels run.
+     * @throws std::invalid_argument If the CPU does not support `isa`
+     */
+    void use_isa(Isa isa);
+
+    /**
+     * result[i] = distance in metres from the probe to (latitudes[i], longitudes[i]).
+     */
+    void distances(const Probe &probe, std::span<const int32_t> latitudes, std::span<const int32_t> longitudes,
+                   std::span<double> result);
+
+    /**
+     * result[i] = distance in metres from the probe to the closest point of boxes[i], 0 inside it.
+     */
+    void box_distances(const Probe &probe, std::span<const FixedBox> boxes, std::span<double> result);
+
+    /**
+     * Writes the offsets of the coordinates that `box` contains to `result`, in order.
+     * @param result Room for latitudes.size() offsets
+     * @return The number of offsets written
+     */
+    size_t select_in_box(const FixedBox &box, std::span<const int32_t> latitudes,
+                         std::span<const int32_t> longitudes, uint32_t *result);
+
+    /**
+     * result[i] = great-circle distance in metres from `from` to (latitudes[i], longitudes[i]), on a
+     * sphere of LocalProjection::earth_radius. For distances too long for a local projection; scalar
+     * only, as AVX2 has no trigonometric instructions.
+     */
+    void haversine_distances(Position from, std::span<const int32_t> latitudes, std::span<const int32_t> longitudes,
+                             std::span<double> result);
+}
+
+#endif //GEOMETRYKERNELS_H
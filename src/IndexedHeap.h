@@ -0,0 +1,125 @@
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace Foliage::Util {
+    /**
+     * Min-heap of dense ids with `Arity` children per entry, holding each id at most once so that its key
+     * can be lowered in place. Where each id sits is kept outside, in whatever slot position(id) returns,
+     * so that it can live next to the rest of the id's state; a slot reads `npos` while the id is not in
+     * the heap. Keys are stored with the ids, so sifting reads one array.
+     */
+    template<size_t Arity, typename Key, typename Position>
+    class IndexedHeap {
+    public:
+        static_assert(Arity >= 2);
+        static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+        struct Entry {
+            Key key;
+            uint32_t id;
+        };
+
+        // Heap operations since construction
+        struct Counters {
+            uint64_t pushes = 0;
+            uint64_t pops = 0;
+            uint64_t decreases = 0;
+        };
+
+        explicit IndexedHeap(Position position = {}): position(std::move(position)) {
+        }
+
+        [[nodiscard]] bool empty() const { return entries.empty(); }
+
+        [[nodiscard]] size_t size() const { return entries.size(); }
+
+        [[nodiscard]] const Entry &top() const { return entries.front(); }
+
+        [[nodiscard]] const Counters &counters() const { return operations; }
+
+        /**
+         * Forgets every entry without touching their position slots, for when those are reset along with
+         * the rest of the ids' state.
+         */
+        void clear() { entries.clear(); }
+
+        /**
+         * Adds `id`, or lowers its key if it is already in the heap with a higher one.
+         */
+        void push_or_decrease(uint32_t id, Key key) {
+            uint32_t &slot = position(id);
+            if (slot == npos) {
+                ++operations.pushes;
+                entries.push_back({key, id});
+                slot = static_cast<uint32_t>(entries.size() - 1);
+            } else if (key < entries[slot].key) {
+                ++operations.decreases;
+                entries[slot].key = key;
+            } else {
+                return;
+            }
+            sift_up(slot);
+        }
+
+        Entry pop() {
+            ++operations.pops;
+            const Entry top = entries.front();
+            position(top.id) = npos;
+            const Entry last = entries.back();
+            entries.pop_back();
+            if (!entries.empty()) {
+                entries.front() = last;
+                position(last.id) = 0;
+                sift_down(0);
+            }
+            return top;
+        }
+
+    private:
+        void sift_up(uint32_t index) {
+            const Entry moving = entries[index];
+            while (index > 0) {
+                const uint32_t parent = (index - 1) / Arity;
+                if (!(moving.key < entries[parent].key)) break;
+                place(index, entries[parent]);
+                index = parent;
+            }
+            place(index, moving);
+        }
+
+        void sift_down(uint32_t index) {
+            const Entry moving = entries[index];
+            const size_t count = entries.size();
+            while (true) {
+                const size_t first = static_cast<size_t>(index) * Arity + 1;
+                if (first >= count) break;
+                const size_t last = std::min(first + Arity, count);
+                size_t smallest = first;
+                for (size_t child = first + 1; child < last; ++child) {
+                    if (entries[child].key < entries[smallest].key) smallest = child;
+                }
+                if (!(entries[smallest].key < moving.key)) break;
+                place(index, entries[smallest]);
+                index = static_cast<uint32_t>(smallest);
+            }
+            place(index, moving);
+        }
+
+        void place(uint32_t index, const Entry &entry) {
+            entries[index] = entry;
+            position(entry.id) = index;
+        }
+
+        std::vector<Entry> entries;
+        Position position;
+        Counters operations;
+    };
+}
+
+#endif //INDEXEDHEAP_H
@@ -0,0 +1,204 @@
+#include "Landmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+#include "Checksum.h"
+#include "ThreadPool.h"
+
+namespace Foliage::Graph {
+    namespace {
+        constexpr float unreachable = std::numeric_limits<float>::infinity();
+
+        // A CSR adjacency with one weight per arc
+        struct Adjacency {
+            const EdgeIndex *offsets;
+            const NodeIndex *targets;
+            const float *weights;
+        };
+
+        // The graph with every edge turned around, keeping its weight
+        struct ReverseGraph {
+            std::vector<EdgeIndex> offsets;
+            std::vector<NodeIndex> targets;
+            std::vector<float> weights;
+
+            explicit ReverseGraph(const RoutingGraph &graph, const std::vector<float> &forward_weights):
+                offsets(graph.node_count() + 1, 0),
+                targets(graph.edge_count()),
+                weights(graph.edge_count()) {
+                for (const auto target: graph.edge_targets) ++offsets[target + 1];
+                for (size_t node = 0; node < graph.node_count(); ++node) offsets[node + 1] += offsets[node];
+                std::vector<EdgeIndex> next(offsets.begin(), offsets.end() - 1);
+                for (NodeIndex node = 0; node < graph.node_count(); ++node) {
+                    for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                        const auto slot = next[graph.edge_targets[edge]]++;
+                        targets[slot] = node;
+                        weights[slot] = forward_weights[edge];
+                    }
+                }
+            }
+
+            [[nodiscard]] Adjacency adjacency() const { return {offsets.data(), targets.data(), weights.data()}; }
+        };
+
+        /**
+         * One-to-all Dijkstra. Optionally records the shortest path tree and the order nodes were settled in.
+         */
+        void shortest_paths(const Adjacency &adjacency, NodeIndex source, std::vector<float> &distance,
+                            std::vector<NodeIndex> *parent = nullptr, std::vector<NodeIndex> *order = nullptr) {
+            std::ranges::fill(distance, unreachable);
+            if (parent) std::ranges::fill(*parent, invalid_node);
+            if (order) order->clear();
+
+            using Entry = std::pair<float, NodeIndex>;
+            std::priority_queue<Entry, std::vector<Entry>, std::greater<> > heap;
+            distance[source] = 0;
+            heap.emplace(0.0f, source);
+            while (!heap.empty()) {
+                const auto [d, node] = heap.top();
+                heap.pop();
+                if (d > distance[node]) continue;
+                if (order) order->push_back(node);
+                for (auto arc = adjacency.offsets[node]; arc < adjacency.offsets[node + 1]; ++arc) {
+                    const auto target = adjacency.targets[arc];
+                    const float candidate = d + adjacency.weights[arc];
+                    if (candidate < distance[target]) {
+                        distance[target] = candidate;
+                        if (parent) (*parent)[target] = node;
+                        heap.emplace(candidate, target);
+                    }
+                }
+            }
+        }
+
+        // Index of the largest finite value, invalid_node if there is none
+        NodeIndex farthest(const std::vector<float> &distance) {
+            NodeIndex best = invalid_node;
+            for (NodeIndex node = 0; node < distance.size(); ++node) {
+                if (std::isfinite(distance[node]) && (best == invalid_node || distance[node] > distance[best])) {
+                    best = node;
+                }
+            }
+            return best;
+        }
+    }
+
+    LandmarkTable LandmarkTable::build(const RoutingGraph &graph, const std::vector<float> &weights, size_t count,
+                                       LandmarkStrategy strategy) {
+        if (weights.size() != graph.edge_count()) {
+            throw std::invalid_argument("Expected one weight per edge");
+        }
+        LandmarkTable table;
+        table.weights_checksum = Util::checksum(weights.data(), weights.size() * sizeof(float));
+        const size_t node_count = graph.node_count();
+        if (node_count == 0 || count == 0) return table;
+
+        const Adjacency forward{graph.edge_offsets.data(), graph.edge_targets.data(), weights.data()};
+        const ReverseGraph reverse(graph, weights);
+        std::vector<std::vector<float> > from(count), to(count);
+        std::vector<float> nearest(node_count, unreachable); // min over landmarks of d(landmark, node)
+        std::vector<uint8_t> is_landmark(node_count, 0);
+
+        // Start from the busiest junction, which is all but certainly part of the main network
+        NodeIndex root = 0;
+        for (NodeIndex node = 1; node < node_count; ++node) {
+            if (graph.edges_end(node) - graph.edges_begin(node) > graph.edges_end(root) - graph.edges_begin(root)) {
+                root = node;
+            }
+        }
+
+        std::vector<float> distance(node_count);
+        std::vector<NodeIndex> parent(node_count), order, child_offsets, children;
+        std::vector<double> subtree(node_count);
+        std::vector<uint8_t> covered(node_count);
+        for (size_t k = 0; k < count; ++k) {
+            if (k > 0) root = farthest(nearest);
+            if (root == invalid_node) break;
+
+            NodeIndex landmark;
+            if (strategy == LandmarkStrategy::Farthest) {
+                if (k == 0) {
+                    shortest_paths(forward, root, distance);
+                    landmark = farthest(distance);
+                } else {
+                    landmark = root;
+                }
+            } else {
+                // Weigh each node of the shortest path tree from the root by how much the current landmarks
+                // underestimate its distance, then descend into the heaviest subtree that has no landmark yet
+                shortest_paths(forward, root, distance, &parent, &order);
+                std::ranges::fill(subtree, 0.0);
+                std::ranges::fill(covered, 0);
+                for (const auto node: order) {
+                    float bound = 0;
+                    for (size_t i = 0; i < k; ++i) {
+                        const float via_out = to[i][root] - to[i][node];
+                        const float via_in = from[i][node] - from[i][root];
+                        if (std::isfinite(via_out)) bound = std::max(bound, via_out);
+                        if (std::isfinite(via_in)) bound = std::max(bound, via_in);
+                    }
+                    subtree[node] = std::max(0.0f, distance[node] - bound);
+                    covered[node] = is_landmark[node];
+                }
+                for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                    const auto node = *it;
+                    if (covered[node]) subtree[node] = 0;
+                    if (parent[node] == invalid_node) continue;
+                    subtree[parent[node]] += subtree[node];
+                    covered[parent[node]] |= covered[node];
+                }
+
+                child_offsets.assign(node_count + 1, 0);
+                for (const auto node: order) {
+                    if (parent[node] != invalid_node) ++child_offsets[parent[node] + 1];
+                }
+                for (size_t node = 0; node < node_count; ++node) child_offsets[node + 1] += child_offsets[node];
+                children.resize(child_offsets[node_count]);
+                std::vector<NodeIndex> next(child_offsets.begin(), child_offsets.end() - 1);
+                for (const auto node: order) {
+                    if (parent[node] != invalid_node) children[next[parent[node]]++] = node;
+                }
+
+                landmark = root;
+                while (true) {
+                    NodeIndex heaviest = invalid_node;
+                    for (auto i = child_offsets[landmark]; i < child_offsets[landmark + 1]; ++i) {
+                        const auto child = children[i];
+                        if (subtree[child] > 0 && (heaviest == invalid_node || subtree[child] > subtree[heaviest])) {
+                            heaviest = child;
+                        }
+                    }
+                    if (heaviest == invalid_node) break;
+                    landmark = heaviest;
+                }
+            }
+            if (landmark == invalid_node || is_landmark[landmark]) break;
+
+            is_landmark[landmark] = 1;
+            table.landmarks.push_back(landmark);
+            from[k].resize(node_count);
+            to[k].resize(node_count);
+            Util::ThreadPool::shared().parallel_for(2, [&](size_t direction) {
+                if (direction == 0) shortest_paths(forward, landmark, from[k]);
+                else shortest_paths(reverse.adjacency(), landmark, to[k]);
+            });
+            for (size_t node = 0; node < node_count; ++node) nearest[node] = std::min(nearest[node], from[k][node]);
+        }
+
+        const size_t size = table.size();
+        table.from_landmark.resize(node_count * size);
+        table.to_landmark.resize(node_count * size);
+        for (size_t node = 0; node < node_count; ++node) {
+            for (size_t i = 0; i < size; ++i) {
+                table.from_landmark[node * size + i] = from[i][node];
+                table.to_landmark[node * size + i] = to[i][node];
+            }
+        }
+        return table;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+#include <cstdint>
+#include <vector>
+
+#include "Buffer.h"
+#include "RoutingGraph.h"
+
+namespace Foliage::Graph {
+    enum class LandmarkStrategy {
+        Farthest, // Each landmark is the node farthest from the ones picked before
+        Avoid // Goldberg & Werneck: the leaf of the shortest path subtree whose bounds are worst
+    };
+
+    /**
+     * Distances between a few landmarks and every node, under one set of edge weights.
+     * By the triangle inequality they give a lower bound on the distance between any two nodes,
+     * which A* can use as its heuristic.
+     */
+    class LandmarkTable {
+    public:
+        Util::Buffer<NodeIndex> landmarks;
+        // Indexed by node * size() + landmark
+        Util::Buffer<float> from_landmark; // d(landmark, node)
+        Util::Buffer<float> to_landmark; // d(node, landmark)
+        uint64_t weights_checksum = 0; // Of the weights the distances were computed with
+
+        /**
+         * @param weights One weight per edge, infinity for edges that cannot be used
+         */
+        static LandmarkTable build(const RoutingGraph &graph, const std::vector<float> &weights, size_t count,
+                                   LandmarkStrategy strategy = LandmarkStrategy::Farthest);
+
+        [[nodiscard]] size_t size() const { return landmarks.size(); }
+
+        /**
+         * @return A lower bound on d(from, to), infinity if `to` is provably unreachable
+         */
+        [[nodiscard]] float lower_bound(NodeIndex from, NodeIndex to) const {
+            const size_t count = size();
+            const float *from_row = &to_landmark[from * count], *to_row = &to_landmark[to * count];
+            const float *from_column = &from_landmark[from * count], *to_column = &from_landmark[to * count];
+            float bound = 0;
+            for (size_t i = 0; i < count; ++i) {
+                // NaN from two unreachable entries compares false and is skipped
+                const float via_out = from_row[i] - to_row[i]; // d(from, L) - d(to, L)
+                const float via_in = to_column[i] - from_column[i]; // d(L, to) - d(L, from)
+                if (via_out > bound) bound = via_out;
+                if (via_in > bound) bound = via_in;
+            }
+            return bound;
+        }
+    };
+}
+
+#endif //LANDMARKS_H
@@ -1,332 +1,405 @@
 #include "LayeredAStarPathfinder.h"
 
 #include <iostream>
-#include <queue>
-#include <unordered_map>
 #include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
 
 namespace Foliage::Pathfinder {
-    // Updated get_path method using std::set for open lists
+    namespace {
+        // Lower is more important; transitions to a less important class are penalized
+        constexpr int highway_priority[] = {
+            1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 7,
+            100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100
+        };
+
+        static_assert(std::size(highway_priority) == Graph::highway_class_count);
+
+        constexpr double downgrade_penalty = 3;
+        constexpr double upgrade_bonus = 0.5;
+    }
+
+    int LayeredAStarPathfinder::priority_of(Graph::EdgeIndex edge) const {
+        return highway_priority[static_cast<size_t>(highway_of(edge))];
+    }
+
+    // Arrivals by roads of one priority have the same steps ahead at the same costs, so they are one state,
+    // kept at the first of those edges into the node
+    Graph::EdgeIndex LayeredAStarPathfinder::arrival_state(Graph::EdgeIndex edge) const {
+        const int priority = priority_of(edge);
+        const auto node = graph->edge_targets[edge];
+        for (auto out = graph->edges_begin(node); out < graph->edges_end(node); ++out) {
+            if (priority_of(graph->edge_twins[out]) == priority) return graph->edge_twins[out];
+        }
+        return edge;
+    }
+
+    double LayeredAStarPathfinder::step_cost(Graph::HighwayClass from, Graph::HighwayClass to, double weight) {
+        const bool downgrade = highway_priority[static_cast<size_t>(from)] < highway_priority[static_cast<size_t>(to)];
+        return weight * (downgrade ? downgrade_penalty : upgrade_bonus);
+    }
+
     std::vector<std::shared_ptr<const ObjectType::Node> > LayeredAStarPathfinder::get_path(
         Geometry::Position start,
         Geometry::Position end,
         std::map<std::string, std::string> preferences
     ) {
-        // Priority queues for open sets
-        auto compare = [](const std::shared_ptr<PathfinderNode> &a, const std::shared_ptr<PathfinderNode> &b) {
-            return a->f_score > b->f_score; // Min-heap based on f_score
-        };
-        std::priority_queue<std::shared_ptr<PathfinderNode>, std::vector<std::shared_ptr<PathfinderNode> >,
-                    std::function<bool(const std::shared_ptr<PathfinderNode> &,
-                                       const std::shared_ptr<PathfinderNode> &)> >
-                open_start(compare), open_goal(compare);
-
-        // Closed sets
-        std::unordered_set<int64_t> closed_start_ids, closed_goal_ids;
+        return get_path(start, end, preferences, nullptr);
+    }
 
-        // Node maps
-        std::unordered_map<int64_t, std::shared_ptr<PathfinderNode> > node_map_start, node_map_goal;
+    std::vector<std::shared_ptr<const ObjectType::Node> > LayeredAStarPathfinder::get_path(
+        Geometry::Position start,
+        Geometry::Position end,
+        const std::map<std::string, std::string> &preferences,
+        bool *relocated
+    ) {
+        if (relocated) *relocated = false;
+        if (!graph || !profiles) throw std::runtime_error("No map loaded");
+        const auto weights = profiles->get(preferences);
+        const double factor = suboptimality(preferences);
 
-        auto start_node_object = find_closest_node_on_highway(start);
-        auto goal_node_object = find_closest_node_on_highway(end);
-        if (!start_node_object || !goal_node_object) {
+        const auto terminals = locate(start, end, *weights, snap_distance(preferences));
+        if (!terminals) {
             std::cerr << "Start or goal node not found on highways.\n";
             return {};
         }
+        if (relocated) *relocated = terminals->relocated;
+        if (terminals->direct) return make_path(*terminals, {});
+        require_route(*terminals, *weights);
+        if (!terminals->start && terminals->sources.front().node == terminals->targets.front().node) {
+            return make_path(*terminals, {terminals->sources.front().node});
+        }
 
-        // Initialize start node
-        auto start_node = std::make_shared<PathfinderNode>();
-        start_node->f_score = Geometry::compute_distance(start, end);
-        start_node->g_score = 0;
-        start_node->node_object = start_node_object;
-        node_map_start[start_node_object->id] = start_node;
-        open_start.push(start_node);
-
-        // Initialize goal node
-        auto goal_node = std::make_shared<PathfinderNode>();
-        goal_node->f_score = Geometry::compute_distance(end, start);
-        goal_node->g_score = 0;
-        goal_node->node_object = goal_node_object;
-        node_map_goal[goal_node_object->id] = goal_node;
-        open_goal.push(goal_node);
-
-        double best_cost = std::numeric_limits<double>::infinity();
-        std::shared_ptr<PathfinderNode> best_meeting_node = nullptr;
-
-        while (!open_start.empty() && !open_goal.empty()) {
-            // Expand from the start side
-            if (!open_start.empty()) {
-                auto current_start = open_start.top();
-                open_start.pop();
-
-                if (closed_start_ids.count(current_start->node_object->id)) continue;
-                closed_start_ids.insert(current_start->node_object->id);
+        // Open sets, closed flags and scores of both sides, reused by every query of this thread. A state is
+        // the arrival at a node by a road of some priority, see arrival_state; the forward side scores the way
+        // there, the backward side the rest of the way from there, which depends on that priority
+        auto &workspace = SearchWorkspace::local();
+        workspace.reset(graph->node_count());
+        Meeting meeting;
+        auto seed = [&](int side, Graph::EdgeIndex state, double g_score) {
+            improve(workspace, side, state, SearchWorkspace::none, g_score, *weights,
+                    side == 0 ? terminals->targets : terminals->sources, meeting);
+        };
 
-                // Check for intersection
-                if (closed_goal_ids.count(current_start->node_object->id)) {
-                    auto meeting_node_goal = node_map_goal[current_start->node_object->id];
-                    double total_cost = current_start->g_score + meeting_node_goal->g_score;
-                    if (total_cost < best_cost) {
-                        best_cost = total_cost;
-                        best_meeting_node = current_start;
-                    }
+        // Forward from the start: along the snapped segment to either end, or out of the snapped node
+        if (terminals->start) {
+            const auto &point = *terminals->start;
+            for (const auto edge: {point.backward, point.forward}) {
+                const double part = edge == point.forward ? 1 - point.fraction : point.fraction;
+                if (std::isfinite((*weights)[edge])) {
+                    seed(0, arrival_state(edge),
+                         step_cost(Graph::HighwayClass::Other, highway_of(edge), part * (*weights)[edge]));
                 }
-
-                expand_neighbors(current_start, open_start, closed_start_ids, node_map_start, preferences, start, end,
-                                 3, true);
             }
-
-            // Expand from the goal side
-            if (!open_goal.empty()) {
-                auto current_goal = open_goal.top();
-                open_goal.pop();
-
-                if (closed_goal_ids.count(current_goal->node_object->id)) continue;
-                closed_goal_ids.insert(current_goal->node_object->id);
-
-                // Check for intersection
-                if (closed_start_ids.count(current_goal->node_object->id)) {
-                    auto meeting_node_start = node_map_start[current_goal->node_object->id];
-                    double total_cost = current_goal->g_score + meeting_node_start->g_score;
-                    if (total_cost < best_cost) {
-                        best_cost = total_cost;
-                        best_meeting_node = meeting_node_start;
-                    }
+        } else {
+            const auto node = terminals->sources.front().node;
+            for (auto edge = graph->edges_begin(node); edge < graph->edges_end(node); ++edge) {
+                if (std::isfinite((*weights)[edge])) {
+                    seed(0, arrival_state(edge), step_cost(Graph::HighwayClass::Other, highway_of(edge), (*weights)[edge]));
                 }
-
-                expand_neighbors(current_goal, open_goal, closed_goal_ids, node_map_goal, preferences, end, start, 3,
-                                 false);
             }
+        }
+        // Backward from the goal: arriving by any usable edge at an end of the snapped segment, then along it,
+        // or arriving at the snapped node
+        auto seed_arrivals = [&](Graph::NodeIndex node, Graph::EdgeIndex last, double part) {
+            for (auto out = graph->edges_begin(node); out < graph->edges_end(node); ++out) {
+                const auto edge = graph->edge_twins[out];
+                if (!std::isfinite((*weights)[edge])) continue;
+                seed(1, arrival_state(edge), last == Graph::invalid_edge
+                                  ? 0
+                                  : step_cost(highway_of(edge), highway_of(last), part * (*weights)[last]));
+            }
+        };
+        if (terminals->goal) {
+            const auto &point = *terminals->goal;
+            if (std::isfinite((*weights)[point.forward])) seed_arrivals(point.from, point.forward, point.fraction);
+            if (std::isfinite((*weights)[point.backward])) seed_arrivals(point.to, point.backward, 1 - point.fraction);
+        } else {
+            seed_arrivals(terminals->targets.front().node, Graph::invalid_edge, 0);
+        }
 
-            // Early exit if the best meeting node is found
-            if (best_meeting_node) {
-                return reconstruct_path(best_meeting_node, node_map_goal[best_meeting_node->node_object->id]);
+        // Both heuristics are consistent, so the smallest f-score of either side bounds every path not found
+        // yet from below. The search stops once the best path found is within `factor` of that bound, or
+        // when one side has run out of states, which leaves no other path to find
+        bool stopped_early = false;
+        for (int side = 0; !workspace.empty(0) && !workspace.empty(1); side = 1 - side) {
+            const double lower_bound = std::max(workspace.top(0).key, workspace.top(1).key);
+            if (factor * lower_bound >= meeting.cost) {
+                stopped_early = factor > 1 && lower_bound < meeting.cost;
+                break;
             }
+            const auto state = workspace.pop(side).id;
+            workspace(side, state).closed = true;
+            ++workspace.settled;
+            expand(workspace, side, state, *weights, side == 0 ? terminals->targets : terminals->sources, meeting);
         }
+        record(workspace.stats(), meeting.state == Graph::invalid_edge, stopped_early);
 
-        std::cerr << "No solution\n";
-        return {}; // Return an empty path if no solution is found
+        if (meeting.state == Graph::invalid_edge) {
+            std::cerr << "No solution\n";
+            return {};
+        }
+        return make_path(*terminals, reconstruct_path(workspace, meeting.state,
+                                                       terminals->start ? Graph::invalid_node
+                                                                        : terminals->sources.front().node));
     }
 
-    // Helper function to expand the neighbors of the current node in either direction
-    void LayeredAStarPathfinder::expand_neighbors(
-        const std::shared_ptr<PathfinderNode> &current_node,
-        std::priority_queue<std::shared_ptr<PathfinderNode>, std::vector<std::shared_ptr<PathfinderNode> >,
-            std::function<bool(const std::shared_ptr<PathfinderNode> &, const std::shared_ptr<PathfinderNode> &)> > &
-        open_set,
-        std::unordered_set<int64_t> &closed_set_ids,
-        std::unordered_map<int64_t, std::shared_ptr<PathfinderNode> > &node_map,
-        const std::map<std::string, std::string> &preferences,
-        const Geometry::Position &start,
-        const Geometry::Position &end,
-        int current_layer,
-        bool from_start
-    ) {
-        auto neighbors = get_neighbors(current_node->node_object, preferences, current_layer, node_map);
-        for (const auto &[way_weight, way_to_neighbor, neighbor]: neighbors) {
-            if (closed_set_ids.count(neighbor->node_object->id)) {
-                continue; // Ignore already evaluated nodes
-            }
+    // The landmark and straight-line bounds hold for the profile weights, which the upgrade bonus can undercut.
+    // Each side aims at the cheapest of the other side's terminals, counting the cost between the terminal and
+    // the query's end; the minimum of consistent bounds is consistent
+    double LayeredAStarPathfinder::heuristic(const Graph::ProfileWeights &weights, int side, Graph::NodeIndex node,
+                                             const std::vector<Graph::Endpoint> &heading_for) const {
+        double best = std::numeric_limits<double>::infinity();
+        for (const auto &[terminal, cost]: heading_for) {
+            const auto from = side == 0 ? node : terminal, to = side == 0 ? terminal : node;
+            const double straight_line = weights.cost_per_metre * graph->distance(from, to);
+            best = std::min(best, std::max<double>(weights.lower_bound(from, to), straight_line) + cost);
+        }
+        return upgrade_bonus * best;
+    }
 
-            double tentative_g_score = current_node->g_score + way_weight; // Update with the weight of the way
+    // Lowers the g-score of a state that is still open, and joins the two sides if the other has reached it
+    void LayeredAStarPathfinder::improve(SearchWorkspace &workspace, int side, Graph::EdgeIndex state,
+                                         uint32_t parent, double g_score, const Graph::ProfileWeights &weights,
+                                         const std::vector<Graph::Endpoint> &heading_for, Meeting &meeting) const {
+        const auto node = graph->edge_targets[state];
+        const auto reached = workspace.reach(side, node, state);
+        auto &label = workspace(side, reached);
+        if (label.closed || g_score >= label.g_score) return; // Closed states are final, the heuristics being consistent
+        label.parent = parent;
+        label.g_score = g_score;
+        workspace.push(side, g_score + heuristic(weights, side, node, heading_for), reached);
+        if (const auto other = workspace.find(1 - side, node, state); other != SearchWorkspace::none) {
+            meeting.offer(state, g_score + workspace(1 - side, other).g_score);
+        }
+    }
 
-            // If this path to the neighbor is better, or neighbor is not in node_map
-            if (tentative_g_score < neighbor->g_score) {
-                if (from_start) neighbor->came_from_start = current_node;
-                else neighbor->came_from_goal = current_node;
-                neighbor->g_score = tentative_g_score;
-                neighbor->f_score = neighbor->g_score +
-                                    Geometry::compute_distance(neighbor->node_object->position, end);
-                open_set.push(neighbor);
+    // An arrival at a node can be dropped by the forward side when another arrival there, at a cost lower by at
+    // least what any next step could cost it more, was reached already: whatever follows the dropped one follows
+    // the other at no more cost. That holds for every arrival by a less important class at no more cost, the
+    // next steps being as cheap or cheaper after it. The backward side reaches every arrival at a node at once,
+    // so the paths it joins through the dropped one it joins through the other at no more cost. Only the edges
+    // that stand for a state are ever reached
+    bool LayeredAStarPathfinder::dominated(SearchWorkspace &workspace, Graph::EdgeIndex arrival, double g_score,
+                                           const Graph::ProfileWeights &weights) const {
+        const auto node = graph->edge_targets[arrival];
+        const auto highway = highway_of(arrival);
+        for (auto in = graph->edges_begin(node); in < graph->edges_end(node); ++in) {
+            const auto other = graph->edge_twins[in];
+            const auto reached = other == arrival ? SearchWorkspace::none : workspace.find(0, node, other);
+            if (reached == SearchWorkspace::none || workspace(0, reached).g_score > g_score) continue;
+            double margin = 0;
+            for (auto edge = graph->edges_begin(node); edge < graph->edges_end(node); ++edge) {
+                if (!std::isfinite(weights[edge])) continue;
+                margin = std::max(margin, step_cost(highway_of(other), highway_of(edge), weights[edge]) -
+                                          step_cost(highway, highway_of(edge), weights[edge]));
             }
+            if (workspace(0, reached).g_score + margin <= g_score) return true;
         }
+        return false;
     }
 
-    // Helper function to reconstruct the path from the start to the goal
-    std::vector<std::shared_ptr<const ObjectType::Node> > LayeredAStarPathfinder::reconstruct_path(
-        std::shared_ptr<PathfinderNode> meeting_node_start,
-        std::shared_ptr<PathfinderNode> meeting_node_goal
-    ) {
-        std::vector<std::shared_ptr<const ObjectType::Node> > path;
-
-        // Build path from start to meeting node
-        std::vector<std::shared_ptr<const ObjectType::Node> > forward_path;
-        auto current = meeting_node_start;
-        while (current != nullptr) {
-            forward_path.push_back(current->node_object);
-            current = current->came_from_start;
+    // Relaxes the steps out of a state the search of `side` just closed. Forward, those are the edges out of
+    // the node it arrived at. Backward, they are the usable edges into the nodes its roads come from, each
+    // paying for the step onto the road
+    void LayeredAStarPathfinder::expand(SearchWorkspace &workspace, int side, uint32_t closed,
+                                        const Graph::ProfileWeights &weights,
+                                        const std::vector<Graph::Endpoint> &heading_for, Meeting &meeting) const {
+        const double g_score = workspace(side, closed).g_score;
+        const auto state = workspace(side, closed).edge;
+        const auto highway = highway_of(state);
+        const auto node = graph->edge_targets[state];
+        if (side == 0) {
+            for (auto edge = graph->edges_begin(node); edge < graph->edges_end(node); ++edge) {
+                const double cost = step_cost(highway, highway_of(edge), weights[edge]);
+                if (!std::isfinite(cost)) continue;
+                ++workspace.relaxed;
+                const auto next = arrival_state(edge);
+                if (dominated(workspace, next, g_score + cost, weights)) continue;
+                improve(workspace, 0, next, closed, g_score + cost, weights, heading_for, meeting);
+            }
+            return;
         }
-        std::reverse(forward_path.begin(), forward_path.end());
-
-        // Build path from meeting node to goal
-        std::vector<std::shared_ptr<const ObjectType::Node> > backward_path;
-        current = meeting_node_goal->came_from_goal; // Skip the meeting node to avoid duplication
-        while (current != nullptr) {
-            backward_path.push_back(current->node_object);
-            current = current->came_from_goal;
+        const int priority = priority_of(state);
+        for (auto back = graph->edges_begin(node); back < graph->edges_end(node); ++back) {
+            const auto road = graph->edge_twins[back];
+            if (priority_of(road) != priority || !std::isfinite(weights[road])) continue;
+            const auto from = graph->edge_targets[back];
+            for (auto out = graph->edges_begin(from); out < graph->edges_end(from); ++out) {
+                const auto edge = graph->edge_twins[out];
+                if (!std::isfinite(weights[edge])) continue;
+                ++workspace.relaxed;
+                improve(workspace, 1, arrival_state(edge), closed,
+                        g_score + step_cost(highway_of(edge), highway, weights[road]), weights, heading_for, meeting);
+            }
         }
-
-        // Combine paths
-        path.reserve(forward_path.size() + backward_path.size());
-        path.insert(path.end(), forward_path.begin(), forward_path.end());
-        path.insert(path.end(), backward_path.begin(), backward_path.end());
-
-        return path;
     }
 
-
-    std::shared_ptr<ObjectType::Node> LayeredAStarPathfinder::find_closest_node_on_highway(
-        const Geometry::Position position,
-        const double search_radius
-    ) const {
-        const auto bbox = Geometry::BoundingBox(position, search_radius);
-        auto nodes = qtree->find_node(bbox,
-                                      [&](const std::shared_ptr<ObjectType::Node> &node) {
-                                          //     std::cerr << "Evaluating predicate for node " << node->id << std::endl;
-                                          for (const auto &way: node->ways) {
-                                              if (way->tags.contains("highway")) {
-                                                  //             std::cerr << "Accept node " << node->id;
-                                                  //           std::cerr << " because of way " << way->id << std::endl;
-                                                  return true;
-                                              }
-                                          }
-                                          return false;
-                                      });
-        if (nodes.empty()) {
-            std::cerr << "No node found within given proximity: proximity is " << search_radius << ", position is "
-                    << position.latitude << " " << position.longitude << std::endl;
-            return nullptr;
+    // The nodes from the start through the meeting state to the goal, following the parents of each side.
+    // A state only tells the node it arrives at, so a start on a node is added as `start_node`
+    std::vector<Graph::NodeIndex> LayeredAStarPathfinder::reconstruct_path(SearchWorkspace &workspace,
+                                                                           Graph::EdgeIndex meeting_state,
+                                                                           Graph::NodeIndex start_node) const {
+        std::vector<Graph::NodeIndex> path;
+        const auto meeting_node = graph->edge_targets[meeting_state];
+        for (auto state = workspace.find(0, meeting_node, meeting_state); state != SearchWorkspace::none;
+             state = workspace(0, state).parent) {
+            path.push_back(graph->edge_targets[workspace(0, state).edge]);
+        }
+        if (start_node != Graph::invalid_node) path.push_back(start_node);
+        std::reverse(path.begin(), path.end());
+        for (auto state = workspace(1, workspace.find(1, meeting_node, meeting_state)).parent;
+             state != SearchWorkspace::none; state = workspace(1, state).parent) {
+            path.push_back(graph->edge_targets[workspace(1, state).edge]);
         }
-        return *std::ranges::min_element(nodes,
-                                         [=](const std::shared_ptr<ObjectType::Node> &a,
-                                             const std::shared_ptr<ObjectType::Node> &b) {
-                                             return Geometry::compute_distance(a->position, position) <
-                                                    Geometry::compute_distance(b->position, position);
-                                         });
+        return path;
     }
 
-    double LayeredAStarPathfinder::get_way_weight(ObjectType::NeighborInfo way) {
-        if (!way.tags.contains("highway")) throw std::invalid_argument("Way should be a highway");
-        else {
-            if (way.tags.contains("oneway") && way.tags.at("oneway") == "yes") {
-                if (way.is_positive_direction == false) {
-                    return -1; // negative weight will not be counted anyway;
+    std::optional<LayeredAStarPathfinder::Terminals> LayeredAStarPathfinder::locate(
+        Geometry::Position start, Geometry::Position end, const Graph::ProfileWeights &weights,
+        double max_distance) const {
+        const auto &components = weights.components;
+        Terminals terminals;
+        if (!segments) {
+            auto start_index = snap(start, &weights, max_distance);
+            auto goal_index = snap(end, &weights, max_distance);
+            if (start_index == Graph::invalid_node || goal_index == Graph::invalid_node) return std::nullopt;
+            if (!components.may_reach(start_index, goal_index)) {
+                const auto start_main = snap(start, &weights, max_distance, true);
+                const auto goal_main = snap(end, &weights, max_distance, true);
+                if (start_main != Graph::invalid_node && goal_main != Graph::invalid_node) {
+                    terminals.relocated = start_main != start_index || goal_main != goal_index;
+                    start_index = start_main;
+                    goal_index = goal_main;
                 }
             }
-            // Step 1. Compute the speed of the road
-            double speed;
-            if (way.tags.contains("maxspeed")) {
-                speed = 0.9 * std::stod(way.tags.at("maxspeed"));
-            } else {
-                const std::unordered_map<std::string, double> assumed_speed = {
-                    {"motorway", 120},
-                    {"trunk", 100},
-                    {"primary", 80},
-                    {"secondary", 60},
-                    {"tertiary", 50}
-                };
-                if (assumed_speed.contains(way.tags["highway"])) speed = assumed_speed.at(way.tags["highway"]);
-                else speed = 30; // Default speed for unknown roads
-            }
-
-            // Step 2. Retrieve the length of the road
-            double road_length = way.distance;
-
-            // Step 3. Calculate base cost
-            double cost = road_length / speed;
-
-            // Step 4. Adjust cost based on road type
-            const std::unordered_map<std::string, double> highway_bonus = {
-                {"motorway", 0.5}, // Encourage motorways most
-                {"motorway_link", 0.5},
-                {"trunk", 0.8},
-                {"trunk_link", 0.8},
-                {"primary", 1.0},
-                {"primary_link", 1.0},
-                {"secondary", 3.0},
-                {"secondary_link", 3.0},
-                {"tertiary", 10.0},
-                {"tertiary_link", 10.0},
-                {"unclassified", 1000.0},
-                {"residential", 10000.0}
-           //     {"service", 10} // don't use service roads unless absolutely necessary
-            };
+            terminals.sources = {{start_index, 0}};
+            terminals.targets = {{goal_index, 0}};
+            return terminals;
+        }
 
-            if (highway_bonus.contains(way.tags["highway"])) {
-                cost *= highway_bonus.at(way.tags["highway"]);
+        auto place = [&](const Graph::EdgePoint &start_point, const Graph::EdgePoint &goal_point) {
+            terminals.start = start_point;
+            terminals.goal = goal_point;
+            terminals.sources = start_point.departures(weights);
+            terminals.targets = goal_point.arrivals(weights);
+            terminals.direct = false;
+            if (start_point.forward == goal_point.forward) {
+                // Going straight along the segment beats any detour that leaves it and comes back
+                const double from = start_point.fraction, to = goal_point.fraction;
+                terminals.direct = (from <= to && std::isfinite(weights[start_point.forward])) ||
+                                   (from >= to && std::isfinite(weights[start_point.backward]));
             }
-            return cost;
+        };
+        const auto start_point = segments->nearest(*graph, start, max_distance, weights);
+        const auto goal_point = segments->nearest(*graph, end, max_distance, weights);
+        if (!start_point || !goal_point) return std::nullopt;
+        place(*start_point, *goal_point);
+        if (terminals.direct || components.may_reach(terminals.sources, terminals.targets)) return terminals;
+
+        // Segments the profile can use with both ends in the largest component
+        auto in_largest = [&](const Graph::SegmentIndex::Segment &segment) {
+            return (std::isfinite(weights[segment.forward]) || std::isfinite(weights[segment.backward])) &&
+                   components.in_largest(graph->edge_targets[segment.forward]) &&
+                   components.in_largest(graph->edge_targets[segment.backward]);
+        };
+        const auto start_main = segments->nearest(*graph, start, max_distance, in_largest);
+        const auto goal_main = segments->nearest(*graph, end, max_distance, in_largest);
+        if (start_main && goal_main) {
+            place(*start_main, *goal_main);
+            terminals.relocated = start_main->forward != start_point->forward ||
+                                  goal_main->forward != goal_point->forward;
         }
+        return terminals;
     }
 
+    void LayeredAStarPathfinder::require_route(const Terminals &terminals, const Graph::ProfileWeights &weights) {
+        if (terminals.direct || weights.components.may_reach(terminals.sources, terminals.targets)) return;
+        auto component_of = [&](const std::vector<Graph::Endpoint> &endpoints) {
+            return endpoints.empty()
+                       ? std::numeric_limits<uint32_t>::max()
+                       : weights.components.component[endpoints.front().node];
+        };
+        throw Unreachable(component_of(terminals.sources), component_of(terminals.targets));
+    }
 
-    std::vector<LayeredAStarPathfinder::NodeWayPair>
-    LayeredAStarPathfinder::get_neighbors(
-        const std::shared_ptr<const ObjectType::Node> &node,
-        const std::map<std::string, std::string> &preferences,
-        int layer, // TODO: refactor this! This argument is unused, pass whatever you want.
-        std::unordered_map<int64_t, std::shared_ptr<PathfinderNode> > &node_map
-    ) {
-        const auto &neighbor_map = node->neighbors;
-        std::vector<NodeWayPair> ret;
-
-        // Get current highway type from the `PathfinderNode`
-        std::string current_highway = node_map[node->id]->current_highway;
-
-        for (const auto &[target, way_to_target]: neighbor_map) {
-            if (way_to_target.tags.contains("highway")) {
-                double way_weight = get_way_weight(way_to_target);
-                std::string target_highway = way_to_target.tags.at("highway");
-                // Discourage transitions off highways
-                const std::unordered_map<std::string, int> highway_priority = {
-                    {"motorway", 1},{"motorway_link", 1},
-                    {"trunk", 2}, {"trunk_link", 2},
-                    {"primary", 3},{"primary_link", 3},
-                    {"secondary", 4},{"secondary_link", 4},
-                    {"tertiary", 5},{"tertiary_link", 5},
-                    {"unclassified", 6},
-                    {"residential", 7}
-                };
+    std::vector<std::shared_ptr<const ObjectType::Node> > LayeredAStarPathfinder::make_path(
+        const Terminals &terminals, const std::vector<Graph::NodeIndex> &nodes) const {
+        std::vector<std::shared_ptr<const ObjectType::Node> > path;
+        auto add_point = [&](const Graph::EdgePoint &point) {
+            auto node = std::make_shared<ObjectType::Node>(0);
+            node->position = point.position;
+            path.push_back(node);
+        };
+        // A point that falls on a node is that node
+        auto is_at = [](const Graph::EdgePoint &point, Graph::NodeIndex node) {
+            return (point.fraction == 0 && point.from == node) || (point.fraction == 1 && point.to == node);
+        };
+        if (terminals.start && (nodes.empty() || !is_at(*terminals.start, nodes.front()))) add_point(*terminals.start);
+        for (const auto node: nodes) path.push_back(graph->make_node(node));
+        if (terminals.goal && (nodes.empty() || !is_at(*terminals.goal, nodes.back()))) add_point(*terminals.goal);
+        return path;
+    }
 
-                int current_priority = highway_priority.contains(current_highway)
-                                           ? highway_priority.at(current_highway)
-                                           : 100;
-                int target_priority = highway_priority.contains(target_highway)
-                                          ? highway_priority.at(target_highway)
-                                          : 100;
+    Graph::NodeIndex LayeredAStarPathfinder::snap(Geometry::Position position, const Graph::ProfileWeights *weights,
+                                                  double max_distance, bool largest_component) const {
+        if (!node_tree) {
+            throw std::logic_error("No node tree to snap onto");
+        }
+        std::vector<Util::FlatQuadTree::Neighbor> nearest;
+        node_tree->nearest(position, 1, max_distance, [&](uint32_t node) {
+            return !weights || (weights->routable[node] &&
+                                (!largest_component || weights->components.in_largest(node)));
+        }, nearest);
+        return nearest.empty() ? Graph::invalid_node : nearest.front().index;
+    }
 
-                if (current_priority < target_priority) {
-                    way_weight *= 3; // Penalty for downgrading
-                } else {
-                    way_weight *= 0.5; // Bonus for upgrading
-                }
+    LayeredAStarPathfinder::SearchTotals LayeredAStarPathfinder::totals() const {
+        return {
+            total_searches.load(), total_settled.load(), total_relaxed.load(), total_heap_operations.load(),
+            total_unreachable.load(), total_stopped_early.load()
+        };
+    }
 
-                if (way_weight >= 0) {
-                    // Get or create the PathfinderNode for the target node
-                    std::shared_ptr<PathfinderNode> neighbor_node;
-                    if (node_map.contains(target->id)) {
-                        neighbor_node = node_map.at(target->id);
-                    } else {
-                        neighbor_node = std::make_shared<PathfinderNode>(PathfinderNode{
-                            .node_object = target,
-                            .f_score = std::numeric_limits<double>::infinity(),
-                            .g_score = std::numeric_limits<double>::infinity(),
-                            .came_from_start = nullptr,
-                            .came_from_goal = nullptr,
-                            .current_highway = target_highway // Update highway level
-                        });
-                        node_map[target->id] = neighbor_node;
-                    }
+    void LayeredAStarPathfinder::record(const SearchWorkspace::Stats &stats, bool unreachable, bool stopped_early) {
+        ++total_searches;
+        total_settled += stats.settled;
+        total_relaxed += stats.relaxed;
+        total_heap_operations += stats.pushes + stats.decreases + stats.pops;
+        if (unreachable) ++total_unreachable;
+        if (stopped_early) ++total_stopped_early;
+    }
 
-                    // Create the NodeWayPair and push it to the result
-                    ret.push_back(NodeWayPair{
-                        way_weight, way_to_target, neighbor_node
-                    });
-                }
-            }
+    double LayeredAStarPathfinder::suboptimality(const std::map<std::string, std::string> &preferences) {
+        const auto it = preferences.find("suboptimality");
+        if (it == preferences.end()) return 1;
+        size_t used = 0;
+        double result = 0;
+        try {
+            result = std::stod(it->second, &used);
+        } catch (const std::exception &) {
+            used = 0;
         }
+        if (used == 0 || used != it->second.size() || !(result >= 1) || !std::isfinite(result)) {
+            throw std::invalid_argument("Invalid value for suboptimality: " + it->second);
+        }
+        return result;
+    }
 
-        return ret;
+    double LayeredAStarPathfinder::snap_distance(const std::map<std::string, std::string> &preferences) const {
+        const auto it = preferences.find("snap_distance");
+        if (it == preferences.end()) return max_snap_distance;
+        size_t used = 0;
+        double result = 0;
+        try {
+            result = std::stod(it->second, &used);
+        } catch (const std::exception &) {
+            used = 0;
+        }
+        if (used == 0 || used != it->second.size() || !(result > 0)) {
+            throw std::invalid_argument("Invalid value for snap_distance: " + it->second);
+        }
+        return result;
     }
 }
-
@@ -4,12 +4,34 @@
 
 #ifndef LAYEREDASTARPATHFINDER_H
 #define LAYEREDASTARPATHFINDER_H
-#include <queue>
+#include <atomic>
+#include <optional>
+#include <stdexcept>
 
 #include "AbstractPathfinder.h"
+#include "FlatQuadTree.h"
+#include "RoutingGraph.h"
+#include "RoutingProfile.h"
+#include "SearchWorkspace.h"
+#include "SegmentIndex.h"
 
 
 namespace Foliage::Pathfinder {
+    /**
+     * Thrown for a query whose ends are in parts of the network that no route joins, as the connected
+     * components of its profile show without a search.
+     */
+    class Unreachable : public std::runtime_error {
+    public:
+        Unreachable(uint32_t start_component, uint32_t goal_component):
+            std::runtime_error("No route joins the start and the goal"),
+            start_component(start_component),
+            goal_component(goal_component) {
+        }
+
+        uint32_t start_component, goal_component; // Strongly connected components the ends snapped into
+    };
+
     class LayeredAStarPathfinder : AbstractPathfinder {
     public:
         std::vector<std::shared_ptr<const ObjectType::Node> > get_path(
@@ -18,63 +40,158 @@ namespace Foliage::Pathfinder {
             std::map<std::string, std::string> preferences
         ) override;
 
-        struct PathfinderNode {
-            std::shared_ptr<const ObjectType::Node> node_object;
-            double f_score = 0.0, g_score = 0.0;
-            std::shared_ptr<PathfinderNode> came_from_start = nullptr;
-            std::shared_ptr<PathfinderNode> came_from_goal = nullptr;
-            std::string current_highway;
-            bool operator<(const PathfinderNode& rhs) const {
-                return f_score < rhs.f_score;
-            }
+        /**
+         * @param relocated When given, set to whether both ends moved into the largest component of the profile,
+         * away from closest places that cannot reach each other
+         */
+        std::vector<std::shared_ptr<const ObjectType::Node> > get_path(
+            Geometry::Position start,
+            Geometry::Position end,
+            const std::map<std::string, std::string> &preferences,
+            bool *relocated
+        );
+
+        explicit LayeredAStarPathfinder(std::shared_ptr<const Graph::RoutingGraph> graph = nullptr,
+                                        std::shared_ptr<Graph::ProfileSet> profiles = nullptr):
+            graph(graph),
+            profiles(profiles || !graph ? profiles : std::make_shared<Graph::ProfileSet>(graph)),
+            node_tree(graph
+                          ? std::make_shared<const Util::FlatQuadTree>(
+                              Util::FlatQuadTree::build(graph->latitudes, graph->longitudes, graph->projection))
+                          : nullptr) {
+        }
+
+        ~LayeredAStarPathfinder() override {
+        }
+
+        std::shared_ptr<const Graph::RoutingGraph> graph;
+        std::shared_ptr<Graph::ProfileSet> profiles; // Compiled edge weights, selected by the query preferences
+        // Over the graph nodes, for snapping without a segment index. Built with the graph when one is given
+        std::shared_ptr<const Util::FlatQuadTree> node_tree;
+        // Over the graph segments; when set, queries start and end on the closest point of a road
+        std::shared_ptr<const Graph::SegmentIndex> segments;
+
+        double max_snap_distance = 1000; // Metres, unless a query sets its own "snap_distance"
+
+        /**
+         * @param weights When given, only nodes this profile can route from or to are considered
+         * @param largest_component Only consider nodes in the largest component of `weights`
+         * @return The routing graph node closest to a position, or invalid_node if none is within `max_distance`
+         * @throws std::logic_error If there is no node_tree
+         */
+        [[nodiscard]] Graph::NodeIndex snap(Geometry::Position position, const Graph::ProfileWeights *weights,
+                                            double max_distance, bool largest_component = false) const;
+
+        /**
+         * @return The "snap_distance" of a query's preferences, or max_snap_distance if it has none
+         */
+        [[nodiscard]] double snap_distance(const std::map<std::string, std::string> &preferences) const;
+
+        /**
+         * @return The "suboptimality" of a query's preferences, 1 if it has none: the search may stop once its
+         * path costs at most that many times the cheapest one
+         */
+        [[nodiscard]] static double suboptimality(const std::map<std::string, std::string> &preferences);
+
+        /**
+         * The layered cost model: taking an edge onto a less important class of road costs more than its
+         * weight, onto the same or a more important one less. The first edge of a route counts as taken
+         * after HighwayClass::Other.
+         * @return The cost of an edge of class `to` and weight `weight`, taken after one of class `from`
+         */
+        [[nodiscard]] static double step_cost(Graph::HighwayClass from, Graph::HighwayClass to, double weight);
+
+        // Work of every search this pathfinder has run, for tuning. The stats of the last search of a thread
+        // are in SearchWorkspace::local().stats()
+        struct SearchTotals {
+            uint64_t searches;
+            uint64_t settled;
+            uint64_t relaxed;
+            uint64_t heap_operations;
+            uint64_t unreachable; // Searches that found no path
+            uint64_t stopped_early; // Searches a suboptimality factor cut short
         };
 
-        struct NodeWayPair {
-            double way_weight;
-            ObjectType::NeighborInfo way;
-            std::shared_ptr<PathfinderNode> node;
+        [[nodiscard]] SearchTotals totals() const;
+
+        // Where a query meets the network
+        struct Terminals {
+            std::vector<Graph::Endpoint> sources, targets;
+            std::optional<Graph::EdgePoint> start, goal; // Set when snapped onto segments
+            bool direct = false; // Both points are on one segment, in an order the profile may follow
+            bool relocated = false; // Both ends moved into the largest component, off the closest places
         };
 
-        LayeredAStarPathfinder(std::shared_ptr<Util::QuadTree> qtree = nullptr): qtree(qtree) {
-        }
+        /**
+         * Snaps both ends of a query, onto segments if there is a segment index and onto nodes otherwise.
+         * If the closest places cannot reach each other, such as a oneway dead end next to a through road,
+         * both ends move into the largest component of the profile when it is within `max_distance` of them,
+         * and the terminals are marked as relocated.
+         * @return Nothing if either end is not within `max_distance` of anything the profile can use
+         */
+        [[nodiscard]] std::optional<Terminals> locate(Geometry::Position start, Geometry::Position end,
+                                                      const Graph::ProfileWeights &weights,
+                                                      double max_distance) const;
+
+        /**
+         * @throws Unreachable If no route can join the ends, which saves searching all that one end can reach
+         */
+        static void require_route(const Terminals &terminals, const Graph::ProfileWeights &weights);
+
+        /**
+         * @param nodes The path between a source and a target of `terminals`, empty for a direct one
+         * @return The path with the projected start and goal points added as nodes of id 0
+         */
+        [[nodiscard]] std::vector<std::shared_ptr<const ObjectType::Node> > make_path(
+            const Terminals &terminals, const std::vector<Graph::NodeIndex> &nodes) const;
+
+    private:
+        // The cheapest path the two sides have joined into so far, at the state both have reached
+        struct Meeting {
+            Graph::EdgeIndex state = Graph::invalid_edge;
+            double cost = std::numeric_limits<double>::infinity();
+
+            void offer(Graph::EdgeIndex at, double through) {
+                if (through < cost) {
+                    state = at;
+                    cost = through;
+                }
+            }
+        };
 
-        ~LayeredAStarPathfinder() override {
+        [[nodiscard]] Graph::HighwayClass highway_of(Graph::EdgeIndex edge) const {
+            return graph->attributes[graph->edge_attributes[edge]].highway;
         }
 
-        static double get_way_weight(ObjectType::NeighborInfo way);
+        [[nodiscard]] int priority_of(Graph::EdgeIndex edge) const;
 
-        std::shared_ptr<Util::QuadTree> qtree;
+        /**
+         * @return The edge that stands for arriving by `edge`: the first edge into the same node whose road has
+         * the same priority
+         */
+        [[nodiscard]] Graph::EdgeIndex arrival_state(Graph::EdgeIndex edge) const;
 
-        [[nodiscard]] std::shared_ptr<ObjectType::Node> find_closest_node_on_highway(
-            Geometry::Position position, double search_radius = 0.005) const;
+        [[nodiscard]] double heuristic(const Graph::ProfileWeights &weights, int side, Graph::NodeIndex node,
+                                       const std::vector<Graph::Endpoint> &heading_for) const;
 
+        [[nodiscard]] bool dominated(SearchWorkspace &workspace, Graph::EdgeIndex arrival, double g_score,
+                                     const Graph::ProfileWeights &weights) const;
 
-        static std::vector<LayeredAStarPathfinder::NodeWayPair>
-        get_neighbors(
-            const std::shared_ptr<const ObjectType::Node> &node,
-            const std::map<std::string, std::string> &preferences,
-            int layer,
-            std::unordered_map<int64_t, std::shared_ptr<PathfinderNode> > &node_map
-        );
+        void improve(SearchWorkspace &workspace, int side, Graph::EdgeIndex state, uint32_t parent,
+                     double g_score, const Graph::ProfileWeights &weights,
+                     const std::vector<Graph::Endpoint> &heading_for, Meeting &meeting) const;
 
-        static void expand_neighbors(
-            const std::shared_ptr<PathfinderNode> &current_node,
-            std::priority_queue<std::shared_ptr<PathfinderNode>, std::vector<std::shared_ptr<PathfinderNode>>,
-            std::function<bool(const std::shared_ptr<PathfinderNode> &, const std::shared_ptr<PathfinderNode>
-                &)>> &open_set,
-            std::unordered_set<int64_t> &closed_set_ids,
-            std::unordered_map<int64_t, std::shared_ptr<PathfinderNode>> &node_map,
-            const std::map<std::string, std::string> &preferences,
-            const Geometry::Position &start,
-            const Geometry::Position &end,
-            int current_layer,
-            bool from_start
-        );
+        void expand(SearchWorkspace &workspace, int side, uint32_t closed, const Graph::ProfileWeights &weights,
+                    const std::vector<Graph::Endpoint> &heading_for, Meeting &meeting) const;
 
-        static std::vector<std::shared_ptr<const ObjectType::Node> > reconstruct_path(
-            std::shared_ptr<PathfinderNode> current_start,
-            std::shared_ptr<PathfinderNode> current_goal
-        );
+        void record(const SearchWorkspace::Stats &stats, bool unreachable, bool stopped_early);
+
+        [[nodiscard]] std::vector<Graph::NodeIndex> reconstruct_path(SearchWorkspace &workspace,
+                                                                     Graph::EdgeIndex meeting_state,
+                                                                     Graph::NodeIndex start_node) const;
+
+        std::atomic<uint64_t> total_searches{0}, total_settled{0}, total_relaxed{0}, total_heap_operations{0};
+        std::atomic<uint64_t> total_unreachable{0}, total_stopped_early{0};
     };
 }
 
@@ -1,54 +1,186 @@
 // osm.cpp
 #include "OSM.h"
 
+#include <cctype>
+#include <charconv>
+#include <deque>
 #include <iostream>
 #include <memory>
+#include <optional>
+
+#include "ThreadPool.h"
+#include "XMLStreamReader.h"
 
 namespace Foliage::DataProvider::OSM {
+    namespace {
+        std::string_view find_attribute(std::span<const XMLAttribute> attributes, std::string_view name) {
+            for (const auto &attribute: attributes) {
+                if (attribute.name == name) return attribute.value;
+            }
+            return {};
+        }
+
+        template<typename T>
+        T numeric_attribute(std::span<const XMLAttribute> attributes, std::string_view name) {
+            const auto value = find_attribute(attributes, name);
+            T result{};
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+            if (value.empty() || ec != std::errc() || ptr != value.data() + value.size()) {
+                throw std::runtime_error("Invalid or missing attribute \"" + std::string(name) + "\"");
+            }
+            return result;
+        }
+
+        // Small enough that a file gives the pool a few pieces per thread
+        constexpr size_t piece_size = 1 << 20;
+
+        struct DecodedPiece {
+            DecodedBlock block;
+            std::optional<BoundingBox> bounds;
+            bool found_root = false;
+        };
+
+        /**
+         * Decodes the objects of one piece of the file from the XML stream, without a DOM.
+         * Like the DOM path, only <bounds>, <node> and <way> children of <osm> are read.
+         */
+        class PieceBuilder final : public XMLStreamHandler {
+        public:
+            // Pieces after the first start inside <osm>
+            PieceBuilder(DecodedPiece &piece, bool first): piece(piece), depth(first ? 0 : 1) {}
+
+            void start_element(std::string_view name, std::span<const XMLAttribute> attributes) override {
+                ++depth;
+                if (depth == 1) {
+                    if (name != "osm") throw std::runtime_error("No <osm> tag found, check file integrity");
+                    piece.found_root = true;
+                } else if (depth == 2) {
+                    if (name == "node") {
+                        auto &node = piece.block.nodes.emplace_back(
+                            std::make_shared<ObjectType::Node>(numeric_attribute<int64_t>(attributes, "id")));
+                        node->position.latitude = numeric_attribute<double>(attributes, "lat");
+                        node->position.longitude = numeric_attribute<double>(attributes, "lon");
+                        current = node.get();
+                    } else if (name == "way") {
+                        way = &piece.block.ways.emplace_back(
+                            std::make_shared<ObjectType::Way>(numeric_attribute<int64_t>(attributes, "id")));
+                        current = way->way.get();
+                    } else if (name == "bounds") {
+                        piece.bounds = BoundingBox(
+                            {
+                                .latitude = numeric_attribute<double>(attributes, "minlat"),
+                                .longitude = numeric_attribute<double>(attributes, "minlon"),
+                            },
+                            {
+                                .latitude = numeric_attribute<double>(attributes, "maxlat"),
+                                .longitude = numeric_attribute<double>(attributes, "maxlon"),
+                            }
+                        );
+                    }
+                } else if (depth == 3 && current) {
+                    if (name == "tag") {
+                        current->tags[std::string(find_attribute(attributes, "k"))] =
+                            std::string(find_attribute(attributes, "v"));
+                    } else if (name == "nd" && way) {
+                        way->refs.push_back(numeric_attribute<int64_t>(attributes, "ref"));
+                    }
+                }
+            }
+
+            void end_element(std::string_view) override {
+                if (depth == 2) {
+                    way = nullptr;
+                    current = nullptr;
+                }
+                --depth;
+            }
+
+        private:
+            DecodedPiece &piece;
+            int depth;
+            DecodedWay *way = nullptr;
+            ObjectType::Object *current = nullptr;
+        };
+
+        DecodedPiece decode_piece(std::string &text, bool first) {
+            DecodedPiece piece;
+            PieceBuilder builder(piece, first);
+            std::vector<XMLAttribute> attributes;
+            const size_t consumed = XMLStreamReader::read_buffer(text.data(), text.size(), builder, attributes);
+            for (size_t i = consumed; i < text.size(); ++i) {
+                if (!std::isspace(static_cast<unsigned char>(text[i]))) {
+                    throw std::runtime_error("Unexpected end of XML file");
+                }
+            }
+            return piece;
+        }
+    }
 
     void Document::reset() {
-        nodes_by_id.clear();
-        ways_by_id.clear();
-        qtree = Util::QuadTree(BoundingBox({-1,-1},{-1,-1}),10);
+        AbstractDocument::reset();
+        doc.Clear();
     }
 
     void Document::load() {
+        if (loader == Loader::Streaming) {
+            load_streaming();
+            return;
+        }
+        timings.restart();
         auto result = doc.LoadFile(xmlFile.c_str());
         if (result != tinyxml2::XML_SUCCESS) {
             std::cerr << result << std::endl;
             throw std::runtime_error("Error loading XML file");
         }
+        timings.lap("dom");
     }
 
-    std::shared_ptr<ObjectType::Object> Document::get_object_by_id(int64_t id) const {
-        auto node_it = nodes_by_id.find(id);
-        if (node_it != nodes_by_id.end()) {
-            return node_it->second;
-        }
-        auto way_it = ways_by_id.find(id);
-        if (way_it != ways_by_id.end()) {
-            return way_it->second;
+    void Document::load_streaming() {
+        // Pieces are tokenized on the thread pool while the next ones are being read
+        auto &pool = Util::ThreadPool::shared();
+        const size_t max_in_flight = pool.size() * 4;
+        XMLChunkReader reader(xmlFile, {"node", "way", "relation"}, piece_size);
+        std::vector<DecodedPiece> pieces;
+        std::deque<std::future<DecodedPiece>> in_flight;
+        timings.restart();
+
+        std::string chunk;
+        for (bool first = true; reader.next(chunk); first = false) {
+            if (in_flight.size() >= max_in_flight) {
+                pieces.push_back(in_flight.front().get());
+                in_flight.pop_front();
+            }
+            in_flight.push_back(pool.submit([text = std::move(chunk), first]() mutable {
+                return decode_piece(text, first);
+            }));
+            chunk = std::string();
         }
-        throw std::runtime_error("Object not found");
-    }
+        for (auto &piece: in_flight) pieces.push_back(piece.get());
+        timings.lap("tokenize");
 
-    std::shared_ptr<ObjectType::Node> Document::get_node_by_id(int64_t id) const {
-        auto it = nodes_by_id.find(id);
-        if (it == nodes_by_id.end()) {
-            throw std::runtime_error("Node not found");
+        if (pieces.empty() || !pieces.front().found_root) {
+            throw std::runtime_error("No <osm> tag found, check file integrity");
         }
-        return std::dynamic_pointer_cast<ObjectType::Node>(it->second);
+        std::vector<DecodedBlock> blocks;
+        blocks.reserve(pieces.size());
+        for (auto &piece: pieces) {
+            if (piece.bounds) border = *piece.bounds;
+            blocks.push_back(std::move(piece.block));
+        }
+        pieces = {};
+        link(blocks);
     }
 
-    std::shared_ptr<ObjectType::Way> Document::get_way_by_id(int64_t id) const {
-        auto it = ways_by_id.find(id);
-        if (it == ways_by_id.end()) {
-            throw std::runtime_error("Way not found");
+    void Document::parse() {
+        timings.restart();
+        if (loader == Loader::DOM) {
+            parse_dom();
+            doc.Clear(); // Everything we need is in the tables now
+            timings.lap("dom tables");
         }
-        return std::dynamic_pointer_cast<ObjectType::Way>(it->second);
     }
 
-    void Document::parse() {
+    void Document::parse_dom() {
         auto root = doc.FirstChildElement("osm");
         if (!root) {
             throw std::runtime_error("No <osm> tag found, check file integrity");
@@ -106,13 +238,5 @@ namespace Foliage::DataProvider::OSM {
                 way->tags[tagElement->Attribute("k")] = tagElement->Attribute("v");
             }
         }
-
-        // Precompute neighbors for all nodes
-        qtree.bounding_box = this->border;
-        for (const auto& [_, node]: nodes_by_id) {
-            node->compute_neighbors();
-            qtree.insert(node);
-        }
-
     }
 }
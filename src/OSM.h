@@ -18,31 +18,34 @@
 
 namespace Foliage::DataProvider::OSM {
     using namespace Foliage::Geometry;
-    class Document final : AbstractDocument {
+    class Document final : public AbstractDocument {
+    public:
+        enum class Loader {
+            Streaming, // Single pass over the file, pieces of it are decoded in parallel
+            DOM        // Whole file through tinyxml2 first, then walk the tree
+        };
+
     private:
         tinyxml2::XMLDocument doc;
         std::string xmlFile;
+        Loader loader;
+
+        void load_streaming();
+        void parse_dom();
 
     public:
-        std::unordered_map<int64_t, std::shared_ptr<ObjectType::Node>> nodes_by_id;
-        std::unordered_map<int64_t, std::shared_ptr<ObjectType::Way>> ways_by_id;
-        Util::QuadTree qtree;
-        BoundingBox border;
         /**
          * Loads a file from the FS as a XMLDocument
          * @param xmlFile The file to load from
+         * @param loader Whether to stream the file or to build a DOM first
          */
-        explicit Document(std::string xmlFile = ""):
+        explicit Document(std::string xmlFile = "", Loader loader = Loader::Streaming):
             xmlFile(std::move(xmlFile)),
-            qtree(Util::QuadTree(BoundingBox({-1, -1}, {-1, -1}), 10)) {}
-         std::shared_ptr<ObjectType::Object> get_object_by_id(int64_t id) const override;
-
-         std::shared_ptr<ObjectType::Node> get_node_by_id(int64_t id) const override;
-
-         std::shared_ptr<ObjectType::Way> get_way_by_id(int64_t id) const override;
+            loader(loader) {}
 
-        void set_document(std::string xmlFile = "") {
+        void set_document(std::string xmlFile = "", Loader loader = Loader::Streaming) {
             this->xmlFile = std::move(xmlFile);
+            this->loader = loader;
         }
         void load() override;
         void reset() override;
@@ -0,0 +1,298 @@
+#include "PBF.h"
+
+#include <array>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <zlib.h>
+
+#include "object.h"
+#include "Protobuf.h"
+#include "ThreadPool.h"
+
+namespace Foliage::DataProvider::PBF {
+    namespace {
+        constexpr size_t max_header_size = 64 * 1024;
+        constexpr size_t max_blob_size = 32 * 1024 * 1024;
+
+        // Unwraps a Blob message into the serialized block it carries
+        std::string inflate_blob(std::string_view blob) {
+            ProtobufReader reader(blob);
+            std::string_view zlib_data;
+            uint64_t raw_size = 0;
+            while (reader.next()) {
+                switch (reader.field()) {
+                    case 1: return std::string(reader.bytes()); // raw
+                    case 2: raw_size = reader.varint(); break;
+                    case 3: zlib_data = reader.bytes(); break;
+                    case 4: case 5: case 6: case 7:
+                        throw std::runtime_error("Unsupported PBF blob compression");
+                    default: reader.skip();
+                }
+            }
+            if (raw_size > max_blob_size) throw std::runtime_error("PBF blob too large");
+
+            std::string result(raw_size, '\0');
+            auto result_size = static_cast<uLongf>(raw_size);
+            if (uncompress(reinterpret_cast<Bytef *>(result.data()), &result_size,
+                           reinterpret_cast<const Bytef *>(zlib_data.data()), zlib_data.size()) != Z_OK ||
+                result_size != raw_size) {
+                throw std::runtime_error("Corrupt zlib data in PBF blob");
+            }
+            return result;
+        }
+
+        // Per-block state needed to turn raw values into objects
+        struct BlockContext {
+            std::vector<std::string_view> strings;
+            int64_t granularity = 100, lat_offset = 0, lon_offset = 0;
+
+            // Dividing the exact integer keeps the result identical to parsing the XML decimal
+            [[nodiscard]] double latitude(int64_t raw) const {
+                return static_cast<double>(lat_offset + granularity * raw) / 1e9;
+            }
+
+            [[nodiscard]] double longitude(int64_t raw) const {
+                return static_cast<double>(lon_offset + granularity * raw) / 1e9;
+            }
+
+            void set_tags(ObjectType::Object &object, const std::vector<uint32_t> &keys,
+                          const std::vector<uint32_t> &values) const {
+                if (keys.size() != values.size()) throw std::runtime_error("Mismatched tag keys and values");
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    object.tags[std::string(strings.at(keys[i]))] = std::string(strings.at(values[i]));
+                }
+            }
+        };
+
+        void append_uint32(std::vector<uint32_t> &values, ProtobufReader &message) {
+            message.packed_varint([&](uint64_t v) { values.push_back(static_cast<uint32_t>(v)); });
+        }
+
+        void decode_node(ProtobufReader message, const BlockContext &context, DecodedBlock &result) {
+            auto node = std::make_shared<ObjectType::Node>();
+            std::vector<uint32_t> keys, values;
+            while (message.next()) {
+                switch (message.field()) {
+                    case 1: node->id = message.sint64(); break;
+                    case 2: append_uint32(keys, message); break;
+                    case 3: append_uint32(values, message); break;
+                    case 8: node->position.latitude = context.latitude(message.sint64()); break;
+                    case 9: node->position.longitude = context.longitude(message.sint64()); break;
+                    default: message.skip();
+                }
+            }
+            context.set_tags(*node, keys, values);
+            result.nodes.push_back(std::move(node));
+        }
+
+        void decode_dense_nodes(ProtobufReader message, const BlockContext &context, DecodedBlock &result) {
+            std::vector<int64_t> ids, lats, lons;
+            std::vector<uint32_t> keys_vals;
+            while (message.next()) {
+                switch (message.field()) {
+                    case 1: message.packed_sint64([&](int64_t v) { ids.push_back(v); }); break;
+                    case 8: message.packed_sint64([&](int64_t v) { lats.push_back(v); }); break;
+                    case 9: message.packed_sint64([&](int64_t v) { lons.push_back(v); }); break;
+                    case 10: append_uint32(keys_vals, message); break;
+                    default: message.skip();
+                }
+            }
+            if (lats.size() != ids.size() || lons.size() != ids.size()) {
+                throw std::runtime_error("Mismatched DenseNodes arrays");
+            }
+
+            // Everything is delta coded
+            int64_t id = 0, lat = 0, lon = 0;
+            size_t kv = 0;
+            result.nodes.reserve(result.nodes.size() + ids.size());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                id += ids[i];
+                lat += lats[i];
+                lon += lons[i];
+                auto node = std::make_shared<ObjectType::Node>(id);
+                node->position.latitude = context.latitude(lat);
+                node->position.longitude = context.longitude(lon);
+                // keys_vals holds key, value pairs per node, each node terminated by 0
+                while (kv < keys_vals.size() && keys_vals[kv] != 0) {
+                    if (kv + 1 >= keys_vals.size()) throw std::runtime_error("Truncated DenseNodes tags");
+                    node->tags[std::string(context.strings.at(keys_vals[kv]))] =
+                        std::string(context.strings.at(keys_vals[kv + 1]));
+                    kv += 2;
+                }
+                ++kv;
+                result.nodes.push_back(std::move(node));
+            }
+        }
+
+        void decode_way(ProtobufReader message, const BlockContext &context, DecodedBlock &result) {
+            DecodedWay decoded{std::make_shared<ObjectType::Way>(), {}};
+            std::vector<uint32_t> keys, values;
+            while (message.next()) {
+                switch (message.field()) {
+                    case 1: decoded.way->id = static_cast<int64_t>(message.varint()); break;
+                    case 2: append_uint32(keys, message); break;
+                    case 3: append_uint32(values, message); break;
+                    case 8: {
+                        int64_t ref = 0;
+                        message.packed_sint64([&](int64_t v) { decoded.refs.push_back(ref += v); });
+                        break;
+                    }
+                    default: message.skip();
+                }
+            }
+            context.set_tags(*decoded.way, keys, values);
+            result.ways.push_back(std::move(decoded));
+        }
+
+        DecodedBlock decode_primitive_block(std::string_view data) {
+            BlockContext context;
+            std::vector<std::string_view> groups;
+
+            ProtobufReader block(data);
+            while (block.next()) {
+                switch (block.field()) {
+                    case 1: {
+                        auto table = block.message();
+                        while (table.next()) {
+                            if (table.field() == 1) context.strings.push_back(table.bytes());
+                            else table.skip();
+                        }
+                        break;
+                    }
+                    case 2: groups.push_back(block.bytes()); break;
+                    case 17: context.granularity = static_cast<int64_t>(block.varint()); break;
+                    case 19: context.lat_offset = static_cast<int64_t>(block.varint()); break;
+                    case 20: context.lon_offset = static_cast<int64_t>(block.varint()); break;
+                    default: block.skip();
+                }
+            }
+
+            DecodedBlock result;
+            for (const auto group_data: groups) {
+                ProtobufReader group(group_data);
+                while (group.next()) {
+                    switch (group.field()) {
+                        case 1: decode_node(group.message(), context, result); break;
+                        case 2: decode_dense_nodes(group.message(), context, result); break;
+                        case 3: decode_way(group.message(), context, result); break;
+                        default: group.skip(); // Relations and changesets are not used
+                    }
+                }
+            }
+            return result;
+        }
+
+        bool read_exactly(std::ifstream &in, std::string &buffer, size_t size) {
+            buffer.resize(size);
+            in.read(buffer.data(), static_cast<std::streamsize>(size));
+            return static_cast<size_t>(in.gcount()) == size;
+        }
+    }
+
+    void Document::load() {
+        std::ifstream in(pbfFile, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Error opening PBF file " + pbfFile);
+        }
+
+        // Blocks are decoded on the pool while the file is being read, and linked once all of them are done
+        auto &pool = Util::ThreadPool::shared();
+        const size_t max_in_flight = pool.size() * 4;
+        std::vector<DecodedBlock> blocks;
+        std::deque<std::future<DecodedBlock>> in_flight;
+        bool found_header = false, has_bbox = false;
+        timings.restart();
+
+        std::string header, blob;
+        while (true) {
+            std::array<unsigned char, 4> length_bytes{};
+            in.read(reinterpret_cast<char *>(length_bytes.data()), 4);
+            if (in.gcount() == 0) break;
+            if (in.gcount() != 4) throw std::runtime_error("Truncated PBF file");
+            const uint32_t header_size = length_bytes[0] << 24 | length_bytes[1] << 16 |
+                                         length_bytes[2] << 8 | length_bytes[3];
+            if (header_size > max_header_size || !read_exactly(in, header, header_size)) {
+                throw std::runtime_error("Invalid PBF blob header");
+            }
+
+            std::string_view type;
+            uint64_t data_size = 0;
+            ProtobufReader header_reader(header);
+            while (header_reader.next()) {
+                switch (header_reader.field()) {
+                    case 1: type = header_reader.bytes(); break;
+                    case 3: data_size = header_reader.varint(); break;
+                    default: header_reader.skip();
+                }
+            }
+            if (data_size > max_blob_size || !read_exactly(in, blob, data_size)) {
+                throw std::runtime_error("Invalid PBF blob");
+            }
+
+            if (type == "OSMHeader") {
+                found_header = true;
+                auto block_data = inflate_blob(blob);
+                ProtobufReader block(block_data);
+                while (block.next()) {
+                    if (block.field() == 1) {
+                        // HeaderBBox, in nanodegrees
+                        std::array<int64_t, 4> bbox{}; // left, right, top, bottom
+                        auto bbox_reader = block.message();
+                        while (bbox_reader.next()) {
+                            if (bbox_reader.field() >= 1 && bbox_reader.field() <= 4) {
+                                bbox[bbox_reader.field() - 1] = bbox_reader.sint64();
+                            } else {
+                                bbox_reader.skip();
+                            }
+                        }
+                        border = Geometry::BoundingBox(
+                            {static_cast<double>(bbox[3]) / 1e9, static_cast<double>(bbox[0]) / 1e9},
+                            {static_cast<double>(bbox[2]) / 1e9, static_cast<double>(bbox[1]) / 1e9});
+                        has_bbox = true;
+                    } else if (block.field() == 4) {
+                        const auto feature = block.bytes();
+                        if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+                            throw std::runtime_error("Unsupported PBF feature " + std::string(feature));
+                        }
+                    } else {
+                        block.skip();
+                    }
+                }
+            } else if (type == "OSMData") {
+                if (!found_header) throw std::runtime_error("PBF data before OSMHeader, check file integrity");
+                if (in_flight.size() >= max_in_flight) {
+                    blocks.push_back(in_flight.front().get());
+                    in_flight.pop_front();
+                }
+                in_flight.push_back(pool.submit([blob = std::move(blob)] {
+                    return decode_primitive_block(inflate_blob(blob));
+                }));
+                blob = std::string();
+            }
+        }
+        for (auto &block: in_flight) blocks.push_back(block.get());
+        timings.lap("decode");
+        link(blocks);
+
+        if (!found_header) throw std::runtime_error("No OSMHeader found, check file integrity");
+        if (!has_bbox && !nodes_by_id.empty()) {
+            // No bounds in the header, use the extent of the data instead
+            Geometry::Position min{std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+            Geometry::Position max{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+            for (const auto &[_, node]: nodes_by_id) {
+                min.latitude = std::min(min.latitude, node->position.latitude);
+                min.longitude = std::min(min.longitude, node->position.longitude);
+                max.latitude = std::max(max.latitude, node->position.latitude);
+                max.longitude = std::max(max.longitude, node->position.longitude);
+            }
+            border = Geometry::BoundingBox(min, max);
+        }
+    }
+
+    void Document::parse() {
+        // Everything is in the tables once load() is done
+        timings.restart();
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef PBF_H
+#define PBF_H
+#include <string>
+#include <utility>
+
+#include "AbstractDocument.h"
+
+namespace Foliage::DataProvider::PBF {
+    /**
+     * Reads OSM .osm.pbf extracts. The file is scanned sequentially for blobs,
+     * and each PrimitiveBlock is inflated and decoded on the thread pool while
+     * reading goes on; the blocks are linked into the tables at the end.
+     */
+    class Document final : public AbstractDocument {
+    private:
+        std::string pbfFile;
+
+    public:
+        explicit Document(std::string pbfFile = ""): pbfFile(std::move(pbfFile)) {}
+
+        void set_document(std::string pbfFile = "") {
+            this->pbfFile = std::move(pbfFile);
+        }
+
+        void load() override;
+        void parse() override;
+    };
+}
+
+#endif //PBF_H
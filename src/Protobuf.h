@@ -0,0 +1,92 @@
+#ifndef PROTOBUF_H
+#define PROTOBUF_H
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace Foliage::DataProvider::PBF {
+    /**
+     * Minimal reader for the protobuf wire format, enough for the OSM PBF messages.
+     * Usage: while (reader.next()) switch (reader.field()) { ... default: reader.skip(); }
+     */
+    class ProtobufReader {
+    public:
+        explicit ProtobufReader(std::string_view data):
+            pos(reinterpret_cast<const uint8_t *>(data.data())),
+            end(pos + data.size()) {}
+
+        bool next() {
+            if (pos == end) return false;
+            const auto key = varint();
+            current_field = static_cast<uint32_t>(key >> 3);
+            current_wire_type = static_cast<uint32_t>(key & 7);
+            return true;
+        }
+
+        [[nodiscard]] uint32_t field() const { return current_field; }
+
+        uint64_t varint() {
+            uint64_t result = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (pos == end) throw std::runtime_error("Truncated protobuf varint");
+                const uint8_t byte = *pos++;
+                result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return result;
+            }
+            throw std::runtime_error("Malformed protobuf varint");
+        }
+
+        int64_t sint64() {
+            const auto value = varint();
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        std::string_view bytes() {
+            const auto size = varint();
+            if (size > static_cast<uint64_t>(end - pos)) throw std::runtime_error("Truncated protobuf message");
+            const std::string_view result(reinterpret_cast<const char *>(pos), size);
+            pos += size;
+            return result;
+        }
+
+        ProtobufReader message() { return ProtobufReader(bytes()); }
+
+        /**
+         * Calls f(value) for each element of a packed repeated varint field.
+         */
+        template<typename F>
+        void packed_varint(F &&f) {
+            ProtobufReader packed(bytes());
+            while (packed.pos != packed.end) f(packed.varint());
+        }
+
+        template<typename F>
+        void packed_sint64(F &&f) {
+            ProtobufReader packed(bytes());
+            while (packed.pos != packed.end) f(packed.sint64());
+        }
+
+        void skip() {
+            switch (current_wire_type) {
+                case 0: varint(); break;
+                case 1: advance(8); break;
+                case 2: bytes(); break;
+                case 5: advance(4); break;
+                default: throw std::runtime_error("Unsupported protobuf wire type");
+            }
+        }
+
+    private:
+        void advance(size_t count) {
+            if (count > static_cast<size_t>(end - pos)) throw std::runtime_error("Truncated protobuf message");
+            pos += count;
+        }
+
+        const uint8_t *pos;
+        const uint8_t *end;
+        uint32_t current_field = 0;
+        uint32_t current_wire_type = 0;
+    };
+}
+
+#endif //PROTOBUF_H
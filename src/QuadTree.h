@@ -4,6 +4,7 @@
 
 #ifndef QUADTREE_H
 #define QUADTREE_H
+#include <functional>
 #include <vector>
 
 #include "Geometry.h"
@@ -0,0 +1,292 @@
+#include "RoutingGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <iterator>
+#include <tuple>
+#include <unordered_map>
+
+#include "ThreadPool.h"
+
+namespace Foliage::Graph {
+    namespace {
+        constexpr size_t ways_per_block = 1024;
+
+        bool is_routable(const ObjectType::Way &way) {
+            return way.tags.contains("highway") && way.nodes.size() >= 2;
+        }
+
+        struct HighwayName {
+            std::string_view name;
+            HighwayClass highway;
+        };
+
+        constexpr HighwayName highway_names[] = {
+            {"motorway", HighwayClass::Motorway}, {"motorway_link", HighwayClass::MotorwayLink},
+            {"trunk", HighwayClass::Trunk}, {"trunk_link", HighwayClass::TrunkLink},
+            {"primary", HighwayClass::Primary}, {"primary_link", HighwayClass::PrimaryLink},
+            {"secondary", HighwayClass::Secondary}, {"secondary_link", HighwayClass::SecondaryLink},
+            {"tertiary", HighwayClass::Tertiary}, {"tertiary_link", HighwayClass::TertiaryLink},
+            {"unclassified", HighwayClass::Unclassified}, {"residential", HighwayClass::Residential},
+            {"living_street", HighwayClass::LivingStreet}, {"service", HighwayClass::Service},
+            {"track", HighwayClass::Track}, {"road", HighwayClass::Road},
+            {"path", HighwayClass::Path}, {"footway", HighwayClass::Footway},
+            {"cycleway", HighwayClass::Cycleway}, {"bridleway", HighwayClass::Bridleway},
+            {"pedestrian", HighwayClass::Pedestrian}, {"steps", HighwayClass::Steps},
+        };
+
+        // Appends the interned tags of one way and decodes the fields the router needs
+        WayAttributes make_attributes(RoutingGraph &graph, const std::vector<std::pair<Util::TagId, Util::TagId>> &tags) {
+            WayAttributes result;
+            result.tags_begin = static_cast<uint32_t>(graph.attribute_tags.size());
+            for (const auto &[key, value]: tags) graph.attribute_tags.push_back({key, value});
+            result.tags_end = static_cast<uint32_t>(graph.attribute_tags.size());
+            for (const auto &[key, value]: tags) {
+                const auto name = graph.tags.at(key);
+                if (name == "highway") result.highway = WayAttributes::parse_highway(graph.tags.at(value));
+                else if (name == "oneway") result.oneway = WayAttributes::parse_oneway(graph.tags.at(value));
+                else if (name == "maxspeed") result.maxspeed = WayAttributes::parse_maxspeed(graph.tags.at(value));
+            }
+            return result;
+        }
+
+        struct RawEdge {
+            NodeIndex target;
+            uint32_t attribute;
+            double length;
+            uint64_t sequence; // Position of the segment in way order, breaks ties deterministically
+            bool is_positive_direction;
+        };
+    }
+
+    RoutingGraph RoutingGraph::build(const DataProvider::AbstractDocument &document, Util::StageTimer *timer) {
+        std::vector<std::shared_ptr<ObjectType::Way>> ways;
+        ways.reserve(document.ways_by_id.size());
+        for (const auto &[_, way]: document.ways_by_id) ways.push_back(way);
+        return build(ways, timer);
+    }
+
+    RoutingGraph RoutingGraph::build(const std::vector<std::shared_ptr<ObjectType::Way>> &ways, Util::StageTimer *timer) {
+        RoutingGraph graph;
+        auto &pool = Util::ThreadPool::shared();
+
+        // Step 1. Routable ways in id order, with one attribute record per distinct tag set
+        std::vector<const ObjectType::Way *> routable;
+        for (const auto &way: ways) {
+            if (is_routable(*way)) routable.push_back(way.get());
+        }
+        std::ranges::sort(routable, {}, &ObjectType::Way::id);
+
+        std::vector<uint32_t> way_attributes(routable.size());
+        std::vector<uint64_t> first_segment(routable.size() + 1, 0);
+        std::unordered_map<std::string, uint32_t> attribute_ids; // Keyed by the raw bytes of the sorted id pairs
+        std::vector<std::pair<Util::TagId, Util::TagId>> way_tags;
+        for (size_t w = 0; w < routable.size(); ++w) {
+            way_tags.clear();
+            for (const auto &[key, value]: routable[w]->tags) {
+                way_tags.emplace_back(graph.tags.intern(key), graph.tags.intern(value));
+            }
+            std::ranges::sort(way_tags);
+            auto [it, inserted] = attribute_ids.try_emplace(
+                std::string(reinterpret_cast<const char *>(way_tags.data()), way_tags.size() * sizeof(way_tags[0])),
+                static_cast<uint32_t>(graph.attributes.size()));
+            if (inserted) graph.attributes.push_back(make_attributes(graph, way_tags));
+            way_attributes[w] = it->second;
+            first_segment[w + 1] = first_segment[w] + routable[w]->nodes.size() - 1;
+        }
+        if (timer) timer->lap("graph attributes");
+        const size_t blocks = (routable.size() + ways_per_block - 1) / ways_per_block;
+        auto for_each_way = [&](auto &&body) {
+            pool.parallel_for(blocks, [&](size_t block) {
+                const size_t end = std::min(routable.size(), (block + 1) * ways_per_block);
+                for (size_t w = block * ways_per_block; w < end; ++w) body(w);
+            });
+        };
+
+        // Step 2. Dense indices for every node on a routable way: sort the nodes of every block by id,
+        // then merge the blocks pairwise, in parallel within each round
+        struct NodeRef {
+            int64_t id;
+            const ObjectType::Node *node;
+        };
+        auto by_id = [](const NodeRef &a, const NodeRef &b) { return a.id < b.id; };
+        auto same_id = [](const NodeRef &a, const NodeRef &b) { return a.id == b.id; };
+        std::vector<std::vector<NodeRef>> runs(blocks);
+        pool.parallel_for(blocks, [&](size_t block) {
+            auto &result = runs[block];
+            const size_t end = std::min(routable.size(), (block + 1) * ways_per_block);
+            for (size_t w = block * ways_per_block; w < end; ++w) {
+                for (const auto &node: routable[w]->nodes) result.push_back({node->id, node.get()});
+            }
+            std::ranges::sort(result, by_id);
+            result.erase(std::unique(result.begin(), result.end(), same_id), result.end());
+        });
+        while (runs.size() > 1) {
+            std::vector<std::vector<NodeRef>> merged((runs.size() + 1) / 2);
+            pool.parallel_for(merged.size(), [&](size_t i) {
+                if (2 * i + 1 == runs.size()) {
+                    merged[i] = std::move(runs[2 * i]);
+                    return;
+                }
+                auto &result = merged[i];
+                result.reserve(runs[2 * i].size() + runs[2 * i + 1].size());
+                std::ranges::merge(runs[2 * i], runs[2 * i + 1], std::back_inserter(result), by_id);
+                result.erase(std::unique(result.begin(), result.end(), same_id), result.end());
+            });
+            runs = std::move(merged);
+        }
+        const auto nodes = runs.empty() ? std::vector<NodeRef>() : std::move(runs.front());
+        runs = {};
+        graph.node_ids.resize(nodes.size());
+        graph.latitudes.resize(nodes.size());
+        graph.longitudes.resize(nodes.size());
+        int32_t min_latitude = 0, max_latitude = 0, min_longitude = 0, max_longitude = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            graph.node_ids[i] = nodes[i].id;
+            const auto latitude = Geometry::to_fixed(nodes[i].node->position.latitude);
+            const auto longitude = Geometry::to_fixed(nodes[i].node->position.longitude);
+            graph.latitudes[i] = latitude;
+            graph.longitudes[i] = longitude;
+            if (i == 0 || latitude < min_latitude) min_latitude = latitude;
+            if (i == 0 || latitude > max_latitude) max_latitude = latitude;
+            if (i == 0 || longitude < min_longitude) min_longitude = longitude;
+            if (i == 0 || longitude > max_longitude) max_longitude = longitude;
+        }
+        graph.projection = Geometry::LocalProjection::around(min_latitude, max_latitude, min_longitude, max_longitude);
+        if (timer) timer->lap("graph nodes");
+
+        // Step 3. Look up the index of every way node once, count the degree of every node,
+        // then place each segment in both directions
+        std::vector<NodeIndex> way_node_indices(first_segment.back() + routable.size());
+        auto way_nodes_begin = [&](size_t w) { return way_node_indices.begin() + first_segment[w] + w; };
+        std::vector<std::atomic<EdgeIndex>> cursor(nodes.size() + 1);
+        for_each_way([&](size_t w) {
+            const auto &way_nodes = routable[w]->nodes;
+            const auto indices = way_nodes_begin(w);
+            for (size_t i = 0; i < way_nodes.size(); ++i) indices[i] = graph.index_of(way_nodes[i]->id);
+            for (size_t i = 0; i + 1 < way_nodes.size(); ++i) {
+                if (way_nodes[i] == way_nodes[i + 1]) continue;
+                cursor[indices[i]].fetch_add(1, std::memory_order_relaxed);
+                cursor[indices[i + 1]].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        graph.edge_offsets.resize(nodes.size() + 1);
+        EdgeIndex total = 0;
+        for (size_t u = 0; u <= nodes.size(); ++u) {
+            graph.edge_offsets[u] = total;
+            total += cursor[u].exchange(total, std::memory_order_relaxed);
+        }
+
+        std::vector<RawEdge> edges(total);
+        for_each_way([&](size_t w) {
+            const auto &way_nodes = routable[w]->nodes;
+            for (size_t i = 0; i + 1 < way_nodes.size(); ++i) {
+                if (way_nodes[i] == way_nodes[i + 1]) continue;
+                const auto from = way_nodes_begin(w)[i];
+                const auto to = way_nodes_begin(w)[i + 1];
+                const double length = graph.distance(from, to);
+                const uint64_t sequence = first_segment[w] + i;
+                edges[cursor[from].fetch_add(1, std::memory_order_relaxed)] = {
+                    to, way_attributes[w], length, sequence, true
+                };
+                edges[cursor[to].fetch_add(1, std::memory_order_relaxed)] = {
+                    from, way_attributes[w], length, sequence, false
+                };
+            }
+        });
+
+        if (timer) timer->lap("graph edges");
+
+        // Step 4. Slots were claimed in arbitrary order, sort every node's edges to make the layout deterministic
+        graph.edge_targets.resize(total);
+        graph.edge_lengths.resize(total);
+        graph.edge_attributes.resize(total);
+        graph.edge_is_positive_direction.resize(total);
+        graph.edge_twins.resize(total);
+        auto edge_order = [](const RawEdge &a, const RawEdge &b) {
+            return std::tie(a.target, a.sequence, a.is_positive_direction) <
+                   std::tie(b.target, b.sequence, b.is_positive_direction);
+        };
+        const size_t node_blocks = (nodes.size() + ways_per_block - 1) / ways_per_block;
+        pool.parallel_for(node_blocks, [&](size_t block) {
+            const size_t end = std::min(nodes.size(), (block + 1) * ways_per_block);
+            for (size_t u = block * ways_per_block; u < end; ++u) {
+                const auto first = edges.begin() + graph.edge_offsets[u];
+                const auto last = edges.begin() + graph.edge_offsets[u + 1];
+                std::sort(first, last, edge_order);
+                for (auto e = graph.edge_offsets[u]; e < graph.edge_offsets[u + 1]; ++e) {
+                    graph.edge_targets[e] = edges[e].target;
+                    graph.edge_lengths[e] = edges[e].length;
+                    graph.edge_attributes[e] = edges[e].attribute;
+                    graph.edge_is_positive_direction[e] = edges[e].is_positive_direction;
+                }
+            }
+        });
+        // The twin of u -> v is the edge of the same segment among those of v, which are sorted now
+        pool.parallel_for(node_blocks, [&](size_t block) {
+            const size_t end = std::min(nodes.size(), (block + 1) * ways_per_block);
+            for (size_t u = block * ways_per_block; u < end; ++u) {
+                for (auto e = graph.edge_offsets[u]; e < graph.edge_offsets[u + 1]; ++e) {
+                    const auto v = edges[e].target;
+                    const RawEdge twin{
+                        static_cast<NodeIndex>(u), 0, 0, edges[e].sequence, !edges[e].is_positive_direction
+                    };
+                    const auto it = std::lower_bound(edges.begin() + graph.edge_offsets[v],
+                                                     edges.begin() + graph.edge_offsets[v + 1], twin, edge_order);
+                    graph.edge_twins[e] = static_cast<EdgeIndex>(it - edges.begin());
+                }
+            }
+        });
+        if (timer) timer->lap("graph layout");
+        return graph;
+    }
+
+    NodeIndex RoutingGraph::index_of(int64_t id) const {
+        auto it = std::ranges::lower_bound(node_ids, id);
+        if (it == node_ids.end() || *it != id) return invalid_node;
+        return static_cast<NodeIndex>(it - node_ids.begin());
+    }
+
+    std::string_view RoutingGraph::tag(uint32_t attribute, std::string_view key) const {
+        const auto key_id = tags.find(key);
+        if (key_id == Util::invalid_tag) return {};
+        const auto first = attribute_tags.begin() + attributes[attribute].tags_begin;
+        const auto last = attribute_tags.begin() + attributes[attribute].tags_end;
+        const auto it = std::lower_bound(first, last, key_id, [](const AttributeTag &tag, Util::TagId id) {
+            return tag.key < id;
+        });
+        if (it == last || it->key != key_id) return {};
+        return tags.at(it->value);
+    }
+
+    HighwayClass WayAttributes::parse_highway(std::string_view value) {
+        for (const auto &[name, highway]: highway_names) {
+            if (name == value) return highway;
+        }
+        return HighwayClass::Other;
+    }
+
+    Oneway WayAttributes::parse_oneway(std::string_view value) {
+        if (value == "yes" || value == "true" || value == "1") return Oneway::Forward;
+        if (value == "-1" || value == "reverse") return Oneway::Backward;
+        return Oneway::No;
+    }
+
+    float WayAttributes::parse_maxspeed(std::string_view value) {
+        float speed = 0;
+        const auto [rest, error] = std::from_chars(value.data(), value.data() + value.size(), speed);
+        if (error != std::errc() || speed <= 0) return 0;
+        auto unit = value.substr(rest - value.data());
+        while (!unit.empty() && unit.front() == ' ') unit.remove_prefix(1);
+        if (unit.empty() || unit == "km/h" || unit == "kmh" || unit == "kph") return speed;
+        if (unit == "mph") return speed * 1.609344f;
+        return 0;
+    }
+
+    std::shared_ptr<const ObjectType::Node> RoutingGraph::make_node(NodeIndex node) const {
+        auto result = std::make_shared<ObjectType::Node>(node_ids[node]);
+        result->position = position(node);
+        return result;
+    }
+}
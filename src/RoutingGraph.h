@@ -0,0 +1,150 @@
+#ifndef ROUTINGGRAPH_H
+#define ROUTINGGRAPH_H
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "AbstractDocument.h"
+#include "Buffer.h"
+#include "Geometry.h"
+#include "StageTimer.h"
+#include "TagDictionary.h"
+#include "object.h"
+
+namespace Foliage::Graph {
+    using NodeIndex = uint32_t;
+    using EdgeIndex = uint32_t;
+    constexpr NodeIndex invalid_node = std::numeric_limits<NodeIndex>::max();
+    constexpr EdgeIndex invalid_edge = std::numeric_limits<EdgeIndex>::max();
+
+    // Where a search starts or ends: a node, and the cost between it and a point along one of its edges
+    struct Endpoint {
+        NodeIndex node;
+        float cost = 0;
+    };
+
+    enum class HighwayClass : uint8_t {
+        Motorway, MotorwayLink, Trunk, TrunkLink, Primary, PrimaryLink, Secondary, SecondaryLink,
+        Tertiary, TertiaryLink, Unclassified, Residential, LivingStreet, Service, Track, Road,
+        Path, Footway, Cycleway, Bridleway, Pedestrian, Steps, Other
+    };
+
+    constexpr size_t highway_class_count = static_cast<size_t>(HighwayClass::Other) + 1;
+
+    enum class Oneway : uint8_t {
+        No,
+        Forward, // "yes", only along the way's node order
+        Backward // "-1", only against it
+    };
+
+    /**
+     * Routing-relevant part of a way's tags, decoded once when the graph is built.
+     * The complete tag set stays available as interned (key, value) pairs.
+     */
+    struct WayAttributes {
+        HighwayClass highway = HighwayClass::Other;
+        Oneway oneway = Oneway::No;
+        float maxspeed = 0; // km/h, 0 when missing or not numeric
+        uint32_t tags_begin = 0, tags_end = 0; // Range in RoutingGraph::attribute_tags, sorted by key id
+
+        static HighwayClass parse_highway(std::string_view value);
+
+        static Oneway parse_oneway(std::string_view value);
+
+        /**
+         * Understands plain km/h values and the "mph" suffix; anything else gives 0.
+         */
+        static float parse_maxspeed(std::string_view value);
+    };
+
+    struct AttributeTag {
+        Util::TagId key;
+        Util::TagId value;
+    };
+
+    /**
+     * Frozen compressed-sparse-row view of the routable part of a document.
+     * Nodes get dense indices in ascending OSM id order, and the edges leaving
+     * node u are [edge_offsets[u], edge_offsets[u + 1]), ordered by target.
+     * Every consecutive pair of nodes on a way tagged "highway" gives one edge in
+     * each direction, and each of the two is the other's twin, so a search can follow
+     * an edge backwards; ways with identical tags share one attribute record.
+     * Tag strings are interned into a dictionary owned by the graph.
+     * All arrays are flat buffers of plain values, so a graph can be mapped from a snapshot.
+     * Coordinates are kept as fixed-point latitudes and longitudes; edge lengths are in metres on a
+     * local projection around the centre of the nodes.
+     */
+    class RoutingGraph {
+    public:
+        // Per node
+        Util::Buffer<int64_t> node_ids;
+        Util::Buffer<int32_t> latitudes, longitudes; // In 1e-7 degree units
+        Util::Buffer<EdgeIndex> edge_offsets; // node_count() + 1 entries
+
+        // Per edge
+        Util::Buffer<NodeIndex> edge_targets;
+        Util::Buffer<double> edge_lengths;
+        Util::Buffer<uint32_t> edge_attributes;
+        Util::Buffer<uint8_t> edge_is_positive_direction; // Whether the edge follows the way's node order
+        Util::Buffer<EdgeIndex> edge_twins; // The edge over the same segment the other way
+
+        // Shared attribute records, indexed by edge_attributes
+        Util::Buffer<WayAttributes> attributes;
+        Util::Buffer<AttributeTag> attribute_tags;
+        Util::TagDictionary tags;
+
+        Geometry::LocalProjection projection;
+
+        /**
+         * Builds the graph in one pass over the ways of a parsed document.
+         * Ways are processed in parallel; the result does not depend on the thread count.
+         */
+        static RoutingGraph build(const DataProvider::AbstractDocument &document, Util::StageTimer *timer = nullptr);
+
+        static RoutingGraph build(const std::vector<std::shared_ptr<ObjectType::Way>> &ways,
+                                  Util::StageTimer *timer = nullptr);
+
+        [[nodiscard]] size_t node_count() const { return node_ids.size(); }
+        [[nodiscard]] size_t edge_count() const { return edge_targets.size(); }
+
+        [[nodiscard]] EdgeIndex edges_begin(NodeIndex node) const { return edge_offsets[node]; }
+        [[nodiscard]] EdgeIndex edges_end(NodeIndex node) const { return edge_offsets[node + 1]; }
+
+        // The node an edge leaves from
+        [[nodiscard]] NodeIndex edge_source(EdgeIndex edge) const { return edge_targets[edge_twins[edge]]; }
+
+        [[nodiscard]] Geometry::Position position(NodeIndex node) const {
+            return {Geometry::from_fixed(latitudes[node]), Geometry::from_fixed(longitudes[node])};
+        }
+
+        // On `projection`, in metres
+        [[nodiscard]] Geometry::Point point(NodeIndex node) const {
+            return projection.project(latitudes[node], longitudes[node]);
+        }
+
+        // Straight-line distance in metres
+        [[nodiscard]] double distance(NodeIndex from, NodeIndex to) const {
+            return Geometry::distance(point(from), point(to));
+        }
+
+        /**
+         * @return The dense index of an OSM node id, or invalid_node if it is not routable
+         */
+        [[nodiscard]] NodeIndex index_of(int64_t id) const;
+
+        /**
+         * @return The value of `key` in an attribute record, or an empty view if it is absent
+         */
+        [[nodiscard]] std::string_view tag(uint32_t attribute, std::string_view key) const;
+
+        /**
+         * Creates a standalone Node object for a dense index, for returning paths.
+         */
+        [[nodiscard]] std::shared_ptr<const ObjectType::Node> make_node(NodeIndex node) const;
+    };
+}
+
+#endif //ROUTINGGRAPH_H
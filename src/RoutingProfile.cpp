@@ -0,0 +1,247 @@
+#include "RoutingProfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "Checksum.h"
+#include "ThreadPool.h"
+
+namespace Foliage::Graph {
+    namespace {
+        constexpr size_t edges_per_block = 1 << 16;
+        constexpr float closed = std::numeric_limits<float>::infinity();
+
+        size_t class_index(std::string_view name) {
+            const auto highway = WayAttributes::parse_highway(name);
+            if (highway == HighwayClass::Other) {
+                throw std::invalid_argument("Unknown highway class " + std::string(name));
+            }
+            return static_cast<size_t>(highway);
+        }
+
+        float parse_number(const std::string &key, const std::string &value) {
+            size_t used = 0;
+            float result;
+            try {
+                result = std::stof(value, &used);
+            } catch (const std::exception &) {
+                used = 0;
+            }
+            if (used == 0 || used != value.size() || result < 0) {
+                throw std::invalid_argument("Invalid value for " + key + ": " + value);
+            }
+            return result;
+        }
+
+        // Fills speed and factor from {speed, factor} pairs in HighwayClass order
+        RoutingProfile make_profile(std::string name, const std::array<std::pair<float, float>, highway_class_count> &table) {
+            RoutingProfile profile;
+            profile.name = std::move(name);
+            for (size_t i = 0; i < highway_class_count; ++i) {
+                profile.speed[i] = table[i].first;
+                profile.factor[i] = table[i].second;
+            }
+            return profile;
+        }
+
+        /**
+         * @return The largest s with weights[e] >= s * base[e] for every usable edge, so that s times a
+         * lower bound under the base weights is still a lower bound under these
+         */
+        float bound_scale(const std::vector<float> &weights, const std::vector<float> &base) {
+            const size_t blocks = (weights.size() + edges_per_block - 1) / edges_per_block;
+            std::vector<float> block_scale(blocks, closed);
+            Util::ThreadPool::shared().parallel_for(blocks, [&](size_t block) {
+                const size_t end = std::min(weights.size(), (block + 1) * edges_per_block);
+                float scale = closed;
+                for (size_t edge = block * edges_per_block; edge < end; ++edge) {
+                    if (weights[edge] == closed || base[edge] == 0) continue;
+                    // An edge the base profile cannot use makes its bounds meaningless here
+                    scale = std::min(scale, base[edge] == closed ? 0.0f : weights[edge] / base[edge]);
+                }
+                block_scale[block] = scale;
+            });
+            const float scale = blocks == 0 ? 1.0f : *std::ranges::min_element(block_scale);
+            return scale == closed ? 1.0f : scale;
+        }
+    }
+
+    RoutingProfile RoutingProfile::car() {
+        auto profile = make_profile("car", {{
+            {120, 0.5}, {30, 0.5}, // motorway
+            {100, 0.8}, {30, 0.8}, // trunk
+            {80, 1.0}, {30, 1.0}, // primary
+            {60, 3.0}, {30, 3.0}, // secondary
+            {50, 10.0}, {30, 10.0}, // tertiary
+            {30, 1000.0}, {30, 10000.0}, // unclassified, residential
+            {30, 1}, {30, 1}, {30, 1}, {30, 1}, // living_street, service, track, road
+            {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}, // path, footway, cycleway, bridleway, pedestrian, steps
+            {0, 1} // other
+        }});
+        profile.use_maxspeed = true;
+        return profile;
+    }
+
+    RoutingProfile RoutingProfile::bike() {
+        return make_profile("bike", {{
+            {0, 1}, {0, 1}, // motorway
+            {0, 1}, {0, 1}, // trunk
+            {18, 2.0}, {18, 2.0}, // primary
+            {18, 1.5}, {18, 1.5}, // secondary
+            {18, 1.2}, {18, 1.2}, // tertiary
+            {16, 1.0}, {16, 1.0}, // unclassified, residential
+            {12, 1.0}, {14, 1.2}, {12, 1.2}, {16, 1.0}, // living_street, service, track, road
+            {12, 1.0}, {6, 1.5}, {20, 0.8}, {8, 1.5}, {6, 1.5}, {2, 3.0}, // path, footway, cycleway, bridleway, pedestrian, steps
+            {0, 1} // other
+        }});
+    }
+
+    RoutingProfile RoutingProfile::foot() {
+        auto profile = make_profile("foot", {{
+            {0, 1}, {0, 1}, // motorway
+            {0, 1}, {0, 1}, // trunk
+            {5, 1.3}, {5, 1.3}, // primary
+            {5, 1.2}, {5, 1.2}, // secondary
+            {5, 1.1}, {5, 1.1}, // tertiary
+            {5, 1.0}, {5, 1.0}, // unclassified, residential
+            {5, 0.9}, {5, 1.0}, {4.5, 1.0}, {5, 1.0}, // living_street, service, track, road
+            {5, 0.9}, {5, 0.9}, {5, 1.0}, {4.5, 1.0}, {5, 0.9}, {3, 1.0}, // path, footway, cycleway, bridleway, pedestrian, steps
+            {0, 1} // other
+        }});
+        profile.respect_oneway = false;
+        return profile;
+    }
+
+    RoutingProfile RoutingProfile::from_preferences(const std::map<std::string, std::string> &preferences) {
+        RoutingProfile profile;
+        const auto base = preferences.contains("profile") ? preferences.at("profile") : "car";
+        if (base == "car") profile = car();
+        else if (base == "bike") profile = bike();
+        else if (base == "foot") profile = foot();
+        else throw std::invalid_argument("Unknown profile " + base);
+
+        for (const auto &[key, value]: preferences) {
+            if (key == "avoid") {
+                for (size_t begin = 0; begin <= value.size();) {
+                    const auto end = std::min(value.find(',', begin), value.size());
+                    if (end > begin) profile.speed[class_index(std::string_view(value).substr(begin, end - begin))] = 0;
+                    begin = end + 1;
+                }
+            } else if (key.starts_with("speed.")) {
+                profile.speed[class_index(std::string_view(key).substr(6))] = parse_number(key, value);
+            } else if (key.starts_with("factor.")) {
+                const float factor = parse_number(key, value);
+                if (factor == 0) throw std::invalid_argument("Factor must be positive: " + key);
+                profile.factor[class_index(std::string_view(key).substr(7))] = factor;
+            } else if (key == "oneway") {
+                if (value != "respect" && value != "ignore") {
+                    throw std::invalid_argument("Invalid value for oneway: " + value);
+                }
+                profile.respect_oneway = value == "respect";
+            } else {
+                continue;
+            }
+            profile.name += ";" + key + "=" + value;
+        }
+        return profile;
+    }
+
+    float RoutingProfile::weight(const WayAttributes &attributes, double length, bool is_positive_direction) const {
+        if (respect_oneway && ((attributes.oneway == Oneway::Forward && !is_positive_direction) ||
+                               (attributes.oneway == Oneway::Backward && is_positive_direction))) {
+            return closed;
+        }
+        const auto highway = static_cast<size_t>(attributes.highway);
+        if (speed[highway] <= 0) return closed;
+        const double travel_speed = use_maxspeed && attributes.maxspeed > 0 ? 0.9 * attributes.maxspeed : speed[highway];
+        return static_cast<float>(length / travel_speed * factor[highway]);
+    }
+
+    ProfileWeights::ProfileWeights(RoutingProfile profile, const RoutingGraph &graph):
+        profile(std::move(profile)),
+        weights(graph.edge_count()) {
+        const size_t blocks = (graph.edge_count() + edges_per_block - 1) / edges_per_block;
+        Util::ThreadPool::shared().parallel_for(blocks, [&](size_t block) {
+            const size_t end = std::min(graph.edge_count(), (block + 1) * edges_per_block);
+            for (size_t edge = block * edges_per_block; edge < end; ++edge) {
+                weights[edge] = this->profile.weight(graph.attributes[graph.edge_attributes[edge]],
+                                                     graph.edge_lengths[edge],
+                                                     graph.edge_is_positive_direction[edge]);
+            }
+        });
+        checksum = Util::checksum(weights.data(), weights.size() * sizeof(float));
+
+        // Edge lengths are straight lines on the graph projection, so no path is shorter than the line between its ends.
+        // The slack covers the rounding of the float weights
+        double cheapest = std::numeric_limits<double>::infinity();
+        for (EdgeIndex edge = 0; edge < graph.edge_count(); ++edge) {
+            if (std::isfinite(weights[edge]) && graph.edge_lengths[edge] > 0) {
+                cheapest = std::min(cheapest, weights[edge] / graph.edge_lengths[edge]);
+            }
+        }
+        if (std::isfinite(cheapest)) cost_per_metre = static_cast<float>(cheapest * (1 - 1e-5));
+
+        // A node reached only by a oneway has no usable edge of its own, but it is still a valid endpoint
+        routable.assign(graph.node_count(), false);
+        for (NodeIndex node = 0; node < graph.node_count(); ++node) {
+            for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                if (std::isinf(weights[edge])) continue;
+                routable[node] = true;
+                routable[graph.edge_targets[edge]] = true;
+            }
+        }
+        components = ConnectedComponents::build(graph, weights);
+    }
+
+    ProfileSet::ProfileSet(std::shared_ptr<const RoutingGraph> graph, size_t max_custom_profiles,
+                           size_t landmark_count,
+                           const std::map<std::string, std::shared_ptr<const LandmarkTable>, std::less<>> &
+                           prebuilt_landmarks):
+        routing_graph(std::move(graph)),
+        max_custom_profiles(max_custom_profiles) {
+        for (auto profile: {RoutingProfile::car(), RoutingProfile::bike(), RoutingProfile::foot()}) {
+            auto name = profile.name;
+            auto compiled = std::make_shared<ProfileWeights>(std::move(profile), *routing_graph);
+            if (const auto it = prebuilt_landmarks.find(name);
+                it != prebuilt_landmarks.end() && it->second->weights_checksum == compiled->checksum) {
+                compiled->landmarks = it->second;
+            } else if (landmark_count > 0) {
+                compiled->landmarks = std::make_shared<const LandmarkTable>(
+                    LandmarkTable::build(*routing_graph, compiled->weights, landmark_count));
+            }
+            builtin.emplace(std::move(name), std::move(compiled));
+        }
+    }
+
+    std::shared_ptr<const ProfileWeights> ProfileSet::get(const std::map<std::string, std::string> &preferences) {
+        return compile(RoutingProfile::from_preferences(preferences));
+    }
+
+    std::shared_ptr<const ProfileWeights> ProfileSet::compile(const RoutingProfile &profile) {
+        if (const auto it = builtin.find(profile.name); it != builtin.end()) return it->second;
+        {
+            std::lock_guard lock(mutex);
+            if (const auto it = custom.find(profile.name); it != custom.end()) return it->second;
+        }
+        // Compile outside the lock; if two queries race, both results are equal and the first one is kept
+        auto compiled = std::make_shared<ProfileWeights>(profile, *routing_graph);
+        const auto &base = builtin.at(profile.name.substr(0, profile.name.find(';')));
+        if (base->landmarks) {
+            compiled->landmarks = base->landmarks;
+            compiled->landmark_scale = bound_scale(compiled->weights, base->weights);
+        }
+        std::lock_guard lock(mutex);
+        auto [it, inserted] = custom.try_emplace(profile.name, std::move(compiled));
+        auto result = it->second;
+        if (inserted) {
+            custom_order.push_back(profile.name);
+            if (custom_order.size() > max_custom_profiles) {
+                custom.erase(custom_order.front());
+                custom_order.pop_front();
+            }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef ROUTINGPROFILE_H
+#define ROUTINGPROFILE_H
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ConnectedComponents.h"
+#include "Landmarks.h"
+#include "RoutingGraph.h"
+
+namespace Foliage::Graph {
+    /**
+     * How a mode of transport values each highway class. The cost of an edge is
+     * its length divided by the speed, times the class factor.
+     */
+    struct RoutingProfile {
+        std::string name;
+        std::array<float, highway_class_count> speed{}; // km/h, 0 closes the class
+        std::array<float, highway_class_count> factor{}; // Preference multiplier, lower is preferred
+        bool use_maxspeed = false; // Drive at 90% of a tagged maxspeed instead of the class speed
+        bool respect_oneway = true;
+
+        static RoutingProfile car();
+
+        static RoutingProfile bike();
+
+        static RoutingProfile foot();
+
+        /**
+         * Builds a profile from the `preference` object of a query:
+         * - "profile": "car" (default), "bike" or "foot" picks the base profile
+         * - "avoid": comma-separated highway values to close
+         * - "speed.<highway>", "factor.<highway>": numeric overrides for one class
+         * - "oneway": "respect" or "ignore"
+         * Other keys are ignored. The name is a canonical form of the recognized keys,
+         * so equal preferences give equal names.
+         */
+        static RoutingProfile from_preferences(const std::map<std::string, std::string> &preferences);
+
+        /**
+         * @return The cost of traversing `length` along a way, or infinity if the profile may not use it
+         */
+        [[nodiscard]] float weight(const WayAttributes &attributes, double length, bool is_positive_direction) const;
+    };
+
+    /**
+     * A profile compiled against one graph: the cost of every edge, indexed by EdgeIndex.
+     */
+    struct ProfileWeights {
+        RoutingProfile profile;
+        std::vector<float> weights;
+        std::vector<bool> routable; // By node: whether an edge this profile may use starts or ends there
+        uint64_t checksum = 0; // Of `weights`, to tell whether precomputed data still matches them
+        // At most the cost per metre of any usable edge, so it turns a straight-line distance into a lower bound
+        float cost_per_metre = 0;
+        // Landmark distances under these weights or, for a custom profile, under those of its base profile
+        std::shared_ptr<const LandmarkTable> landmarks;
+        float landmark_scale = 1; // Multiplier that keeps the landmark bound admissible for these weights
+        // Under these weights, so queries between parts of the network no route joins fail without a search
+        ConnectedComponents components;
+
+        ProfileWeights(RoutingProfile profile, const RoutingGraph &graph);
+
+        [[nodiscard]] float operator[](EdgeIndex edge) const { return weights[edge]; }
+
+        /**
+         * @return A lower bound on the cost from one node to another, 0 without landmarks
+         */
+        [[nodiscard]] float lower_bound(NodeIndex from, NodeIndex to) const {
+            return landmarks && landmark_scale > 0 ? landmark_scale * landmarks->lower_bound(from, to) : 0;
+        }
+    };
+
+    /**
+     * Compiled weights of the built-in profiles, plus a bounded cache of custom ones.
+     * Profiles are identified by name. Safe to use from several query threads.
+     * Each built-in profile gets a landmark table, which custom profiles share with their base profile.
+     */
+    class ProfileSet {
+    public:
+        /**
+         * @param prebuilt_landmarks Landmark tables by profile name, e.g. from a snapshot. A table is only
+         * used if it was computed with the same weights, otherwise it is rebuilt
+         */
+        explicit ProfileSet(std::shared_ptr<const RoutingGraph> graph, size_t max_custom_profiles = 8,
+                            size_t landmark_count = 8,
+                            const std::map<std::string, std::shared_ptr<const LandmarkTable>, std::less<>> &
+                            prebuilt_landmarks = {});
+
+        /**
+         * @return The compiled weights for a query's preferences, compiling them on first use
+         */
+        std::shared_ptr<const ProfileWeights> get(const std::map<std::string, std::string> &preferences);
+
+        /**
+         * @return The compiled weights of a profile, reusing them if a profile of that name was compiled before
+         */
+        std::shared_ptr<const ProfileWeights> compile(const RoutingProfile &profile);
+
+        [[nodiscard]] const std::shared_ptr<const RoutingGraph> &graph() const { return routing_graph; }
+
+        /**
+         * @return The compiled car, bike and foot profiles, by name
+         */
+        [[nodiscard]] const std::map<std::string, std::shared_ptr<const ProfileWeights>, std::less<>> &
+        builtin_profiles() const { return builtin; }
+
+    private:
+        std::shared_ptr<const RoutingGraph> routing_graph;
+        std::map<std::string, std::shared_ptr<const ProfileWeights>, std::less<>> builtin;
+
+        std::mutex mutex;
+        size_t max_custom_profiles;
+        std::map<std::string, std::shared_ptr<const ProfileWeights>, std::less<>> custom;
+        std::deque<std::string> custom_order; // Oldest first, for eviction
+    };
+}
+
+#endif //ROUTINGPROFILE_H
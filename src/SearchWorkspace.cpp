@@ -0,0 +1,35 @@
+#include "SearchWorkspace.h"
+
+#include <algorithm>
+
+namespace Foliage::Pathfinder {
+    SearchWorkspace &SearchWorkspace::local() {
+        thread_local SearchWorkspace workspace;
+        return workspace;
+    }
+
+    void SearchWorkspace::reset(size_t nodes) {
+        settled = relaxed = 0;
+        for (int side = 0; side < 2; ++side) {
+            heaps[side].clear();
+            heaps_at_reset[side] = heaps[side].counters();
+            labels[side].clear();
+            if (heads[side].size() < nodes) heads[side].resize(nodes);
+        }
+        // Stamps are only compared for equality, so they start over once the counter wraps
+        if (++generation == 0) {
+            for (auto &side: heads) std::ranges::fill(side, Head{});
+            generation = 1;
+        }
+    }
+
+    SearchWorkspace::Stats SearchWorkspace::stats() const {
+        Stats stats{settled, relaxed};
+        for (int side = 0; side < 2; ++side) {
+            stats.pushes += heaps[side].counters().pushes - heaps_at_reset[side].pushes;
+            stats.decreases += heaps[side].counters().decreases - heaps_at_reset[side].decreases;
+            stats.pops += heaps[side].counters().pops - heaps_at_reset[side].pops;
+        }
+        return stats;
+    }
+}
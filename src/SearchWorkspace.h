@@ -0,0 +1,147 @@
+#ifndef SEARCHWORKSPACE_H
+#define SEARCHWORKSPACE_H
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "IndexedHeap.h"
+
+namespace Foliage::Pathfinder {
+    /**
+     * State of a bidirectional search. LayeredAStarPathfinder searches arrivals rather than nodes, a state being
+     * the arrival at a node by one edge standing for every road of its priority into that node, so that the
+     * class of road it came by is part of it. A node has a state per priority of road into it, and most have
+     * one or two, so the labels of the states a search reaches go into a pool in the order they are reached,
+     * and each node only keeps the first of its own, chained to the rest. Starting a search bumps a generation
+     * counter instead of clearing the node table: a node stamped by an older generation has no states yet.
+     * Each thread keeps one, sized to the largest graph and the largest search it has seen, so once it has
+     * served a few queries on a graph, searches allocate nothing.
+     * Side 0 searches from the start, side 1 from the goal. The open set of each side is an indexed 4-ary
+     * heap on f-scores, which lowers the key of a state already in it instead of adding it again.
+     */
+    class SearchWorkspace {
+    public:
+        static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+        struct Label {
+            uint32_t edge = none; // The arrival the state stands for
+            uint32_t next = none; // The next state at the same node
+            uint32_t parent = none; // State it was reached from, none for a seed
+            uint32_t heap_index = none; // Where the state is in its side's heap
+            double g_score = std::numeric_limits<double>::infinity();
+            bool closed = false;
+        };
+
+    private:
+        struct HeapSlot {
+            std::vector<Label> *labels;
+
+            uint32_t &operator()(uint32_t state) const { return (*labels)[state].heap_index; }
+        };
+
+        // The first state of a node, if `stamp` is the current generation
+        struct Head {
+            uint32_t stamp = 0;
+            uint32_t first = none;
+        };
+
+    public:
+        using Heap = Util::IndexedHeap<4, double, HeapSlot>;
+
+        // Work done by one search
+        struct Stats {
+            uint64_t settled = 0; // States closed, both sides together
+            uint64_t relaxed = 0; // Steps from one state to the next whose cost was tried
+            uint64_t pushes = 0, decreases = 0, pops = 0; // Heap operations
+        };
+
+        // Counted by the search itself; reset with the rest
+        uint64_t settled = 0, relaxed = 0;
+
+        SearchWorkspace() = default;
+
+        // The heaps point into the labels
+        SearchWorkspace(const SearchWorkspace &) = delete;
+        SearchWorkspace &operator=(const SearchWorkspace &) = delete;
+
+        /**
+         * @return The workspace of the calling thread
+         */
+        static SearchWorkspace &local();
+
+        /**
+         * Starts a search on a graph of `nodes` nodes, forgetting the previous one. The node table only grows,
+         * so threads that switch between graphs do not rebuild it.
+         */
+        void reset(size_t nodes);
+
+        /**
+         * @return The state `edge` stands for at `node`, which it arrives at, or none if the side has not reached it
+         */
+        [[nodiscard]] uint32_t find(int side, uint32_t node, uint32_t edge) const {
+            const auto &head = heads[side][node];
+            if (head.stamp != generation) return none;
+            auto state = head.first;
+            while (state != none && labels[side][state].edge != edge) state = labels[side][state].next;
+            return state;
+        }
+
+        [[nodiscard]] bool reached(int side, uint32_t node, uint32_t edge) const {
+            return find(side, node, edge) != none;
+        }
+
+        /**
+         * @return The state `edge` stands for at `node`, added as unvisited if the side had not reached it yet
+         */
+        uint32_t reach(int side, uint32_t node, uint32_t edge) {
+            auto &head = heads[side][node];
+            if (head.stamp != generation) head = {generation, none};
+            for (auto state = head.first; state != none; state = labels[side][state].next) {
+                if (labels[side][state].edge == edge) return state;
+            }
+            labels[side].push_back({edge, head.first});
+            head.first = static_cast<uint32_t>(labels[side].size() - 1);
+            return head.first;
+        }
+
+        /**
+         * @return The label of a reached state. Reaching another state may move it
+         */
+        [[nodiscard]] Label &operator()(int side, uint32_t state) { return labels[side][state]; }
+
+        /**
+         * @return How many states the side has reached, numbered from 0 in the order it reached them
+         */
+        [[nodiscard]] size_t size(int side) const { return labels[side].size(); }
+
+        /**
+         * Opens a reached state with `f_score`, or lowers the f-score it is open with.
+         */
+        void push(int side, double f_score, uint32_t state) { heaps[side].push_or_decrease(state, f_score); }
+
+        [[nodiscard]] bool empty(int side) const { return heaps[side].empty(); }
+
+        [[nodiscard]] const Heap::Entry &top(int side) const { return heaps[side].top(); }
+
+        Heap::Entry pop(int side) { return heaps[side].pop(); }
+
+        /**
+         * @return What the current search, or the last one once it is over, has done so far
+         */
+        [[nodiscard]] Stats stats() const;
+
+        /**
+         * @return The heap operations of one side over every search of this workspace
+         */
+        [[nodiscard]] const Heap::Counters &heap_counters(int side) const { return heaps[side].counters(); }
+
+    private:
+        std::vector<Head> heads[2];
+        std::vector<Label> labels[2];
+        Heap heaps[2]{Heap({&labels[0]}), Heap({&labels[1]})};
+        uint32_t generation = 0;
+        Heap::Counters heaps_at_reset[2]; // To tell the operations of the current search apart
+    };
+}
+
+#endif //SEARCHWORKSPACE_H
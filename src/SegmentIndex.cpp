@@ -0,0 +1,130 @@
+#include "SegmentIndex.h"
+
+#include <cmath>
+
+namespace Foliage::Graph {
+    namespace {
+        SegmentIndex::Box bounds_of(const SegmentIndex::Segment &segment) {
+            return {std::min(segment.from_latitude, segment.to_latitude),
+                    std::min(segment.from_longitude, segment.to_longitude),
+                    std::max(segment.from_latitude, segment.to_latitude),
+                    std::max(segment.from_longitude, segment.to_longitude)};
+        }
+
+        SegmentIndex::Box merge(const SegmentIndex::Box &a, const SegmentIndex::Box &b) {
+            return {std::min(a.min_latitude, b.min_latitude), std::min(a.min_longitude, b.min_longitude),
+                    std::max(a.max_latitude, b.max_latitude), std::max(a.max_longitude, b.max_longitude)};
+        }
+    }
+
+    std::vector<Endpoint> EdgePoint::departures(const ProfileWeights &weights) const {
+        std::vector<Endpoint> result;
+        if (std::isfinite(weights[backward])) result.push_back({from, static_cast<float>(fraction * weights[backward])});
+        if (std::isfinite(weights[forward])) result.push_back({to, static_cast<float>((1 - fraction) * weights[forward])});
+        return result;
+    }
+
+    std::vector<Endpoint> EdgePoint::arrivals(const ProfileWeights &weights) const {
+        std::vector<Endpoint> result;
+        if (std::isfinite(weights[forward])) result.push_back({from, static_cast<float>(fraction * weights[forward])});
+        if (std::isfinite(weights[backward])) result.push_back({to, static_cast<float>((1 - fraction) * weights[backward])});
+        return result;
+    }
+
+    SegmentIndex SegmentIndex::build(const RoutingGraph &graph) {
+        struct Entry {
+            Segment segment;
+            int64_t center_latitude, center_longitude; // Twice the centre, to stay in integers
+        };
+        std::vector<Entry> entries;
+        entries.reserve(graph.edge_count() / 2);
+        for (NodeIndex node = 0; node < graph.node_count(); ++node) {
+            for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                if (!graph.edge_is_positive_direction[edge]) continue;
+                const auto target = graph.edge_targets[edge];
+                const Segment segment{edge, graph.edge_twins[edge], graph.latitudes[node],
+                                      graph.longitudes[node], graph.latitudes[target], graph.longitudes[target]};
+                entries.push_back({segment, int64_t{segment.from_latitude} + segment.to_latitude,
+                                   int64_t{segment.from_longitude} + segment.to_longitude});
+            }
+        }
+        SegmentIndex index;
+        if (entries.empty()) return index;
+
+        // Sort-tile-recursive: vertical slices of about sqrt(leaves) leaves each, sorted by latitude inside
+        const size_t leaves = (entries.size() + fanout - 1) / fanout;
+        const size_t slice = fanout * static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(leaves))));
+        auto by_edge = [](const Entry &a, const Entry &b) { return a.segment.forward < b.segment.forward; };
+        std::ranges::sort(entries, [&](const Entry &a, const Entry &b) {
+            return a.center_longitude < b.center_longitude || (a.center_longitude == b.center_longitude && by_edge(a, b));
+        });
+        for (size_t begin = 0; begin < entries.size(); begin += slice) {
+            const auto end = entries.begin() + static_cast<std::ptrdiff_t>(std::min(begin + slice, entries.size()));
+            std::sort(entries.begin() + static_cast<std::ptrdiff_t>(begin), end, [&](const Entry &a, const Entry &b) {
+                return a.center_latitude < b.center_latitude || (a.center_latitude == b.center_latitude && by_edge(a, b));
+            });
+        }
+
+        std::vector<Segment> segments(entries.size());
+        std::vector<Box> boxes;
+        std::vector<uint32_t> level_offsets = {0};
+        for (size_t i = 0; i < entries.size(); ++i) {
+            segments[i] = entries[i].segment;
+            const auto box = bounds_of(segments[i]);
+            if (i % fanout == 0) boxes.push_back(box);
+            else boxes.back() = merge(boxes.back(), box);
+        }
+        // Each level groups the boxes of the one below until a single root is left
+        while (boxes.size() - level_offsets.back() > 1) {
+            const uint32_t begin = level_offsets.back(), end = static_cast<uint32_t>(boxes.size());
+            level_offsets.push_back(end);
+            for (uint32_t i = begin; i < end; ++i) {
+                if ((i - begin) % fanout == 0) boxes.push_back(boxes[i]);
+                else boxes.back() = merge(boxes.back(), boxes[i]);
+            }
+        }
+        level_offsets.push_back(static_cast<uint32_t>(boxes.size()));
+
+        index.segments = std::move(segments);
+        index.boxes = std::move(boxes);
+        index.level_offsets = std::move(level_offsets);
+        return index;
+    }
+
+    std::optional<EdgePoint> SegmentIndex::nearest(const RoutingGraph &graph, Geometry::Position position,
+                                                   double max_distance, const ProfileWeights &weights) const {
+        return nearest(graph, position, max_distance, [&](const Segment &segment) {
+            return std::isfinite(weights[segment.forward]) || std::isfinite(weights[segment.backward]);
+        });
+    }
+
+    EdgePoint SegmentIndex::project(const RoutingGraph &graph, const Segment &segment, Geometry::Position position) {
+        const auto [fraction, point, distance] = project(graph.projection, segment, graph.projection.project(position));
+        return {segment.forward, segment.backward, graph.edge_targets[segment.backward],
+                graph.edge_targets[segment.forward], fraction, graph.projection.unproject(point), distance};
+    }
+
+    SegmentIndex::Projection SegmentIndex::project(const Geometry::LocalProjection &projection, const Segment &segment,
+                                                   Geometry::Point point) {
+        const auto a = projection.project(segment.from_latitude, segment.from_longitude);
+        const auto b = projection.project(segment.to_latitude, segment.to_longitude);
+        const double dx = b.x - a.x, dy = b.y - a.y;
+        const double length = dx * dx + dy * dy;
+        double fraction = 0;
+        if (length > 0) fraction = std::clamp(((point.x - a.x) * dx + (point.y - a.y) * dy) / length, 0.0, 1.0);
+        const Geometry::Point foot{a.x + fraction * dx, a.y + fraction * dy};
+        return {fraction, foot, Geometry::distance(foot, point)};
+    }
+
+    SegmentIndex::Query::Query(const Geometry::LocalProjection &projection, Geometry::Position position):
+        projection(projection),
+        point(projection.project(position)),
+        probe(projection, position) {
+    }
+
+    void SegmentIndex::distances_to_boxes(const Query &query, std::span<const Box> boxes, std::span<double> result) {
+        Geometry::Kernels::box_distances(query.probe, boxes, result);
+        // Less a tiny margin, since the projection onto a segment in the box is rounded differently
+        for (auto &distance: result) distance = std::max(0.0, distance - 1e-6);
+    }
+}
@@ -0,0 +1,174 @@
+#ifndef SEGMENTINDEX_H
+#define SEGMENTINDEX_H
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Buffer.h"
+#include "Geometry.h"
+#include "GeometryKernels.h"
+#include "RoutingGraph.h"
+#include "RoutingProfile.h"
+
+namespace Foliage::Graph {
+    /**
+     * A point on the road network: the projection of a query position onto a segment u -> v.
+     */
+    struct EdgePoint {
+        EdgeIndex forward; // u -> v, following the way
+        EdgeIndex backward; // v -> u
+        NodeIndex from, to; // u and v
+        double fraction; // 0 at u, 1 at v
+        Geometry::Position position;
+        double distance; // From the query position, in metres
+
+        /**
+         * @return The nodes a search from this point starts at, with the cost of getting there along the
+         * segment. Directions the profile may not use are left out
+         */
+        [[nodiscard]] std::vector<Endpoint> departures(const ProfileWeights &weights) const;
+
+        /**
+         * @return The nodes a search towards this point ends at, with the cost of the rest of the way
+         */
+        [[nodiscard]] std::vector<Endpoint> arrivals(const ProfileWeights &weights) const;
+    };
+
+    /**
+     * Packed R-tree over the segments of a routing graph, for snapping onto road geometry instead of
+     * onto the nearest node. Segments are sorted into leaves of `fanout` by sort-tile-recursive
+     * bulk loading, and each level above groups `fanout` boxes of the level below, so the tree is
+     * three flat arrays that can be mapped from a snapshot as they are. Coordinates are fixed point,
+     * and distances are measured in metres on the graph's projection.
+     */
+    class SegmentIndex {
+    public:
+        static constexpr uint32_t fanout = 16;
+
+        struct Segment {
+            EdgeIndex forward, backward;
+            // Kept inline, so a search reads nothing but the index
+            int32_t from_latitude, from_longitude, to_latitude, to_longitude;
+        };
+
+        using Box = Geometry::FixedBox;
+
+        Util::Buffer<Segment> segments; // In leaf order
+        Util::Buffer<Box> boxes; // Level by level from the leaves up, the root last
+        Util::Buffer<uint32_t> level_offsets; // First box of every level, then boxes.size()
+
+        /**
+         * Indexes every pair of opposite edges once.
+         */
+        static SegmentIndex build(const RoutingGraph &graph);
+
+        /**
+         * Best-first search for the segment closest to `position`, at most `max_distance` away, among
+         * those for which filter(segment) holds. The lower forward edge wins ties.
+         */
+        template<class Filter> requires std::predicate<Filter &, const Segment &>
+        [[nodiscard]] std::optional<EdgePoint> nearest(const RoutingGraph &graph, Geometry::Position position,
+                                                       double max_distance, Filter &&filter) const;
+
+        /**
+         * @return The closest segment that `weights` can use in at least one direction
+         */
+        [[nodiscard]] std::optional<EdgePoint> nearest(const RoutingGraph &graph, Geometry::Position position,
+                                                       double max_distance, const ProfileWeights &weights) const;
+
+        /**
+         * @return The projection of `position` onto the segment
+         */
+        [[nodiscard]] static EdgePoint project(const RoutingGraph &graph, const Segment &segment,
+                                               Geometry::Position position);
+
+    private:
+        struct Projection {
+            double fraction;
+            Geometry::Point point;
+            double distance;
+        };
+
+        // A query position, both projected for segments and in the fixed-point units of the boxes
+        struct Query {
+            Geometry::LocalProjection projection;
+            Geometry::Point point;
+            Geometry::Kernels::Probe probe;
+
+            Query(const Geometry::LocalProjection &projection, Geometry::Position position);
+        };
+
+        [[nodiscard]] static Projection project(const Geometry::LocalProjection &projection, const Segment &segment,
+                                                Geometry::Point point);
+
+        /**
+         * result[i] = lower bound on the distance from the query to the segments in boxes[i]
+         */
+        static void distances_to_boxes(const Query &query, std::span<const Box> boxes, std::span<double> result);
+    };
+
+    template<class Filter> requires std::predicate<Filter &, const SegmentIndex::Segment &>
+    std::optional<EdgePoint> SegmentIndex::nearest(const RoutingGraph &graph, Geometry::Position position,
+                                                   double max_distance, Filter &&filter) const {
+        if (boxes.empty() || !(max_distance >= 0)) return std::nullopt;
+
+        struct Pending {
+            double distance;
+            uint32_t level, box;
+        };
+        auto closer_on_top = [](const Pending &a, const Pending &b) { return a.distance > b.distance; };
+        const Segment *best = nullptr;
+        Projection best_projection{};
+        auto limit = [&] { return best ? std::min(max_distance, best_projection.distance) : max_distance; };
+
+        const Query query(graph.projection, position);
+        std::vector<Pending> pending;
+        const uint32_t root_level = static_cast<uint32_t>(level_offsets.size()) - 2;
+        std::array<double, fanout> child_distances;
+        distances_to_boxes(query, {&boxes[level_offsets[root_level]], 1}, {child_distances.data(), 1});
+        pending.push_back({child_distances[0], root_level, 0});
+        while (!pending.empty()) {
+            std::ranges::pop_heap(pending, closer_on_top);
+            const auto [distance, level, box] = pending.back();
+            pending.pop_back();
+            // Boxes at exactly the limit may still hold a tie with a lower edge
+            if (distance > limit()) break;
+
+            const size_t first = static_cast<size_t>(box) * fanout;
+            if (level == 0) {
+                const size_t last = std::min<size_t>(first + fanout, segments.size());
+                for (size_t i = first; i < last; ++i) {
+                    const auto &segment = segments[i];
+                    const auto candidate = project(query.projection, segment, query.point);
+                    if (candidate.distance > limit() ||
+                        (best && candidate.distance == best_projection.distance && segment.forward > best->forward) ||
+                        !filter(segment)) {
+                        continue;
+                    }
+                    best = &segment;
+                    best_projection = candidate;
+                }
+                continue;
+            }
+            const size_t last = std::min<size_t>(first + fanout, level_offsets[level] - level_offsets[level - 1]);
+            distances_to_boxes(query, {&boxes[level_offsets[level - 1] + first], last - first},
+                               {child_distances.data(), last - first});
+            for (size_t child = first; child < last; ++child) {
+                const double child_distance = child_distances[child - first];
+                if (child_distance > limit()) continue;
+                pending.push_back({child_distance, level - 1, static_cast<uint32_t>(child)});
+                std::ranges::push_heap(pending, closer_on_top);
+            }
+        }
+        if (!best) return std::nullopt;
+        return EdgePoint{best->forward, best->backward, graph.edge_targets[best->backward],
+                         graph.edge_targets[best->forward], best_projection.fraction,
+                         query.projection.unproject(best_projection.point), best_projection.distance};
+    }
+}
+
+#endif //SEGMENTINDEX_H
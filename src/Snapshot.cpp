@@ -0,0 +1,437 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Checksum.h"
+
+namespace Foliage::Graph {
+    namespace {
+        constexpr char magic[8] = {'F', 'O', 'L', 'I', 'A', 'G', 'E', 'S'};
+        constexpr uint32_t byte_order_mark = 0x01020304;
+        constexpr size_t alignment = 64; // Of every section, so mapped arrays are aligned for any element type
+        constexpr size_t name_size = 96;
+
+        struct Header {
+            char magic[8];
+            uint32_t byte_order;
+            uint32_t version;
+            uint64_t section_count;
+            uint64_t table_checksum; // Of the section table that follows
+        };
+
+        struct SectionEntry {
+            char name[name_size]; // Null-terminated
+            uint64_t offset; // From the start of the file
+            uint64_t count;
+            uint32_t element_size;
+            uint32_t reserved;
+            uint64_t checksum; // Of the count * element_size data bytes
+        };
+
+        static_assert(sizeof(Header) == 32 && sizeof(SectionEntry) == 128);
+
+        size_t align(size_t offset) { return (offset + alignment - 1) / alignment * alignment; }
+
+        std::string landmarks_prefix(std::string_view profile) { return "landmarks/" + std::string(profile) + "/"; }
+        std::string hierarchy_prefix(std::string_view profile) { return "hierarchy/" + std::string(profile) + "/"; }
+
+        class Writer {
+        public:
+            template<class T>
+            void add(std::string name, const Util::Buffer<T> &values) {
+                add(std::move(name), values.data(), values.size(), sizeof(T));
+            }
+
+            template<class T>
+            void add_value(std::string name, const T &value) {
+                static_assert(std::is_trivially_copyable_v<T>);
+                add(std::move(name), &value, 1, sizeof(T));
+            }
+
+            void write(const std::string &path) const {
+                std::vector<SectionEntry> entries(sections.size());
+                size_t offset = align(sizeof(Header) + sections.size() * sizeof(SectionEntry));
+                for (size_t i = 0; i < sections.size(); ++i) {
+                    const auto &section = sections[i];
+                    auto &entry = entries[i];
+                    std::memset(&entry, 0, sizeof(entry));
+                    std::memcpy(entry.name, section.name.data(), section.name.size());
+                    entry.offset = offset;
+                    entry.count = section.count;
+                    entry.element_size = static_cast<uint32_t>(section.element_size);
+                    entry.checksum = Util::checksum(section.data, section.count * section.element_size);
+                    offset = align(offset + section.count * section.element_size);
+                }
+                Header header{};
+                std::memcpy(header.magic, magic, sizeof(magic));
+                header.byte_order = byte_order_mark;
+                header.version = Snapshot::version;
+                header.section_count = entries.size();
+                header.table_checksum = Util::checksum(entries.data(), entries.size() * sizeof(SectionEntry));
+
+                const auto temporary = path + ".tmp";
+                {
+                    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+                    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                    out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(SectionEntry));
+                    size_t position = sizeof(header) + entries.size() * sizeof(SectionEntry);
+                    const char padding[alignment] = {};
+                    for (size_t i = 0; i < sections.size(); ++i) {
+                        out.write(padding, static_cast<std::streamsize>(entries[i].offset - position));
+                        const auto bytes = sections[i].count * sections[i].element_size;
+                        out.write(static_cast<const char *>(sections[i].data), static_cast<std::streamsize>(bytes));
+                        position = entries[i].offset + bytes;
+                    }
+                    out.close();
+                    if (!out) {
+                        std::filesystem::remove(temporary);
+                        throw std::runtime_error("Could not write snapshot " + path);
+                    }
+                }
+                std::filesystem::rename(temporary, path);
+            }
+
+        private:
+            struct Section {
+                std::string name;
+                const void *data;
+                size_t count, element_size;
+            };
+
+            void add(std::string name, const void *data, size_t count, size_t element_size) {
+                if (name.size() >= name_size) throw std::invalid_argument("Snapshot section name too long: " + name);
+                sections.push_back({std::move(name), data, count, element_size});
+            }
+
+            std::vector<Section> sections;
+        };
+
+        class Reader {
+        public:
+            Reader(const std::string &path, bool verify): path(path) {
+                const int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0) throw std::runtime_error("Could not open snapshot " + path);
+                struct stat status{};
+                if (::fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Header))) {
+                    ::close(fd);
+                    fail("file too small");
+                }
+                size = static_cast<size_t>(status.st_size);
+                void *address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (address == MAP_FAILED) throw std::runtime_error("Could not map snapshot " + path);
+                mapping = std::shared_ptr<const void>(address, [length = size](const void *pointer) {
+                    ::munmap(const_cast<void *>(pointer), length);
+                });
+                const auto *base = static_cast<const char *>(address);
+
+                Header header;
+                std::memcpy(&header, base, sizeof(header));
+                if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) fail("not a snapshot file");
+                if (header.byte_order != byte_order_mark) fail("written on a machine with another byte order");
+                if (header.version != Snapshot::version) {
+                    fail("version " + std::to_string(header.version) + ", expected " + std::to_string(Snapshot::version));
+                }
+                if (header.section_count > (size - sizeof(Header)) / sizeof(SectionEntry)) fail("truncated section table");
+                const auto *table = base + sizeof(Header);
+                if (Util::checksum(table, header.section_count * sizeof(SectionEntry)) != header.table_checksum) {
+                    fail("section table checksum mismatch");
+                }
+                for (size_t i = 0; i < header.section_count; ++i) {
+                    SectionEntry entry;
+                    std::memcpy(&entry, table + i * sizeof(SectionEntry), sizeof(entry));
+                    entry.name[name_size - 1] = '\0';
+                    const uint64_t bytes = entry.count * entry.element_size;
+                    if (entry.offset % alignment != 0 || entry.offset > size ||
+                        (entry.element_size != 0 && entry.count > (size - entry.offset) / entry.element_size)) {
+                        fail(std::string("section ") + entry.name + " out of bounds");
+                    }
+                    if (verify && Util::checksum(base + entry.offset, bytes) != entry.checksum) {
+                        fail(std::string("checksum mismatch in section ") + entry.name);
+                    }
+                    sections.emplace(entry.name, entry);
+                }
+            }
+
+            template<class T>
+            Util::Buffer<T> buffer(const std::string &name) const {
+                const auto &entry = find(name);
+                if (entry.element_size != sizeof(T)) fail("unexpected element size in section " + name);
+                const auto *data = reinterpret_cast<const T *>(static_cast<const char *>(mapping.get()) + entry.offset);
+                return Util::Buffer<T>::view(data, entry.count, mapping);
+            }
+
+            template<class T>
+            T value(const std::string &name) const {
+                const auto &entry = find(name);
+                if (entry.element_size != sizeof(T) || entry.count != 1) fail("unexpected shape of section " + name);
+                T result;
+                std::memcpy(&result, static_cast<const char *>(mapping.get()) + entry.offset, sizeof(T));
+                return result;
+            }
+
+            /**
+             * @return The profile names that have a section "<kind>/<profile>/<last>"
+             */
+            [[nodiscard]] std::vector<std::string> profiles(std::string_view kind, std::string_view last) const {
+                std::vector<std::string> result;
+                const auto prefix = std::string(kind) + "/", suffix = "/" + std::string(last);
+                for (const auto &[name, _]: sections) {
+                    if (name.size() > prefix.size() + suffix.size() && name.starts_with(prefix) && name.ends_with(suffix)) {
+                        result.push_back(name.substr(prefix.size(), name.size() - prefix.size() - suffix.size()));
+                    }
+                }
+                return result;
+            }
+
+            [[noreturn]] void fail(const std::string &reason) const {
+                throw std::runtime_error("Invalid snapshot " + path + ": " + reason);
+            }
+
+        private:
+            const SectionEntry &find(const std::string &name) const {
+                const auto it = sections.find(name);
+                if (it == sections.end()) fail("missing section " + name);
+                return it->second;
+            }
+
+            std::string path;
+            size_t size = 0;
+            std::shared_ptr<const void> mapping;
+            std::map<std::string, SectionEntry, std::less<>> sections;
+        };
+    }
+
+    void Snapshot::write(const std::string &path) const {
+        if (!graph || !node_tree || !segments) {
+            throw std::invalid_argument("A snapshot needs a graph, a node tree and a segment index");
+        }
+        Writer writer;
+        writer.add_value("bounds", bounds);
+        writer.add("graph/node_ids", graph->node_ids);
+        writer.add("graph/latitudes", graph->latitudes);
+        writer.add("graph/longitudes", graph->longitudes);
+        writer.add_value("graph/projection", graph->projection);
+        writer.add("graph/edge_offsets", graph->edge_offsets);
+        writer.add("graph/edge_targets", graph->edge_targets);
+        writer.add("graph/edge_lengths", graph->edge_lengths);
+        writer.add("graph/edge_attributes", graph->edge_attributes);
+        writer.add("graph/edge_is_positive_direction", graph->edge_is_positive_direction);
+        writer.add("graph/edge_twins", graph->edge_twins);
+        writer.add("graph/attributes", graph->attributes);
+        writer.add("graph/attribute_tags", graph->attribute_tags);
+        writer.add("tags/text", graph->tags.text);
+        writer.add("tags/offsets", graph->tags.offsets);
+        const auto sorted_tags = graph->tags.sorted_ids();
+        writer.add("tags/sorted", sorted_tags);
+        writer.add_value("node_tree/shape", node_tree->shape);
+        writer.add("node_tree/cells", node_tree->cells);
+        writer.add("node_tree/items", node_tree->items);
+        writer.add("node_tree/latitudes", node_tree->latitudes);
+        writer.add("node_tree/longitudes", node_tree->longitudes);
+        writer.add("segments/segments", segments->segments);
+        writer.add("segments/boxes", segments->boxes);
+        writer.add("segments/level_offsets", segments->level_offsets);
+        for (const auto &[profile, table]: landmarks) {
+            const auto prefix = landmarks_prefix(profile);
+            writer.add(prefix + "landmarks", table->landmarks);
+            writer.add(prefix + "from", table->from_landmark);
+            writer.add(prefix + "to", table->to_landmark);
+            writer.add_value(prefix + "weights_checksum", table->weights_checksum);
+        }
+        for (const auto &[profile, hierarchy]: hierarchies) {
+            const auto prefix = hierarchy_prefix(profile);
+            writer.add(prefix + "rank", hierarchy->rank);
+            writer.add(prefix + "up_offsets", hierarchy->up_offsets);
+            writer.add(prefix + "up_arcs", hierarchy->up_arcs);
+            writer.add(prefix + "down_offsets", hierarchy->down_offsets);
+            writer.add(prefix + "down_arcs", hierarchy->down_arcs);
+            writer.add_value(prefix + "weights_checksum", hierarchy->weights_checksum);
+        }
+        writer.write(path);
+    }
+
+    Snapshot Snapshot::load(const std::string &path, bool verify) {
+        const Reader reader(path, verify);
+        Snapshot snapshot;
+        snapshot.bounds = reader.value<Geometry::BoundingBox>("bounds");
+
+        RoutingGraph graph;
+        graph.node_ids = reader.buffer<int64_t>("graph/node_ids");
+        graph.latitudes = reader.buffer<int32_t>("graph/latitudes");
+        graph.longitudes = reader.buffer<int32_t>("graph/longitudes");
+        graph.projection = reader.value<Geometry::LocalProjection>("graph/projection");
+        graph.edge_offsets = reader.buffer<EdgeIndex>("graph/edge_offsets");
+        graph.edge_targets = reader.buffer<NodeIndex>("graph/edge_targets");
+        graph.edge_lengths = reader.buffer<double>("graph/edge_lengths");
+        graph.edge_attributes = reader.buffer<uint32_t>("graph/edge_attributes");
+        graph.edge_is_positive_direction = reader.buffer<uint8_t>("graph/edge_is_positive_direction");
+        graph.edge_twins = reader.buffer<EdgeIndex>("graph/edge_twins");
+        graph.attributes = reader.buffer<WayAttributes>("graph/attributes");
+        graph.attribute_tags = reader.buffer<AttributeTag>("graph/attribute_tags");
+        const auto tag_text = reader.buffer<char>("tags/text");
+        const auto tag_offsets = reader.buffer<uint32_t>("tags/offsets");
+        if (tag_offsets.empty() || tag_offsets.back() > tag_text.size()) reader.fail("tag dictionary out of range");
+        graph.tags = Util::TagDictionary::view(tag_text, tag_offsets, reader.buffer<Util::TagId>("tags/sorted"));
+        const size_t nodes = graph.node_count(), edges = graph.edge_count();
+        if (graph.latitudes.size() != nodes || graph.longitudes.size() != nodes || graph.edge_offsets.size() != nodes + 1 ||
+            graph.edge_offsets.back() != edges || graph.edge_lengths.size() != edges ||
+            graph.edge_attributes.size() != edges || graph.edge_is_positive_direction.size() != edges ||
+            graph.edge_twins.size() != edges) {
+            reader.fail("graph arrays have inconsistent sizes");
+        }
+        snapshot.graph = std::make_shared<const RoutingGraph>(std::move(graph));
+        // Searches index with these values unchecked, so a consistent checksum is not enough
+        const auto &mapped = *snapshot.graph;
+        if (mapped.edge_offsets.front() != 0) reader.fail("graph edge offsets do not start at 0");
+        for (size_t node = 0; node < nodes; ++node) {
+            if (mapped.edge_offsets[node] > mapped.edge_offsets[node + 1]) reader.fail("graph edge offsets decrease");
+            if (node > 0 && mapped.node_ids[node - 1] >= mapped.node_ids[node]) reader.fail("graph node ids not sorted");
+        }
+        for (size_t edge = 0; edge < edges; ++edge) {
+            const auto twin = mapped.edge_twins[edge];
+            if (mapped.edge_targets[edge] >= nodes || mapped.edge_attributes[edge] >= mapped.attributes.size() ||
+                twin >= edges || mapped.edge_twins[twin] != edge) {
+                reader.fail("graph has an edge out of range");
+            }
+        }
+        for (const auto &attribute: mapped.attributes) {
+            if (attribute.tags_begin > attribute.tags_end || attribute.tags_end > mapped.attribute_tags.size()) {
+                reader.fail("graph has an attribute record out of range");
+            }
+        }
+        const auto &dictionary = mapped.tags;
+        for (size_t id = 0; id < dictionary.size(); ++id) {
+            if (dictionary.offsets[id] > dictionary.offsets[id + 1]) reader.fail("tag dictionary offsets decrease");
+        }
+        for (const auto &tag: mapped.attribute_tags) {
+            if (tag.key >= dictionary.size() || tag.value >= dictionary.size()) reader.fail("graph has a tag out of range");
+        }
+
+        Util::FlatQuadTree node_tree;
+        node_tree.shape = reader.value<Util::FlatQuadTree::Shape>("node_tree/shape");
+        node_tree.cells = reader.buffer<Util::FlatQuadTree::Cell>("node_tree/cells");
+        node_tree.items = reader.buffer<uint32_t>("node_tree/items");
+        node_tree.latitudes = reader.buffer<int32_t>("node_tree/latitudes");
+        node_tree.longitudes = reader.buffer<int32_t>("node_tree/longitudes");
+        if (node_tree.items.size() != nodes || node_tree.latitudes.size() != nodes ||
+            node_tree.longitudes.size() != nodes ||
+            node_tree.cells.empty() != (nodes == 0)) {
+            reader.fail("node tree does not match the graph");
+        }
+        const auto &cells = std::as_const(node_tree.cells); // Non-const access would copy the mapping
+        // Children come after their parent, so a walk down the tree ends, within the 32 levels below the root
+        // that its stack has room for
+        std::vector<uint8_t> cell_levels(cells.size(), 0);
+        for (size_t index = 0; index < cells.size(); ++index) {
+            const auto &cell = cells[index];
+            if (cell.begin > cell.end || cell.end > nodes ||
+                (cell.first_child != 0 && (cell.first_child <= index || cell.first_child + size_t{4} > cells.size() ||
+                                           cell_levels[index] >= 32))) {
+                reader.fail("node tree has a cell out of range");
+            }
+            if (cell.first_child != 0) {
+                for (size_t child = cell.first_child; child < cell.first_child + size_t{4}; ++child) {
+                    cell_levels[child] = std::max<uint8_t>(cell_levels[child], cell_levels[index] + 1);
+                }
+            }
+        }
+        if (std::ranges::any_of(std::as_const(node_tree.items), [&](uint32_t item) { return item >= nodes; })) {
+            reader.fail("node tree has an item out of range");
+        }
+        snapshot.node_tree = std::make_shared<const Util::FlatQuadTree>(std::move(node_tree));
+
+        SegmentIndex segments;
+        segments.segments = reader.buffer<SegmentIndex::Segment>("segments/segments");
+        segments.boxes = reader.buffer<SegmentIndex::Box>("segments/boxes");
+        segments.level_offsets = reader.buffer<uint32_t>("segments/level_offsets");
+        const auto &levels = std::as_const(segments.level_offsets);
+        // Levels start at box 0, each has a box for every `fanout` boxes or segments of the one below, and the
+        // last is the single root box. An index without boxes is never searched
+        auto levels_valid = [&] {
+            if (segments.boxes.empty()) return segments.segments.empty();
+            if (levels.size() < 2 || levels.front() != 0 || levels.back() != segments.boxes.size()) return false;
+            size_t below = segments.segments.size();
+            for (size_t level = 0; level + 1 < levels.size(); ++level) {
+                if (levels[level] > levels[level + 1] ||
+                    levels[level + 1] - levels[level] != (below + SegmentIndex::fanout - 1) / SegmentIndex::fanout) {
+                    return false;
+                }
+                below = levels[level + 1] - levels[level];
+            }
+            return below == 1;
+        };
+        if (segments.segments.size() * 2 > edges || !levels_valid()) {
+            reader.fail("segment index does not match the graph");
+        }
+        for (const auto &segment: std::as_const(segments.segments)) {
+            if (segment.forward >= edges || segment.backward >= edges) {
+                reader.fail("segment index has an edge out of range");
+            }
+        }
+        snapshot.segments = std::make_shared<const SegmentIndex>(std::move(segments));
+
+        for (const auto &profile: reader.profiles("landmarks", "landmarks")) {
+            const auto prefix = landmarks_prefix(profile);
+            LandmarkTable table;
+            table.landmarks = reader.buffer<NodeIndex>(prefix + "landmarks");
+            table.from_landmark = reader.buffer<float>(prefix + "from");
+            table.to_landmark = reader.buffer<float>(prefix + "to");
+            table.weights_checksum = reader.value<uint64_t>(prefix + "weights_checksum");
+            if (table.from_landmark.size() != nodes * table.size() || table.to_landmark.size() != nodes * table.size() ||
+                std::ranges::any_of(std::as_const(table.landmarks), [&](NodeIndex node) { return node >= nodes; })) {
+                reader.fail("landmark table of " + profile + " does not match the graph");
+            }
+            snapshot.landmarks.emplace(profile, std::make_shared<const LandmarkTable>(std::move(table)));
+        }
+        for (const auto &profile: reader.profiles("hierarchy", "rank")) {
+            const auto prefix = hierarchy_prefix(profile);
+            ContractionHierarchy hierarchy;
+            hierarchy.profile = profile;
+            hierarchy.rank = reader.buffer<uint32_t>(prefix + "rank");
+            hierarchy.up_offsets = reader.buffer<EdgeIndex>(prefix + "up_offsets");
+            hierarchy.up_arcs = reader.buffer<ContractionHierarchy::Arc>(prefix + "up_arcs");
+            hierarchy.down_offsets = reader.buffer<EdgeIndex>(prefix + "down_offsets");
+            hierarchy.down_arcs = reader.buffer<ContractionHierarchy::Arc>(prefix + "down_arcs");
+            hierarchy.weights_checksum = reader.value<uint64_t>(prefix + "weights_checksum");
+            if (hierarchy.rank.size() != nodes || hierarchy.up_offsets.size() != nodes + 1 ||
+                hierarchy.down_offsets.size() != nodes + 1 || hierarchy.up_offsets.back() != hierarchy.up_arcs.size() ||
+                hierarchy.down_offsets.back() != hierarchy.down_arcs.size()) {
+                reader.fail("hierarchy of " + profile + " does not match the graph");
+            }
+            // Arcs lead to more important nodes, and a shortcut bypasses a node less important than both its
+            // ends, which is what keeps unpacking it finite
+            const auto &rank = std::as_const(hierarchy.rank);
+            auto check_arcs = [&](const Util::Buffer<EdgeIndex> &offsets,
+                                  const Util::Buffer<ContractionHierarchy::Arc> &arcs) {
+                if (offsets.front() != 0) reader.fail("hierarchy of " + profile + " has offsets not starting at 0");
+                for (size_t node = 0; node < nodes; ++node) {
+                    if (offsets[node] > offsets[node + 1]) reader.fail("hierarchy of " + profile + " has offsets decreasing");
+                    for (auto arc = offsets[node]; arc < offsets[node + 1]; ++arc) {
+                        const auto target = arcs[arc].target, middle = arcs[arc].middle;
+                        if (target >= nodes || rank[target] <= rank[node] ||
+                            (middle != invalid_node && (middle >= nodes || rank[middle] >= rank[node]))) {
+                            reader.fail("hierarchy of " + profile + " has an arc out of range");
+                        }
+                    }
+                }
+            };
+            check_arcs(std::as_const(hierarchy.up_offsets), std::as_const(hierarchy.up_arcs));
+            check_arcs(std::as_const(hierarchy.down_offsets), std::as_const(hierarchy.down_arcs));
+            snapshot.hierarchies.emplace(profile, std::make_shared<const ContractionHierarchy>(std::move(hierarchy)));
+        }
+        return snapshot;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "ContractionHierarchy.h"
+#include "FlatQuadTree.h"
+#include "Geometry.h"
+#include "Landmarks.h"
+#include "RoutingGraph.h"
+#include "SegmentIndex.h"
+
+namespace Foliage::Graph {
+    /**
+     * A loaded region in one binary file: the routing graph with its tag dictionary, the node quadtree and segment index,
+     * and the landmark tables and contraction hierarchies of some profiles.
+     * Loading maps the file read-only and points every array into the mapping, so nothing is copied
+     * or decoded. The file is a versioned header, a table of named sections with one checksum each,
+     * and the section data in native byte order.
+     */
+    struct Snapshot {
+        static constexpr uint32_t version = 5;
+
+        Geometry::BoundingBox bounds;
+        std::shared_ptr<const RoutingGraph> graph;
+        std::shared_ptr<const Util::FlatQuadTree> node_tree; // Over the graph nodes
+        std::shared_ptr<const SegmentIndex> segments;
+        // By profile name; whether they still match the profile weights is up to the user to check
+        std::map<std::string, std::shared_ptr<const LandmarkTable>, std::less<>> landmarks;
+        std::map<std::string, std::shared_ptr<const ContractionHierarchy>, std::less<>> hierarchies;
+
+        /**
+         * Writes to a temporary file next to `path`, then renames it over `path`.
+         */
+        void write(const std::string &path) const;
+
+        /**
+         * @param verify Check the checksum of every section, which reads the whole file once
+         */
+        static Snapshot load(const std::string &path, bool verify = true);
+    };
+}
+
+#endif //SNAPSHOT_H
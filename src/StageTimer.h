@@ -0,0 +1,47 @@
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace Foliage::Util {
+    /**
+     * Wall-clock durations of consecutive stages of a pipeline, e.g. the steps of loading a region.
+     * Each lap() closes the stage that started at the previous lap (or at construction).
+     */
+    class StageTimer {
+    public:
+        struct Stage {
+            std::string name;
+            double seconds;
+        };
+
+        StageTimer(): last(std::chrono::steady_clock::now()) {}
+
+        void lap(std::string name) {
+            const auto now = std::chrono::steady_clock::now();
+            stages.push_back({std::move(name), std::chrono::duration<double>(now - last).count()});
+            last = now;
+        }
+
+        // Starts the next stage now, without recording the time since the last lap
+        void restart() { last = std::chrono::steady_clock::now(); }
+
+        void append(const StageTimer &other) {
+            stages.insert(stages.end(), other.stages.begin(), other.stages.end());
+        }
+
+        [[nodiscard]] double total() const {
+            double result = 0;
+            for (const auto &stage: stages) result += stage.seconds;
+            return result;
+        }
+
+        std::vector<Stage> stages;
+
+    private:
+        std::chrono::steady_clock::time_point last;
+    };
+}
+
+#endif //STAGETIMER_H
@@ -0,0 +1,63 @@
+#include "TagDictionary.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace Foliage::Util {
+    TagDictionary TagDictionary::view(Buffer<char> text, Buffer<uint32_t> offsets, Buffer<TagId> sorted) {
+        if (offsets.empty() || offsets.back() != text.size() || sorted.size() != offsets.size() - 1) {
+            throw std::invalid_argument("Inconsistent tag dictionary storage");
+        }
+        const auto &ids = std::as_const(sorted); // Non-const access would copy a mapped buffer
+        if (std::ranges::any_of(ids, [&](TagId id) { return id >= ids.size(); })) {
+            throw std::invalid_argument("Tag dictionary id out of range");
+        }
+        TagDictionary result;
+        result.text = std::move(text);
+        result.offsets = std::move(offsets);
+        result.sorted = std::move(sorted);
+        result.indexed = false;
+        return result;
+    }
+
+    TagId TagDictionary::intern(std::string_view text) {
+        if (!indexed) {
+            // Interning into a view: index the existing strings once, the buffers copy themselves on write
+            for (TagId id = 0; id < size(); ++id) ids.emplace(at(id), id);
+            sorted.clear();
+            indexed = true;
+        }
+        if (const auto it = ids.find(text); it != ids.end()) return it->second;
+        const auto id = static_cast<TagId>(size());
+        this->text.append(text.begin(), text.end());
+        offsets.push_back(static_cast<uint32_t>(this->text.size()));
+        ids.emplace(text, id);
+        return id;
+    }
+
+    TagId TagDictionary::find(std::string_view text) const {
+        if (indexed) {
+            const auto it = ids.find(text);
+            return it == ids.end() ? invalid_tag : it->second;
+        }
+        const auto it = std::lower_bound(sorted.begin(), sorted.end(), text, [&](TagId id, std::string_view value) {
+            return at(id) < value;
+        });
+        return it != sorted.end() && at(*it) == text ? *it : invalid_tag;
+    }
+
+    std::string_view TagDictionary::at(TagId id) const {
+        if (id >= size()) throw std::out_of_range("Unknown tag id " + std::to_string(id));
+        return {text.data() + offsets[id], offsets[id + 1] - offsets[id]};
+    }
+
+    Buffer<TagId> TagDictionary::sorted_ids() const {
+        if (!indexed) return sorted;
+        std::vector<TagId> result(size());
+        std::iota(result.begin(), result.end(), 0);
+        std::ranges::sort(result, [&](TagId a, TagId b) { return at(a) < at(b); });
+        return result;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef TAGDICTIONARY_H
+#define TAGDICTIONARY_H
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Buffer.h"
+
+namespace Foliage::Util {
+    using TagId = uint32_t;
+    constexpr TagId invalid_tag = std::numeric_limits<TagId>::max();
+
+    /**
+     * Interns tag keys and values so that tag records can store small integer ids
+     * instead of strings. Ids are dense and handed out in first-seen order.
+     * Strings are stored back to back in one character buffer, so a dictionary can be
+     * written to a snapshot and mapped back without rebuilding it.
+     */
+    class TagDictionary {
+    public:
+        // Storage, exposed for snapshots: string i is text[offsets[i], offsets[i + 1])
+        Buffer<char> text;
+        Buffer<uint32_t> offsets{0};
+
+        TagDictionary() = default;
+
+        /**
+         * A read-only dictionary over existing storage, looked up by binary search in `sorted`.
+         * @param sorted All ids, ordered by their string, as returned by sorted_ids()
+         */
+        static TagDictionary view(Buffer<char> text, Buffer<uint32_t> offsets, Buffer<TagId> sorted);
+
+        /**
+         * @return The id of `text`, adding it to the dictionary first if needed
+         */
+        TagId intern(std::string_view text);
+
+        /**
+         * @return The id of `text`, or invalid_tag if it was never interned
+         */
+        [[nodiscard]] TagId find(std::string_view text) const;
+
+        [[nodiscard]] std::string_view at(TagId id) const;
+
+        [[nodiscard]] size_t size() const { return offsets.size() - 1; }
+
+        /**
+         * @return All ids, ordered by their string
+         */
+        [[nodiscard]] Buffer<TagId> sorted_ids() const;
+
+    private:
+        struct Hash {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+        };
+
+        // Either `ids` holds every string, or the dictionary is a view searched through `sorted`
+        std::unordered_map<std::string, TagId, Hash, std::equal_to<>> ids;
+        Buffer<TagId> sorted;
+        bool indexed = true;
+    };
+}
+
+#endif //TAGDICTIONARY_H
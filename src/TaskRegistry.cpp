@@ -0,0 +1,193 @@
+#include "TaskRegistry.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace Foliage::Util {
+    TaskRegistry::Handle::Handle(TaskRegistry &registry, uint64_t number, std::shared_ptr<Entry> entry):
+        registry(&registry),
+        number(number),
+        entry(std::move(entry)),
+        task_id("task_" + std::to_string(number)) {
+    }
+
+    void TaskRegistry::Handle::finish(Status status, std::string result) const {
+        if (status != Status::Success && status != Status::Failed) {
+            throw std::invalid_argument("A task finishes with Success or Failed");
+        }
+        auto &shard = registry->shard_of(number);
+        auto shared_result = std::make_shared<const std::string>(std::move(result));
+        const auto now = Clock::now();
+        {
+            std::lock_guard lock(shard.mutex);
+            if (entry->finished) throw std::logic_error("Task " + task_id + " finished twice");
+            const size_t size = shared_result->size();
+            entry->result = std::move(shared_result);
+            entry->last_used = now;
+            entry->lru = shard.lru.insert(shard.lru.begin(), number);
+            entry->finished = true;
+            entry->status.store(status, std::memory_order_release);
+            shard.bytes += size;
+            registry->bytes += size;
+        }
+        shard.finished.notify_all();
+    }
+
+    TaskRegistry::Status TaskRegistry::Handle::wait(std::chrono::steady_clock::time_point deadline) const {
+        auto &shard = registry->shard_of(number);
+        std::unique_lock lock(shard.mutex);
+        return TaskRegistry::wait(shard, lock, *entry, deadline);
+    }
+
+    TaskRegistry::TaskRegistry(const Options &options):
+        options(options),
+        shard_budget(options.max_bytes / std::max<size_t>(options.shards, 1)),
+        shards(std::max<size_t>(options.shards, 1)),
+        sweeper([this] { sweep(); }) {
+    }
+
+    TaskRegistry::~TaskRegistry() {
+        {
+            std::lock_guard lock(sweeper_mutex);
+            stopping = true;
+        }
+        sweeper_wake.notify_all();
+        sweeper.join();
+    }
+
+    TaskRegistry::Handle TaskRegistry::create() {
+        const uint64_t number = next_number++;
+        auto entry = std::make_shared<Entry>();
+        auto &shard = shard_of(number);
+        {
+            std::lock_guard lock(shard.mutex);
+            shard.entries.emplace(number, entry);
+            shard.bytes += entry_bytes;
+            trim(shard, Clock::now());
+        }
+        ++tasks;
+        bytes += entry_bytes;
+        return {*this, number, std::move(entry)};
+    }
+
+    TaskRegistry::Status TaskRegistry::status(std::string_view id) {
+        uint64_t number;
+        if (!parse(id, number)) return Status::NotFound;
+        auto &shard = shard_of(number);
+        const auto now = Clock::now();
+        std::lock_guard lock(shard.mutex);
+        const auto entry = find(shard, number, now);
+        trim(shard, now);
+        return entry ? entry->status.load(std::memory_order_acquire) : Status::NotFound;
+    }
+
+    TaskRegistry::Status TaskRegistry::wait(std::string_view id, std::chrono::steady_clock::time_point deadline) {
+        uint64_t number;
+        if (!parse(id, number)) return Status::NotFound;
+        auto &shard = shard_of(number);
+        const auto now = Clock::now();
+        std::unique_lock lock(shard.mutex);
+        // Held on to, so that the status can still be read if the task is evicted right after finishing
+        const auto entry = find(shard, number, now);
+        trim(shard, now);
+        return entry ? wait(shard, lock, *entry, deadline) : Status::NotFound;
+    }
+
+    std::shared_ptr<const std::string> TaskRegistry::result(std::string_view id) {
+        uint64_t number;
+        if (!parse(id, number)) return nullptr;
+        auto &shard = shard_of(number);
+        const auto now = Clock::now();
+        std::lock_guard lock(shard.mutex);
+        const auto entry = find(shard, number, now);
+        if (!entry || !entry->finished) {
+            trim(shard, now);
+            return nullptr;
+        }
+        entry->last_used = now;
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry->lru);
+        trim(shard, now); // After the read, which makes its result the one to keep
+        return entry->result;
+    }
+
+    TaskRegistry::Stats TaskRegistry::stats() const {
+        return {tasks.load(), bytes.load(), next_number.load(), expired.load(), evicted.load()};
+    }
+
+    std::string_view TaskRegistry::to_string(Status status) {
+        switch (status) {
+            case Status::InQueue: return "InQueue";
+            case Status::Running: return "Running";
+            case Status::Success: return "Success";
+            case Status::Failed: return "Failed";
+            default: return "NotFound";
+        }
+    }
+
+    std::shared_ptr<TaskRegistry::Entry> TaskRegistry::find(Shard &shard, uint64_t number, Clock::time_point now) {
+        const auto it = shard.entries.find(number);
+        if (it == shard.entries.end()) return nullptr;
+        if (it->second->finished && now - it->second->last_used > options.ttl) {
+            evict(shard, number, false);
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    void TaskRegistry::evict(Shard &shard, uint64_t number, bool for_memory) {
+        const auto it = shard.entries.find(number);
+        const size_t size = entry_bytes + it->second->result->size();
+        shard.lru.erase(it->second->lru);
+        shard.entries.erase(it);
+        shard.bytes -= size;
+        bytes -= size;
+        --tasks;
+        ++(for_memory ? evicted : expired);
+    }
+
+    TaskRegistry::Status TaskRegistry::wait(Shard &shard, std::unique_lock<std::mutex> &lock, const Entry &entry,
+                                            Clock::time_point deadline) {
+        shard.finished.wait_until(lock, deadline, [&] { return entry.finished; });
+        return entry.status.load(std::memory_order_acquire);
+    }
+
+    size_t TaskRegistry::trim(Shard &shard, Clock::time_point now, size_t limit) {
+        // The back is the least recently used, so it expires first too. The newest result always stays
+        size_t evictions = 0;
+        for (; evictions < limit && !shard.lru.empty(); ++evictions) {
+            const uint64_t oldest = shard.lru.back();
+            if (now - shard.entries.at(oldest)->last_used > options.ttl) {
+                evict(shard, oldest, false);
+            } else if (shard.bytes > shard_budget && shard.lru.size() > 1) {
+                evict(shard, oldest, true);
+            } else {
+                break;
+            }
+        }
+        return evictions;
+    }
+
+    void TaskRegistry::sweep() {
+        // In rounds of a few evictions, letting go of the lock in between for the workers and clients
+        constexpr size_t round = 64;
+        std::unique_lock lock(sweeper_mutex);
+        while (!sweeper_wake.wait_for(lock, options.sweep_interval, [&] { return stopping; })) {
+            for (auto &shard: shards) {
+                size_t evictions;
+                do {
+                    std::lock_guard shard_lock(shard.mutex);
+                    evictions = trim(shard, Clock::now(), round);
+                } while (evictions == round);
+            }
+        }
+    }
+
+    bool TaskRegistry::parse(std::string_view id, uint64_t &number) {
+        constexpr std::string_view prefix = "task_";
+        if (!id.starts_with(prefix)) return false;
+        id.remove_prefix(prefix.size());
+        const auto [end, error] = std::from_chars(id.data(), id.data() + id.size(), number);
+        return error == std::errc() && end == id.data() + id.size() && !id.empty();
+    }
+}
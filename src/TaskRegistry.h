@@ -0,0 +1,186 @@
+#ifndef TASKREGISTRY_H
+#define TASKREGISTRY_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Foliage::Util {
+    /**
+     * Status and result of every task the server has accepted, for the clients polling them.
+     * Tasks are spread over shards by their number, each with its own lock, which is held for a hash lookup
+     * or an insertion and at most `evictions_per_call` evictions; workers update the status of a running task
+     * without taking it, and finishing one only publishes its result. Finished tasks are evicted once unread
+     * for `ttl`, and the least recently read ones go first when a shard's results outgrow its share of
+     * `max_bytes`. Unfinished tasks are never evicted. Each lookup or new task of a shard evicts a few of its
+     * tasks, and a sweeper thread goes over every shard each `sweep_interval` for the rest, taking the lock
+     * for a few at a time too.
+     * Clients can block until a task finishes instead of polling it: finishing wakes the waiters of the shard.
+     */
+    class TaskRegistry {
+    public:
+        enum class Status : uint8_t {
+            NotFound, // Never created, or evicted
+            InQueue,
+            Running,
+            Success,
+            Failed
+        };
+
+        struct Options {
+            size_t max_bytes = size_t{256} << 20; // Of results and bookkeeping together
+            std::chrono::steady_clock::duration ttl = std::chrono::minutes(10);
+            size_t shards = 64;
+            std::chrono::steady_clock::duration sweep_interval = std::chrono::seconds(10);
+        };
+
+        struct Stats {
+            size_t tasks; // Currently held
+            size_t bytes;
+            uint64_t created;
+            uint64_t expired; // Evicted for `ttl`
+            uint64_t evicted; // Evicted for `max_bytes`
+        };
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Entry {
+            std::atomic<Status> status{Status::InQueue};
+            // The rest belongs to the shard lock
+            std::shared_ptr<const std::string> result;
+            Clock::time_point last_used;
+            std::list<uint64_t>::iterator lru; // Valid once finished
+            bool finished = false;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_map<uint64_t, std::shared_ptr<Entry>> entries;
+            std::list<uint64_t> lru; // Finished tasks, most recently used first
+            size_t bytes = 0;
+            std::condition_variable finished; // Notified whenever a task of the shard finishes
+        };
+
+    public:
+        /**
+         * What the worker running a task reports through.
+         */
+        class Handle {
+        public:
+            [[nodiscard]] const std::string &id() const { return task_id; }
+
+            /**
+             * Marks the task as running. Lock-free.
+             */
+            void start() const { entry->status.store(Status::Running, std::memory_order_release); }
+
+            /**
+             * Stores the result and the final status, Success or Failed. Evicts nothing, so a worker never
+             * pays for the results of others.
+             */
+            void finish(Status status, std::string result) const;
+
+            /**
+             * Blocks until the task finishes or `deadline` passes.
+             * @return The status of the task then
+             */
+            Status wait(std::chrono::steady_clock::time_point deadline) const;
+
+        private:
+            friend class TaskRegistry;
+
+            Handle(TaskRegistry &registry, uint64_t number, std::shared_ptr<Entry> entry);
+
+            TaskRegistry *registry;
+            uint64_t number;
+            std::shared_ptr<Entry> entry;
+            std::string task_id;
+        };
+
+        TaskRegistry(): TaskRegistry(Options{}) {
+        }
+
+        explicit TaskRegistry(const Options &options);
+
+        ~TaskRegistry();
+
+        // The sweeper refers to the registry
+        TaskRegistry(const TaskRegistry &) = delete;
+        TaskRegistry &operator=(const TaskRegistry &) = delete;
+
+        /**
+         * Registers a new task, InQueue.
+         */
+        Handle create();
+
+        [[nodiscard]] Status status(std::string_view id);
+
+        /**
+         * Blocks until the task finishes or `deadline` passes, for long polling.
+         * @return The status of the task then
+         */
+        Status wait(std::string_view id, std::chrono::steady_clock::time_point deadline);
+
+        /**
+         * @return The result of a finished task, or nullptr if it is not finished or not known
+         */
+        [[nodiscard]] std::shared_ptr<const std::string> result(std::string_view id);
+
+        [[nodiscard]] Stats stats() const;
+
+        static std::string_view to_string(Status status);
+
+    private:
+        // Bookkeeping per task, on top of its result: the entry, its map node and its LRU node
+        static constexpr size_t entry_bytes = sizeof(Entry) + 96;
+
+        Shard &shard_of(uint64_t number) { return shards[number % shards.size()]; }
+
+        // The entry of a task that has not expired, or nullptr. Needs the shard lock
+        std::shared_ptr<Entry> find(Shard &shard, uint64_t number, Clock::time_point now);
+
+        void evict(Shard &shard, uint64_t number, bool for_memory);
+
+        // Needs the shard lock, which it releases while waiting
+        static Status wait(Shard &shard, std::unique_lock<std::mutex> &lock, const Entry &entry,
+                           Clock::time_point deadline);
+
+        // Evictions a client call makes at most, so that a lookup holds the shard lock for constant time
+        static constexpr size_t evictions_per_call = 4;
+
+        /**
+         * Evicts expired tasks, then the least recently used ones while the shard is over budget, `limit` at
+         * most. Needs the lock
+         * @return The number of tasks evicted
+         */
+        size_t trim(Shard &shard, Clock::time_point now, size_t limit = evictions_per_call);
+
+        // Trims every shard each sweep_interval until the registry is destroyed
+        void sweep();
+
+        static bool parse(std::string_view id, uint64_t &number);
+
+        Options options;
+        size_t shard_budget;
+        std::vector<Shard> shards;
+        std::atomic<uint64_t> next_number{0};
+        std::atomic<size_t> tasks{0}, bytes{0};
+        std::atomic<uint64_t> expired{0}, evicted{0};
+
+        std::mutex sweeper_mutex;
+        std::condition_variable sweeper_wake;
+        bool stopping = false; // Belongs to sweeper_mutex
+        std::thread sweeper; // Last, so that it starts once the rest is set up
+    };
+}
+
+#endif //TASKREGISTRY_H
@@ -0,0 +1,42 @@
+#include "ThreadPool.h"
+
+namespace Foliage::Util {
+    ThreadPool::ThreadPool(const size_t threads) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] {
+                while (true) {
+                    std::function<void()> task; {
+                        std::unique_lock lock(mutex);
+                        available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                        if (stopping && tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto &worker: workers) worker.join();
+    }
+
+    void ThreadPool::enqueue(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex);
+            tasks.push(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    ThreadPool &ThreadPool::shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Foliage::Util {
+    /**
+     * Fixed-size pool of worker threads for CPU-bound work (decoding, graph construction).
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency()));
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        [[nodiscard]] size_t size() const { return workers.size(); }
+
+        template<typename F>
+        auto submit(F &&task) -> std::future<std::invoke_result_t<F>> {
+            auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+            auto future = packaged->get_future();
+            enqueue([packaged] { (*packaged)(); });
+            return future;
+        }
+
+        /**
+         * Runs body(i) for every i in [0, count) and returns once all of them are done.
+         * The calling thread takes part, so this is safe to call from inside a pool task.
+         * The first exception thrown by body is rethrown here.
+         */
+        template<typename F>
+        void parallel_for(size_t count, F &&body) {
+            if (count == 0) return;
+            struct State {
+                std::atomic<size_t> next{0};
+                std::atomic<size_t> done{0};
+                std::mutex mutex;
+                std::condition_variable finished;
+                std::exception_ptr error;
+            };
+            auto state = std::make_shared<State>();
+            auto *body_ptr = &body;
+            auto run = [state, body_ptr, count] {
+                for (size_t i; (i = state->next.fetch_add(1)) < count;) {
+                    try {
+                        (*body_ptr)(i);
+                    } catch (...) {
+                        std::lock_guard lock(state->mutex);
+                        if (!state->error) state->error = std::current_exception();
+                    }
+                    if (state->done.fetch_add(1) + 1 == count) {
+                        std::lock_guard lock(state->mutex);
+                        state->finished.notify_all();
+                    }
+                }
+            };
+            for (size_t i = 1; i < std::min(count, size() + 1); ++i) enqueue(run);
+            run();
+
+            std::unique_lock lock(state->mutex);
+            state->finished.wait(lock, [&] { return state->done.load() == count; });
+            if (state->error) std::rethrow_exception(state->error);
+        }
+
+        /**
+         * Process-wide pool sized to the machine.
+         */
+        static ThreadPool &shared();
+
+    private:
+        void enqueue(std::function<void()> task);
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable available;
+        bool stopping = false;
+    };
+}
+
+#endif //THREADPOOL_H
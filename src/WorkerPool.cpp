@@ -0,0 +1,111 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace Foliage::Util {
+    WorkerPool::WorkerPool(size_t query_workers, size_t load_workers) {
+        const std::array<size_t, lane_count> sizes = {std::max<size_t>(load_workers, 1),
+                                                      std::max<size_t>(query_workers, 1)};
+        for (size_t l = 0; l < lane_count; ++l) {
+            for (size_t i = 0; i < sizes[l]; ++i) lanes[l].workers.push_back(std::make_unique<Worker>());
+        }
+        // Only once every deque exists, since workers steal from all of them
+        for (auto &lane: lanes) {
+            for (size_t i = 0; i < lane.workers.size(); ++i) {
+                lane.workers[i]->thread = std::thread([this, &lane, i] { work(lane, i); });
+            }
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        stopping = true;
+        for (auto &lane: lanes) {
+            {
+                std::lock_guard lock(lane.mutex);
+            }
+            lane.available.notify_all();
+        }
+        for (auto &lane: lanes) {
+            for (auto &worker: lane.workers) worker->thread.join();
+        }
+    }
+
+    void WorkerPool::submit(Lane lane_id, std::function<void()> task) {
+        auto &lane = lanes[static_cast<size_t>(lane_id)];
+        {
+            std::lock_guard lock(lane.mutex);
+            ++lane.queued;
+        }
+        auto &worker = *lane.workers[lane.next_worker++ % lane.workers.size()];
+        {
+            std::lock_guard lock(worker.mutex);
+            worker.jobs.push_back({std::move(task), Clock::now()});
+        }
+        lane.available.notify_one();
+    }
+
+    WorkerPool::LaneStats WorkerPool::stats(Lane lane_id) const {
+        const auto &lane = lanes[static_cast<size_t>(lane_id)];
+        return {lane.workers.size(), static_cast<size_t>(std::max<int64_t>(lane.queued.load(), 0)),
+                lane.running.load(), lane.completed.load(), lane.failed.load(), lane.stolen.load(),
+                static_cast<double>(lane.busy_nanoseconds.load()) * 1e-9,
+                static_cast<double>(lane.max_nanoseconds.load()) * 1e-9,
+                static_cast<double>(lane.wait_nanoseconds.load()) * 1e-9};
+    }
+
+    bool WorkerPool::take(LaneState &lane, size_t index, Job &job) {
+        {
+            auto &own = *lane.workers[index];
+            std::lock_guard lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = std::move(own.jobs.front());
+                own.jobs.pop_front();
+                --lane.queued;
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < lane.workers.size(); ++offset) {
+            auto &victim = *lane.workers[(index + offset) % lane.workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (victim.jobs.empty()) continue;
+            job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            --lane.queued;
+            ++lane.stolen;
+            return true;
+        }
+        return false;
+    }
+
+    void WorkerPool::work(LaneState &lane, size_t index) {
+        while (true) {
+            Job job;
+            if (!take(lane, index, job)) {
+                std::unique_lock lock(lane.mutex);
+                // A job counted in `queued` may not have reached its deque yet; then this only spins briefly
+                lane.available.wait(lock, [&] { return stopping || lane.queued > 0; });
+                if (stopping && lane.queued <= 0) return;
+                continue;
+            }
+
+            const auto started = Clock::now();
+            ++lane.running;
+            try {
+                job.task();
+            } catch (...) {
+                // Tasks report their own errors; this only keeps the worker alive
+                ++lane.failed;
+            }
+            --lane.running;
+            const auto finished = Clock::now();
+            const auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started).count();
+            lane.busy_nanoseconds += busy;
+            lane.wait_nanoseconds +=
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(started - job.submitted).count();
+            for (auto longest = lane.max_nanoseconds.load();
+                 busy > longest && !lane.max_nanoseconds.compare_exchange_weak(longest, busy);) {
+            }
+            ++lane.completed;
+        }
+    }
+}
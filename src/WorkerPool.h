@@ -0,0 +1,99 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Foliage::Util {
+    /**
+     * Long-lived workers for the requests of the HTTP server, in separate lanes so that a long task of
+     * one kind (a map load) never holds up tasks of another (queries).
+     * Every worker has its own deque. Tasks are dealt round-robin onto the deques of their lane; a worker
+     * takes the oldest task of its own deque first and, once that is empty, steals the newest task of
+     * another worker of the lane, so one slow task only delays what was queued behind it on its worker
+     * until someone else is free.
+     */
+    class WorkerPool {
+    public:
+        enum class Lane : uint8_t {
+            Load, // Loads and snapshots, which replace or write the whole map
+            Query // Routing requests, which only read it
+        };
+
+        static constexpr size_t lane_count = 2;
+
+        struct LaneStats {
+            size_t workers;
+            size_t queued; // Submitted but not started
+            size_t running;
+            uint64_t completed; // Including failed ones
+            uint64_t failed; // Threw out of the task
+            uint64_t stolen; // Taken from another worker's deque
+            double busy_seconds; // Total run time of the completed tasks
+            double max_seconds; // Longest run time of a task
+            double wait_seconds; // Total time the completed tasks were queued
+        };
+
+        /**
+         * @param query_workers, load_workers Threads per lane, at least one each
+         */
+        WorkerPool(size_t query_workers, size_t load_workers = 1);
+
+        /**
+         * Runs what is still queued, then stops.
+         */
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        void submit(Lane lane, std::function<void()> task);
+
+        [[nodiscard]] LaneStats stats(Lane lane) const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Job {
+            std::function<void()> task;
+            Clock::time_point submitted;
+        };
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            std::thread thread;
+        };
+
+        struct LaneState {
+            std::vector<std::unique_ptr<Worker>> workers;
+            std::atomic<size_t> next_worker{0}; // Round-robin target of submit
+            // Counts jobs from submit until a worker takes them; workers sleep while it is 0
+            std::atomic<int64_t> queued{0};
+            std::mutex mutex;
+            std::condition_variable available;
+
+            std::atomic<size_t> running{0};
+            std::atomic<uint64_t> completed{0}, failed{0}, stolen{0};
+            std::atomic<int64_t> busy_nanoseconds{0}, max_nanoseconds{0}, wait_nanoseconds{0};
+        };
+
+        void work(LaneState &lane, size_t index);
+
+        // Pops the oldest job of worker `index`, or steals the newest job of another worker of the lane
+        bool take(LaneState &lane, size_t index, Job &job);
+
+        std::array<LaneState, lane_count> lanes;
+        std::atomic<bool> stopping{false};
+    };
+}
+
+#endif //WORKERPOOL_H
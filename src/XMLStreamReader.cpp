@@ -0,0 +1,258 @@
+#include "XMLStreamReader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace Foliage::DataProvider::OSM {
+    namespace {
+        bool is_space(const char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        char *append_utf8(char *out, const uint32_t code_point) {
+            if (code_point < 0x80) {
+                *out++ = static_cast<char>(code_point);
+            } else if (code_point < 0x800) {
+                *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            } else if (code_point < 0x10000) {
+                *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            } else {
+                *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            return out;
+        }
+
+        // Decodes entities in place; every entity is at least as long as its expansion
+        size_t decode_entities(char *value, const size_t size) {
+            char *out = value;
+            const char *end = value + size;
+            for (const char *in = value; in < end;) {
+                if (*in != '&') {
+                    *out++ = *in++;
+                    continue;
+                }
+                const auto *semicolon = static_cast<const char *>(std::memchr(in, ';', end - in));
+                if (!semicolon) {
+                    *out++ = *in++;
+                    continue;
+                }
+                const std::string_view entity(in + 1, semicolon - in - 1);
+                if (entity == "amp") *out++ = '&';
+                else if (entity == "lt") *out++ = '<';
+                else if (entity == "gt") *out++ = '>';
+                else if (entity == "quot") *out++ = '"';
+                else if (entity == "apos") *out++ = '\'';
+                else if (entity.size() > 1 && entity[0] == '#') {
+                    const bool hex = entity[1] == 'x' || entity[1] == 'X';
+                    const auto digits = entity.substr(hex ? 2 : 1);
+                    uint32_t code_point = 0;
+                    auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), code_point,
+                                                     hex ? 16 : 10);
+                    if (ec != std::errc() || ptr != digits.data() + digits.size() || code_point > 0x10FFFF) {
+                        throw std::runtime_error("Invalid character reference in XML attribute");
+                    }
+                    out = append_utf8(out, code_point);
+                } else {
+                    // Unknown entity, keep it verbatim
+                    std::memmove(out, in, semicolon - in + 1);
+                    out += semicolon - in + 1;
+                }
+                in = semicolon + 1;
+            }
+            return out - value;
+        }
+
+        /**
+         * @return Whether `pos` lies inside a comment, CDATA section, processing instruction or declaration
+         * that starts in `text`. Looks for '!' and '?' rather than '<', since those are rare in OSM data.
+         */
+        bool inside_markup(std::string_view text, const size_t pos) {
+            size_t i = 0;
+            while (i < pos) {
+                const auto *bang = static_cast<const char *>(std::memchr(text.data() + i, '!', pos - i));
+                const auto *question = static_cast<const char *>(std::memchr(text.data() + i, '?', pos - i));
+                const char *found = !bang ? question : !question ? bang : std::min(bang, question);
+                if (!found) return false;
+                const size_t at = found - text.data();
+                if (at == 0 || text[at - 1] != '<') {
+                    i = at + 1;
+                    continue;
+                }
+                const auto markup = text.substr(at - 1);
+                std::string_view terminator = ">";
+                if (markup.starts_with("<!--")) terminator = "-->";
+                else if (markup.starts_with("<![CDATA[")) terminator = "]]>";
+                else if (markup[1] == '?') terminator = "?>";
+                const auto end = text.find(terminator, at + 1);
+                if (end == std::string_view::npos || end + terminator.size() > pos) return true;
+                i = end + terminator.size();
+            }
+            return false;
+        }
+    }
+
+    size_t XMLStreamReader::read_buffer(char *buffer, const size_t size, XMLStreamHandler &handler,
+                                        std::vector<XMLAttribute> &attributes) {
+        size_t pos = 0;
+        while (true) {
+            const auto *lt = static_cast<char *>(std::memchr(buffer + pos, '<', size - pos));
+            if (!lt) return size; // Only text content is left
+
+            const size_t start = lt - buffer;
+            const std::string_view rest(lt, size - start);
+            if (rest.size() < 2) return start;
+
+            // Skip comments, CDATA, processing instructions and declarations
+            std::string_view terminator;
+            if (rest.starts_with("<!--")) terminator = "-->";
+            else if (rest.starts_with("<![CDATA[")) terminator = "]]>";
+            else if (rest[1] == '?') terminator = "?>";
+            else if (rest[1] == '!') terminator = ">";
+            if (!terminator.empty()) {
+                const auto end = rest.find(terminator, 2);
+                if (end == std::string_view::npos) return start;
+                pos = start + end + terminator.size();
+                continue;
+            }
+
+            // Find the end of the tag, ignoring '>' inside attribute values
+            size_t gt = start + 1;
+            char quote = 0;
+            for (; gt < size; ++gt) {
+                if (quote) {
+                    if (buffer[gt] == quote) quote = 0;
+                } else if (buffer[gt] == '"' || buffer[gt] == '\'') {
+                    quote = buffer[gt];
+                } else if (buffer[gt] == '>') {
+                    break;
+                }
+            }
+            if (gt == size) return start;
+            pos = gt + 1;
+
+            if (rest[1] == '/') {
+                size_t name_end = start + 2;
+                while (name_end < gt && !is_space(buffer[name_end])) ++name_end;
+                handler.end_element(std::string_view(buffer + start + 2, name_end - start - 2));
+                continue;
+            }
+
+            const bool self_closing = buffer[gt - 1] == '/';
+            const size_t tag_end = self_closing ? gt - 1 : gt;
+            size_t i = start + 1;
+            while (i < tag_end && !is_space(buffer[i])) ++i;
+            const std::string_view name(buffer + start + 1, i - start - 1);
+            if (name.empty()) throw std::runtime_error("Malformed XML tag");
+
+            attributes.clear();
+            while (true) {
+                while (i < tag_end && is_space(buffer[i])) ++i;
+                if (i == tag_end) break;
+                const size_t name_start = i;
+                while (i < tag_end && buffer[i] != '=' && !is_space(buffer[i])) ++i;
+                const std::string_view attribute_name(buffer + name_start, i - name_start);
+                while (i < tag_end && is_space(buffer[i])) ++i;
+                if (i == tag_end || buffer[i] != '=') throw std::runtime_error("Malformed XML attribute");
+                ++i;
+                while (i < tag_end && is_space(buffer[i])) ++i;
+                if (i == tag_end || (buffer[i] != '"' && buffer[i] != '\'')) {
+                    throw std::runtime_error("Malformed XML attribute");
+                }
+                const char value_quote = buffer[i++];
+                const size_t value_start = i;
+                while (i < tag_end && buffer[i] != value_quote) ++i;
+                if (i == tag_end) throw std::runtime_error("Malformed XML attribute");
+                size_t value_size = i - value_start;
+                if (std::memchr(buffer + value_start, '&', value_size)) {
+                    value_size = decode_entities(buffer + value_start, value_size);
+                }
+                attributes.push_back({attribute_name, std::string_view(buffer + value_start, value_size)});
+                ++i;
+            }
+
+            handler.start_element(name, attributes);
+            if (self_closing) handler.end_element(name);
+        }
+    }
+
+    void XMLStreamReader::read(XMLStreamHandler &handler) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Error opening XML file " + file);
+        }
+
+        std::vector<char> buffer(std::max<size_t>(chunk_size, 16));
+        std::vector<XMLAttribute> attributes;
+        size_t filled = 0;
+        while (true) {
+            // A single tag larger than the buffer: grow until it fits
+            if (filled == buffer.size()) buffer.resize(buffer.size() * 2);
+
+            in.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+            const auto count = static_cast<size_t>(in.gcount());
+            filled += count;
+
+            const size_t consumed = read_buffer(buffer.data(), filled, handler, attributes);
+            std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+            filled -= consumed;
+
+            if (count == 0) {
+                for (size_t i = 0; i < filled; ++i) {
+                    if (!is_space(buffer[i])) throw std::runtime_error("Unexpected end of XML file");
+                }
+                break;
+            }
+        }
+    }
+
+    XMLChunkReader::XMLChunkReader(const std::string &file, std::vector<std::string> split_elements,
+                                   const size_t chunk_size):
+        in(file, std::ios::binary),
+        split_elements(std::move(split_elements)),
+        chunk_size(std::max<size_t>(chunk_size, 16)) {
+        if (!in) {
+            throw std::runtime_error("Error opening XML file " + file);
+        }
+    }
+
+    bool XMLChunkReader::next(std::string &chunk) {
+        chunk.swap(rest);
+        rest.clear();
+        while (true) {
+            const size_t filled = chunk.size();
+            chunk.resize(filled + chunk_size);
+            in.read(chunk.data() + filled, static_cast<std::streamsize>(chunk_size));
+            chunk.resize(filled + static_cast<size_t>(in.gcount()));
+            if (chunk.size() == filled) return !chunk.empty();
+
+            if (const auto split = find_split(chunk); split != std::string::npos) {
+                rest.assign(chunk, split);
+                chunk.resize(split);
+                return true;
+            }
+        }
+    }
+
+    size_t XMLChunkReader::find_split(std::string_view text) const {
+        // The last candidate is usually close to the end; a split at 0 would give an empty piece
+        for (auto lt = text.rfind('<'); lt != std::string_view::npos && lt > 0; lt = text.rfind('<', lt - 1)) {
+            const auto tag = text.substr(lt + 1);
+            const bool is_split = std::ranges::any_of(split_elements, [&](const std::string &name) {
+                return tag.size() > name.size() && tag.starts_with(name) &&
+                       (is_space(tag[name.size()]) || tag[name.size()] == '>' || tag[name.size()] == '/');
+            });
+            if (is_split && !inside_markup(text, lt)) return lt;
+        }
+        return std::string_view::npos;
+    }
+}
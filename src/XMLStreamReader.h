@@ -0,0 +1,82 @@
+#ifndef XMLSTREAMREADER_H
+#define XMLSTREAMREADER_H
+#include <cstddef>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Foliage::DataProvider::OSM {
+    struct XMLAttribute {
+        std::string_view name;
+        std::string_view value; // Entities are already decoded
+    };
+
+    /**
+     * Receives the elements of an XML stream in document order.
+     * The views passed in are only valid for the duration of the call.
+     */
+    class XMLStreamHandler {
+    public:
+        virtual ~XMLStreamHandler() = default;
+        virtual void start_element(std::string_view name, std::span<const XMLAttribute> attributes) = 0;
+        virtual void end_element(std::string_view name) = 0;
+    };
+
+    /**
+     * Single-pass, SAX-style XML tokenizer. The file is read in fixed-size chunks,
+     * so memory use is bounded by the chunk size (or the largest single tag) rather
+     * than the size of the file. Text content, comments, processing instructions
+     * and DOCTYPE/CDATA sections are skipped since OSM XML keeps everything in attributes.
+     */
+    class XMLStreamReader {
+    public:
+        static constexpr size_t default_chunk_size = 1 << 22;
+
+        explicit XMLStreamReader(std::string file, size_t chunk_size = default_chunk_size):
+            file(std::move(file)),
+            chunk_size(chunk_size) {}
+
+        void read(XMLStreamHandler &handler);
+
+        /**
+         * Tokenizes the complete tags at the front of `buffer`.
+         * @return The number of bytes consumed; a trailing incomplete tag is left untouched
+         */
+        static size_t read_buffer(char *buffer, size_t size, XMLStreamHandler &handler,
+                                  std::vector<XMLAttribute> &attributes);
+
+    private:
+        std::string file;
+        size_t chunk_size;
+    };
+
+    /**
+     * Cuts an XML file into pieces that can be tokenized independently, so that the pieces can go to
+     * different threads. Every piece but the first starts with the start tag of one of `split_elements`,
+     * found outside of comments, CDATA sections and processing instructions. For OSM files those are
+     * the top level elements, so a piece never ends in the middle of a node or way.
+     */
+    class XMLChunkReader {
+    public:
+        XMLChunkReader(const std::string &file, std::vector<std::string> split_elements,
+                       size_t chunk_size = XMLStreamReader::default_chunk_size);
+
+        /**
+         * Reads the next piece, which is about `chunk_size` bytes unless a single element is larger.
+         * @return false once the whole file has been returned
+         */
+        bool next(std::string &chunk);
+
+    private:
+        [[nodiscard]] size_t find_split(std::string_view text) const;
+
+        std::ifstream in;
+        std::vector<std::string> split_elements;
+        size_t chunk_size;
+        std::string rest; // Read already, belongs to the next piece
+    };
+}
+
+#endif //XMLSTREAMREADER_H
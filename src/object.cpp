@@ -18,34 +18,4 @@ namespace Foliage::ObjectType {
         }
         return Geometry::BoundingBox({minlat, minlon}, {maxlat, maxlon});
     }
-
-    void Node::compute_neighbors() {
-        for (const auto& way : ways) {
-            // Ensure way has more than one node
-            if (way->nodes.size() < 2) continue;
-
-            // Iterate through the nodes in the way to find adjacent nodes
-            for (size_t i = 0; i < way->nodes.size() - 1; ++i) {
-                auto current_node = way->nodes[i];
-                auto next_node = way->nodes[i + 1];
-
-                // Check if current node is this node or if next node is a neighbor
-                if (current_node.get() == this || next_node.get() == this) {
-                    auto neighbor = (current_node.get() == this) ? next_node : current_node;
-                    if (next_node.get() == this) {
-                        // this is negative direction
-                        neighbors[neighbor].is_positive_direction = false;
-                    } else {
-                        neighbors[neighbor].is_positive_direction = true;
-                    }
-                    // Calculate the distance between the nodes
-                    double distance = compute_distance(this->position, neighbor->position);
-
-                    // Store the distance and the way's tags in the neighbors map
-                    neighbors[neighbor].distance = distance;
-                    neighbors[neighbor].tags = way->tags;
-                }
-            }
-        }
-    }
 }
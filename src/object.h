@@ -17,11 +17,6 @@
 
 namespace Foliage::ObjectType {
     struct Node;
-    struct NeighborInfo {
-        double distance;  // Distance to the neighboring node
-        bool is_positive_direction;
-        std::unordered_map<std::string, std::string> tags;  // Tags of the way that led to this neighbor
-    };
     struct Object {
         std::unordered_map<std::string, std::string> tags;
         int importance_level = 0;
@@ -48,14 +43,12 @@ namespace Foliage::ObjectType {
     struct Node : Object, std::enable_shared_from_this<Node> {
         Geometry::Position position{};
         std::unordered_set<std::shared_ptr<const Way> > ways; // back reference to ways
-        std::unordered_map<std::shared_ptr<const Node>, NeighborInfo> neighbors;
 
         explicit Node(int64_t id = -1): Object(id) {
             ways.clear();
             importance_level = 0;
         }
 
-        void compute_neighbors();
         Node(const Node &nd) = default;
     };
 
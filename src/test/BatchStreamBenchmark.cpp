@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "../BatchStream.h"
+#include "../ContractionHierarchyPathfinder.h"
+#include "../WorkerPool.h"
+#include "TestGrid.h"
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+
+using namespace Foliage;
+
+// A batch of routes on a grid, one worker task per query as /api/batch runs them, on one worker and on all cores
+TEST(BatchStreamBenchmark, RoutingThroughput) {
+    const int side = 80, queries = 2000;
+    std::mt19937 random(5);
+    auto astar = std::make_shared<Pathfinder::LayeredAStarPathfinder>(
+        std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(
+            Fixtures::grid(side, random, {"primary", "secondary", "residential", "tertiary"}, 0))));
+    astar->segments = std::make_shared<const Graph::SegmentIndex>(Graph::SegmentIndex::build(*astar->graph));
+    Pathfinder::ContractionHierarchyPathfinder ch(astar);
+    ch.build({{{"profile", "car"}}});
+
+    std::vector<std::pair<Geometry::Position, Geometry::Position>> pairs;
+    auto random_position = [&] {
+        return Geometry::Position(31 + (random() % 79000) * 1e-6, 121 + (random() % 79000) * 1e-6);
+    };
+    for (int i = 0; i < queries; ++i) pairs.emplace_back(random_position(), random_position());
+
+    for (const size_t threads: std::set<size_t>{1, std::max(1u, std::thread::hardware_concurrency())}) {
+        Util::BatchStream stream(pairs.size());
+        {
+            Util::WorkerPool pool(threads);
+            for (const auto &[start, goal]: pairs) {
+                pool.submit(Util::WorkerPool::Lane::Query, [&, start, goal] {
+                    const auto path = ch.get_path(start, goal, {{"profile", "car"}});
+                    stream.push(std::to_string(path.size()), path.empty());
+                });
+            }
+            std::string line;
+            while (stream.next(line)) {
+            }
+        }
+        const auto summary = stream.summary();
+        std::cerr << "Batch of " << summary.queries << " routes on " << threads << " workers: "
+                << summary.queries / summary.seconds << " queries/s" << std::endl;
+        ASSERT_EQ(0u, summary.failed);
+    }
+}
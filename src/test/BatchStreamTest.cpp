@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+#include "../BatchStream.h"
+#include <chrono>
+#include <set>
+#include <thread>
+
+using namespace Foliage;
+
+TEST(BatchStream, HandsOutLinesAsTheyArePushed) {
+    Util::BatchStream stream(3);
+    std::string line;
+    stream.push("a");
+    ASSERT_TRUE(stream.next(line));
+    ASSERT_EQ("a", line);
+
+    std::thread worker([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        stream.push("b", true);
+        stream.push("c");
+    });
+    std::set<std::string> rest;
+    while (stream.next(line)) rest.insert(line);
+    worker.join();
+    ASSERT_EQ((std::set<std::string>{"b", "c"}), rest);
+    ASSERT_THROW(stream.push("d"), std::logic_error);
+    const auto summary = stream.summary();
+    ASSERT_EQ(3u, summary.queries);
+    ASSERT_EQ(1u, summary.failed);
+    ASSERT_GT(summary.seconds, 0);
+
+    Util::BatchStream empty(0);
+    ASSERT_FALSE(empty.next(line));
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include "../ConnectedComponents.h"
+#include "../ContractionHierarchyPathfinder.h"
+#include "TestGrid.h"
+#include <random>
+
+using namespace Foliage;
+
+namespace {
+    std::shared_ptr<ObjectType::Way> make_way(std::vector<std::shared_ptr<ObjectType::Way>> &ways,
+                                              std::vector<std::shared_ptr<const ObjectType::Node>> path,
+                                              const std::string &highway, bool oneway = false) {
+        auto way = std::make_shared<ObjectType::Way>(static_cast<int64_t>(ways.size()));
+        way->nodes = std::move(path);
+        way->tags = {{"highway", highway}};
+        if (oneway) way->tags["oneway"] = "yes";
+        ways.push_back(way);
+        return way;
+    }
+}
+
+// A block of four nodes, a oneway out of it into a dead end at 5, and the island 6 - 7 two kilometres away
+class ConnectedComponentsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const double positions[][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}, {2, 1}, {20, 20}, {20, 21}};
+        for (int64_t id = 1; id <= 7; ++id) {
+            auto node = std::make_shared<ObjectType::Node>(id);
+            node->position = Geometry::Position(31 + positions[id - 1][0] * 0.001, 121 + positions[id - 1][1] * 0.001);
+            nodes.push_back(node);
+        }
+        make_way(ways, {nodes[0], nodes[1], nodes[2], nodes[3], nodes[0]}, "residential");
+        make_way(ways, {nodes[2], nodes[4]}, "residential", true);
+        make_way(ways, {nodes[5], nodes[6]}, "residential");
+        graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(ways));
+    }
+
+    [[nodiscard]] Graph::NodeIndex at(int64_t id) const { return graph->index_of(id); }
+
+    std::vector<std::shared_ptr<ObjectType::Node>> nodes;
+    std::vector<std::shared_ptr<ObjectType::Way>> ways;
+    std::shared_ptr<const Graph::RoutingGraph> graph;
+};
+
+TEST_F(ConnectedComponentsTest, SplitsAtOnewaysAndIslands) {
+    const Graph::ProfileWeights car(Graph::RoutingProfile::car(), *graph);
+    const auto &components = car.components;
+    ASSERT_EQ(3u, components.size());
+    ASSERT_EQ(4u, components.sizes[components.largest]);
+    for (const int64_t id: {1, 2, 3, 4}) ASSERT_TRUE(components.in_largest(at(id)));
+    ASSERT_FALSE(components.in_largest(at(5)));
+    ASSERT_EQ(components.component[at(6)], components.component[at(7)]);
+
+    ASSERT_TRUE(components.may_reach(at(1), at(5)));
+    ASSERT_FALSE(components.may_reach(at(5), at(1))) << "Nothing leaves the dead end";
+    ASSERT_FALSE(components.may_reach(at(1), at(6)));
+    ASSERT_FALSE(components.may_reach(at(6), at(5)));
+    ASSERT_TRUE(components.may_reach(at(7), at(6)));
+
+    // On foot the oneway is a street like any other
+    const Graph::ProfileWeights foot(Graph::RoutingProfile::foot(), *graph);
+    ASSERT_EQ(2u, foot.components.size());
+    ASSERT_TRUE(foot.components.may_reach(at(5), at(1)));
+}
+
+TEST_F(ConnectedComponentsTest, RejectsQueriesWithoutASearchAndPrefersTheLargestComponent) {
+    auto astar = std::make_shared<Pathfinder::LayeredAStarPathfinder>(graph);
+    Pathfinder::ContractionHierarchyPathfinder ch(astar);
+    ch.build({{{"profile", "car"}}});
+    const auto car = astar->profiles->get({});
+
+    try {
+        (void) astar->get_path(nodes[5]->position, nodes[0]->position, {});
+        FAIL() << "Expected Unreachable";
+    } catch (const Pathfinder::Unreachable &e) {
+        ASSERT_EQ(car->components.component[at(6)], e.start_component);
+        ASSERT_EQ(car->components.largest, e.goal_component);
+    }
+    ASSERT_EQ(0u, astar->totals().searches);
+    ASSERT_THROW((void) ch.get_path(nodes[0]->position, nodes[6]->position, {}), Pathfinder::Unreachable);
+
+    // The dead end cannot be left, so the route starts at the closest node it can leave from, and says so
+    bool relocated = false;
+    const auto path = astar->get_path(nodes[4]->position, nodes[0]->position, {}, &relocated);
+    ASSERT_FALSE(path.empty());
+    ASSERT_EQ(3, path.front()->id);
+    ASSERT_EQ(1, path.back()->id);
+    ASSERT_TRUE(relocated);
+    ASSERT_EQ(5, astar->get_path(nodes[0]->position, nodes[4]->position, {}, &relocated).back()->id);
+    ASSERT_FALSE(relocated);
+    ASSERT_EQ(5, ch.get_path(nodes[0]->position, nodes[4]->position, {}, &relocated).back()->id);
+    ASSERT_FALSE(relocated);
+    ASSERT_EQ(7, ch.get_path(nodes[5]->position, nodes[6]->position, {}, &relocated).back()->id);
+    ASSERT_FALSE(relocated);
+    ASSERT_EQ(3, ch.get_path(nodes[4]->position, nodes[0]->position, {}, &relocated).front()->id);
+    ASSERT_TRUE(relocated);
+}
+
+// Components against a plain search from every source, on a grid where oneways and footways cut some nodes off
+TEST(ConnectedComponents, NeverRejectsAReachableNode) {
+    const int side = 30;
+    std::mt19937 random(5);
+    const auto graph = Graph::RoutingGraph::build(Fixtures::grid(
+        side, random, {"residential", "residential", "residential", "residential", "footway"}, 0, 1.0 / 3));
+    const Graph::ProfileWeights car(Graph::RoutingProfile::car(), graph);
+    const auto &components = car.components;
+
+    size_t rejected = 0;
+    for (Graph::NodeIndex source = 0; source < graph.node_count(); source += 7) {
+        std::vector<bool> reached(graph.node_count(), false);
+        std::vector<Graph::NodeIndex> queue = {source};
+        reached[source] = true;
+        while (!queue.empty()) {
+            const auto node = queue.back();
+            queue.pop_back();
+            for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                if (std::isinf(car[edge]) || reached[graph.edge_targets[edge]]) continue;
+                reached[graph.edge_targets[edge]] = true;
+                queue.push_back(graph.edge_targets[edge]);
+            }
+        }
+        for (Graph::NodeIndex target = 0; target < graph.node_count(); ++target) {
+            const bool may_reach = components.may_reach(source, target);
+            if (!may_reach) ++rejected;
+            ASSERT_TRUE(may_reach || !reached[target]) << source << " -> " << target;
+            if (components.component[source] == components.component[target] || components.in_largest(source) ||
+                components.in_largest(target)) {
+                ASSERT_EQ(reached[target], may_reach) << source << " -> " << target;
+            }
+        }
+    }
+    ASSERT_GT(rejected, 0u);
+}
@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include "../ContractionHierarchy.h"
+#include "TestGrid.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace Foliage;
+
+// A 1000 x 1000 table on a larger grid, against the same number of one-to-one queries extrapolated from a sample
+TEST(ContractionHierarchyBenchmark, DistanceTable) {
+    const int side = 100, points = 1000, sampled = 2000;
+    std::mt19937 random(13);
+    const auto graph = Graph::RoutingGraph::build(
+        Fixtures::grid(side, random, {"primary", "secondary", "residential", "tertiary"}, 0));
+    const Graph::ProfileWeights weights(Graph::RoutingProfile::car(), graph);
+    const auto hierarchy = Graph::ContractionHierarchy::build(graph, weights);
+
+    std::vector<std::vector<Graph::Endpoint>> sources(points), targets(points);
+    for (auto &endpoints: sources) endpoints = {{static_cast<Graph::NodeIndex>(random() % graph.node_count()), 0}};
+    for (auto &endpoints: targets) endpoints = {{static_cast<Graph::NodeIndex>(random() % graph.node_count()), 0}};
+
+    auto st = std::chrono::steady_clock::now();
+    const auto costs = hierarchy.distance_table(sources, targets);
+    const double table_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+    st = std::chrono::steady_clock::now();
+    for (int i = 0; i < sampled; ++i) {
+        const auto s = random() % points, t = random() % points;
+        float distance;
+        (void) hierarchy.shortest_path(sources[s], targets[t], &distance);
+        ASSERT_NEAR(distance, costs[s * points + t], distance * 1e-4);
+    }
+    const double pair_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count() / sampled;
+    std::cerr << "Distance table " << points << " x " << points << ": " << table_seconds << " s, one-to-one queries: "
+            << pair_seconds * points * points << " s" << std::endl;
+}
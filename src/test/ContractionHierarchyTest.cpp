@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "../ContractionHierarchy.h"
+#include "../ContractionHierarchyPathfinder.h"
+#include "TestGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace Foliage;
+
+// Grid of side x side nodes with a mix of road classes and some oneway streets
+class ContractionHierarchyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 random(7);
+        graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(
+            Fixtures::grid(side, random, {"primary", "secondary", "residential", "footway"}, 0, 0.2)));
+        weights = std::make_shared<const Graph::ProfileWeights>(Graph::RoutingProfile::car(), *graph);
+    }
+
+    float reference_distance(Graph::NodeIndex source, Graph::NodeIndex target) const {
+        return static_cast<float>(Fixtures::distances(*graph, *weights, source, target)[target]);
+    }
+
+    // Sum of the cheapest edge weight between consecutive path nodes, infinity if two of them are not adjacent
+    float path_weight(const std::vector<Graph::NodeIndex> &path) const {
+        float total = 0;
+        for (size_t i = 0; i + 1 < path.size(); ++i) {
+            float cheapest = std::numeric_limits<float>::infinity();
+            for (auto edge = graph->edges_begin(path[i]); edge < graph->edges_end(path[i]); ++edge) {
+                if (graph->edge_targets[edge] == path[i + 1]) cheapest = std::min(cheapest, (*weights)[edge]);
+            }
+            total += cheapest;
+        }
+        return total;
+    }
+
+    const int side = 40;
+    std::shared_ptr<const Graph::RoutingGraph> graph;
+    std::shared_ptr<const Graph::ProfileWeights> weights;
+};
+
+TEST_F(ContractionHierarchyTest, MatchesDijkstra) {
+    const auto hierarchy = Graph::ContractionHierarchy::build(*graph, *weights);
+    ASSERT_EQ(hierarchy.node_count(), graph->node_count());
+    for (Graph::NodeIndex u = 0; u < graph->node_count(); ++u) {
+        for (auto e = hierarchy.up_offsets[u]; e < hierarchy.up_offsets[u + 1]; ++e) {
+            ASSERT_GT(hierarchy.rank[hierarchy.up_arcs[e].target], hierarchy.rank[u]);
+        }
+    }
+
+    std::mt19937 random(11);
+    for (int query = 0; query < 200; ++query) {
+        const auto source = static_cast<Graph::NodeIndex>(random() % graph->node_count());
+        const auto target = static_cast<Graph::NodeIndex>(random() % graph->node_count());
+        float distance;
+        const auto path = hierarchy.shortest_path(source, target, &distance);
+        const float expected = reference_distance(source, target);
+        if (std::isinf(expected)) {
+            ASSERT_TRUE(path.empty());
+            continue;
+        }
+        ASSERT_FALSE(path.empty()) << source << " -> " << target;
+        ASSERT_EQ(path.front(), source);
+        ASSERT_EQ(path.back(), target);
+        ASSERT_NEAR(distance, expected, expected * 1e-4);
+        ASSERT_NEAR(path_weight(path), expected, expected * 1e-4) << "Shortcuts unpacked into a different path";
+    }
+}
+
+TEST_F(ContractionHierarchyTest, SameNode) {
+    const auto hierarchy = Graph::ContractionHierarchy::build(*graph, *weights);
+    float distance;
+    ASSERT_EQ(hierarchy.shortest_path(5, 5, &distance), std::vector<Graph::NodeIndex>{5});
+    ASSERT_EQ(distance, 0);
+}
+
+TEST_F(ContractionHierarchyTest, SeveralEndpoints) {
+    const auto hierarchy = Graph::ContractionHierarchy::build(*graph, *weights);
+    std::mt19937 random(23);
+    for (int query = 0; query < 50; ++query) {
+        std::vector<Graph::Endpoint> sources, targets;
+        for (int i = 0; i < 2; ++i) {
+            sources.push_back({static_cast<Graph::NodeIndex>(random() % graph->node_count()), (random() % 100) * 0.5f});
+            targets.push_back({static_cast<Graph::NodeIndex>(random() % graph->node_count()), (random() % 100) * 0.5f});
+        }
+        float expected = std::numeric_limits<float>::infinity();
+        for (const auto &source: sources) {
+            for (const auto &target: targets) {
+                expected = std::min(expected, source.cost + reference_distance(source.node, target.node) + target.cost);
+            }
+        }
+        float distance;
+        const auto path = hierarchy.shortest_path(sources, targets, &distance);
+        if (std::isinf(expected)) {
+            ASSERT_TRUE(path.empty());
+            continue;
+        }
+        ASSERT_NEAR(distance, expected, expected * 1e-4);
+        const auto source = std::ranges::find(sources, path.front(), &Graph::Endpoint::node);
+        const auto target = std::ranges::find(targets, path.back(), &Graph::Endpoint::node);
+        ASSERT_NE(source, sources.end());
+        ASSERT_NE(target, targets.end());
+        ASSERT_NEAR(source->cost + path_weight(path) + target->cost, expected, expected * 1e-4);
+    }
+}
+
+TEST_F(ContractionHierarchyTest, DistanceTableMatchesDijkstra) {
+    const auto hierarchy = Graph::ContractionHierarchy::build(*graph, *weights);
+    std::mt19937 random(31);
+    std::vector<std::vector<Graph::Endpoint>> sources(30), targets(20);
+    for (auto &endpoints: sources) endpoints = {{static_cast<Graph::NodeIndex>(random() % graph->node_count()), 0}};
+    for (auto &endpoints: targets) endpoints = {{static_cast<Graph::NodeIndex>(random() % graph->node_count()), 0}};
+    targets.back().clear(); // A point off the network
+
+    const auto costs = hierarchy.distance_table(sources, targets);
+    ASSERT_EQ(sources.size() * targets.size(), costs.size());
+    for (size_t s = 0; s < sources.size(); ++s) {
+        for (size_t t = 0; t + 1 < targets.size(); ++t) {
+            const float expected = reference_distance(sources[s][0].node, targets[t][0].node);
+            const float cost = costs[s * targets.size() + t];
+            if (std::isinf(expected)) {
+                ASSERT_TRUE(std::isinf(cost));
+            } else {
+                ASSERT_NEAR(cost, expected, expected * 1e-4) << sources[s][0].node << " -> " << targets[t][0].node;
+            }
+        }
+        ASSERT_TRUE(std::isinf(costs[s * targets.size() + targets.size() - 1]));
+    }
+}
+
+// Each side is bounded on its own, so a single source cannot bring a table of millions of targets
+TEST(ContractionHierarchyPathfinder, RejectsOversizedTables) {
+    constexpr size_t max_points = Pathfinder::ContractionHierarchyPathfinder::max_table_points;
+    ASSERT_NO_THROW(Pathfinder::ContractionHierarchyPathfinder::require_table_size(max_points, max_points));
+    ASSERT_THROW(Pathfinder::ContractionHierarchyPathfinder::require_table_size(1, max_points + 1),
+                 std::invalid_argument);
+    ASSERT_THROW(Pathfinder::ContractionHierarchyPathfinder::require_table_size(max_points + 1, 1),
+                 std::invalid_argument);
+
+    // Checked before anything is snapped or allocated
+    Pathfinder::ContractionHierarchyPathfinder pathfinder;
+    const std::vector<Geometry::Position> one(1, Geometry::Position(31, 121)), many(max_points + 1, one.front());
+    ASSERT_THROW((void) pathfinder.table(one, many, {}), std::invalid_argument);
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "../Generation.h"
+#include <thread>
+
+using namespace Foliage;
+
+TEST(GenerationSlot, PinnedGenerationOutlivesItsReplacement) {
+    Pathfinder::GenerationSlot slot;
+    ASSERT_EQ(0u, slot.pin()->number); // Nothing loaded yet
+    ASSERT_THROW((void) slot.pin()->snapshot(), std::runtime_error);
+
+    ASSERT_EQ(1u, slot.publish(std::make_shared<Pathfinder::Generation>()));
+    auto pinned = slot.pin();
+    std::weak_ptr<const Pathfinder::Generation> first = pinned;
+    ASSERT_EQ(2u, slot.publish(std::make_shared<Pathfinder::Generation>()));
+    ASSERT_EQ(2u, slot.pin()->number);
+    // The reader still holds the first generation, which goes away with it
+    ASSERT_EQ(1u, pinned->number);
+    ASSERT_FALSE(first.expired());
+    pinned.reset();
+    ASSERT_TRUE(first.expired());
+}
+
+TEST(GenerationSlot, ReadersNeverSeeGenerationsGoBack) {
+    Pathfinder::GenerationSlot slot;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    std::atomic<int> regressions{0};
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&] {
+            uint64_t last = 0;
+            while (!done) {
+                const auto generation = slot.pin();
+                if (generation->number < last) ++regressions;
+                last = generation->number;
+            }
+        });
+    }
+    for (int i = 0; i < 2000; ++i) slot.publish(std::make_shared<Pathfinder::Generation>());
+    done = true;
+    for (auto &reader: readers) reader.join();
+    ASSERT_EQ(0, regressions.load());
+    ASSERT_EQ(2000u, slot.pin()->number);
+}
+
+// Each thread remembers what it pinned last, per slot, and notices every publish
+TEST(GenerationSlot, CachedPinsFollowEverySlot) {
+    Pathfinder::GenerationSlot a, b;
+    a.publish(std::make_shared<Pathfinder::Generation>());
+    ASSERT_EQ(a.pin(), a.pin());
+    ASSERT_EQ(1u, a.pin()->number);
+    ASSERT_EQ(0u, b.pin()->number);
+    ASSERT_NE(a.pin(), b.pin());
+    b.publish(std::make_shared<Pathfinder::Generation>());
+    b.publish(std::make_shared<Pathfinder::Generation>());
+    ASSERT_EQ(2u, b.pin()->number);
+    ASSERT_EQ(1u, a.pin()->number);
+}
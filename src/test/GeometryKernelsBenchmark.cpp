@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include "../GeometryKernels.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace Foliage;
+using namespace Foliage::Geometry;
+
+// Runs every kernel over the same arrays with each instruction set, in leaf-sized batches as the indexes do
+TEST(GeometryKernelsBenchmark, ScalarAndAVX2) {
+    const int points = 1 << 16, rounds = 200, batch = 64;
+    std::mt19937 random(11);
+    std::vector<int32_t> latitudes, longitudes;
+    std::vector<FixedBox> boxes;
+    for (int i = 0; i < points; ++i) {
+        latitudes.push_back(310000000 + static_cast<int32_t>(random() % 1000000));
+        longitudes.push_back(1210000000 + static_cast<int32_t>(random() % 1000000));
+        boxes.push_back({latitudes.back(), longitudes.back(), latitudes.back() + static_cast<int32_t>(random() % 5000),
+                         longitudes.back() + static_cast<int32_t>(random() % 5000)});
+    }
+    const auto projection = LocalProjection::around(310000000, 311000000, 1210000000, 1211000000);
+    const Kernels::Probe probe(projection, Position(31.05, 121.05));
+    const FixedBox box{310400000, 1210400000, 310600000, 1210600000};
+
+    auto seconds = [](auto from, auto to) { return std::chrono::duration<double>(to - from).count(); };
+    auto run = [&](Kernels::Isa isa, const char *name) {
+        Kernels::use_isa(isa);
+        std::vector<double> distances(points), box_distances(points);
+        std::vector<uint32_t> selected(batch);
+        double checksum = 0;
+        auto st = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            for (int i = 0; i < points; i += batch) {
+                Kernels::distances(probe, std::span(latitudes).subspan(i, batch), std::span(longitudes).subspan(i, batch),
+                                   std::span(distances).subspan(i, batch));
+            }
+        }
+        auto distanced = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            for (int i = 0; i < points; i += batch) {
+                Kernels::box_distances(probe, std::span(boxes).subspan(i, batch), std::span(box_distances).subspan(i, batch));
+            }
+        }
+        auto boxed = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            for (int i = 0; i < points; i += batch) {
+                checksum += Kernels::select_in_box(box, std::span(latitudes).subspan(i, batch),
+                                                   std::span(longitudes).subspan(i, batch), selected.data());
+            }
+        }
+        auto ed = std::chrono::steady_clock::now();
+        const double total = static_cast<double>(points) * rounds / 1e6;
+        std::cerr << name << ": distances " << total / seconds(st, distanced) << " M points/s, box distances "
+                << total / seconds(distanced, boxed) << " M boxes/s, select " << total / seconds(boxed, ed)
+                << " M points/s" << std::endl;
+        for (int i = 0; i < points; ++i) checksum += distances[i] + box_distances[i];
+        return checksum;
+    };
+
+    const double scalar = run(Kernels::Isa::Scalar, "Scalar");
+    if (Kernels::supported_isa() == Kernels::Isa::AVX2) {
+        ASSERT_EQ(scalar, run(Kernels::Isa::AVX2, "AVX2"));
+    }
+    Kernels::use_isa(Kernels::supported_isa());
+
+    std::vector<double> haversine(points);
+    auto st = std::chrono::steady_clock::now();
+    Kernels::haversine_distances(Position(31.05, 121.05), latitudes, longitudes, haversine);
+    auto ed = std::chrono::steady_clock::now();
+    std::cerr << "Haversine: " << points / seconds(st, ed) / 1e6 << " M points/s" << std::endl;
+}
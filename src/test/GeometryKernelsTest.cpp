@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include "../GeometryKernels.h"
+#include <random>
+
+using namespace Foliage;
+using namespace Foliage::Geometry;
+
+// Random fixed-point coordinates around Shanghai, and boxes over them, some of them degenerate
+class GeometryKernelsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 random(5);
+        for (int i = 0; i < count; ++i) {
+            latitudes.push_back(310000000 + static_cast<int32_t>(random() % 1000000));
+            longitudes.push_back(1210000000 + static_cast<int32_t>(random() % 1000000));
+        }
+        for (int i = 0; i < count; ++i) {
+            const int32_t latitude = latitudes[i], longitude = longitudes[(i * 7) % count];
+            const auto height = static_cast<int32_t>(i % 5 == 0 ? 0 : random() % 50000);
+            const auto width = static_cast<int32_t>(i % 7 == 0 ? 0 : random() % 50000);
+            boxes.push_back({latitude, longitude, latitude + height, longitude + width});
+        }
+        projection = LocalProjection::around(310000000, 311000000, 1210000000, 1211000000);
+    }
+
+    void TearDown() override {
+        Kernels::use_isa(Kernels::supported_isa());
+    }
+
+    // Runs `kernel` with every instruction set and checks they give the same results
+    template<class Kernel>
+    void expect_same_on_every_isa(Kernel &&kernel) {
+        if (Kernels::supported_isa() == Kernels::Isa::Scalar) GTEST_SKIP() << "No AVX2 on this CPU";
+        Kernels::use_isa(Kernels::Isa::Scalar);
+        const auto scalar = kernel();
+        Kernels::use_isa(Kernels::Isa::AVX2);
+        EXPECT_EQ(scalar, kernel());
+    }
+
+    static constexpr int count = 1003; // Not a multiple of the vector width, to cover the tails
+    std::vector<int32_t> latitudes, longitudes;
+    std::vector<FixedBox> boxes;
+    LocalProjection projection;
+};
+
+TEST_F(GeometryKernelsTest, DistancesMatchProjection) {
+    const Position position(31.05, 121.05);
+    const Kernels::Probe probe(projection, position);
+    std::vector<double> result(count);
+    Kernels::distances(probe, latitudes, longitudes, result);
+    for (int i = 0; i < count; ++i) {
+        ASSERT_NEAR(projection.distance(position, {from_fixed(latitudes[i]), from_fixed(longitudes[i])}), result[i], 1e-6);
+    }
+}
+
+TEST_F(GeometryKernelsTest, BoxDistances) {
+    const Position position(31.05, 121.05);
+    const Kernels::Probe probe(projection, position);
+    std::vector<double> result(count);
+    Kernels::box_distances(probe, boxes, result);
+    for (int i = 0; i < count; ++i) {
+        const auto &box = boxes[i];
+        // The distance to the box is the distance to its closest point
+        const int32_t latitude = std::clamp(to_fixed(position.latitude), box.min_latitude, box.max_latitude);
+        const int32_t longitude = std::clamp(to_fixed(position.longitude), box.min_longitude, box.max_longitude);
+        const Position closest(from_fixed(latitude), from_fixed(longitude));
+        ASSERT_NEAR(projection.distance(position, closest), result[i], 1e-2);
+        if (box.contains(to_fixed(position.latitude), to_fixed(position.longitude))) {
+            ASSERT_EQ(0, result[i]);
+        }
+    }
+}
+
+TEST_F(GeometryKernelsTest, SelectInBoxMatchesBoundingBox) {
+    std::vector<uint32_t> selected(count);
+    for (int i = 0; i < 50; ++i) {
+        const BoundingBox box({from_fixed(latitudes[i]), from_fixed(longitudes[i])}, 0.02);
+        const size_t found = Kernels::select_in_box(FixedBox::enclosed_by(box), latitudes, longitudes, selected.data());
+        std::vector<uint32_t> expected;
+        for (uint32_t j = 0; j < count; ++j) {
+            if (box.contains({from_fixed(latitudes[j]), from_fixed(longitudes[j])})) expected.push_back(j);
+        }
+        ASSERT_EQ(expected, std::vector(selected.begin(), selected.begin() + static_cast<std::ptrdiff_t>(found)));
+    }
+}
+
+TEST_F(GeometryKernelsTest, SameResultsOnEveryIsa) {
+    const Kernels::Probe probe(projection, Position(31.03, 121.07));
+    expect_same_on_every_isa([&] {
+        std::vector<double> result(count);
+        Kernels::distances(probe, latitudes, longitudes, result);
+        return result;
+    });
+    expect_same_on_every_isa([&] {
+        std::vector<double> result(count);
+        Kernels::box_distances(probe, boxes, result);
+        return result;
+    });
+    expect_same_on_every_isa([&] {
+        std::vector<uint32_t> selected(count);
+        selected.resize(Kernels::select_in_box(boxes[3], latitudes, longitudes, selected.data()));
+        return selected;
+    });
+}
+
+TEST(GeometryKernels, Haversine) {
+    const std::vector<int32_t> latitudes = {320000000, 310000000, -310000000};
+    const std::vector<int32_t> longitudes = {1210000000, 1220000000, -590000000};
+    std::vector<double> result(3);
+    Kernels::haversine_distances({31, 121}, latitudes, longitudes, result);
+    ASSERT_NEAR(111195, result[0], 1); // One degree of latitude
+    ASSERT_NEAR(111195 * std::cos(31 * std::numbers::pi / 180), result[1], 100);
+    ASSERT_NEAR(std::numbers::pi * LocalProjection::earth_radius, result[2], 1); // Antipodes
+}
+
+TEST(GeometryKernels, EnclosedBoxMatchesContains) {
+    std::mt19937 random(9);
+    for (int i = 0; i < 1000; ++i) {
+        const double latitude = 31 + (random() % 1000000) * 1.3e-7, longitude = 121 + (random() % 1000000) * 1.3e-7;
+        const BoundingBox box({latitude, longitude}, {latitude + 1e-6, longitude + 1e-6});
+        const auto fixed = FixedBox::enclosed_by(box);
+        for (int32_t d = -3; d <= 13; ++d) {
+            const int32_t lat = to_fixed(latitude) + d, lon = to_fixed(longitude) + d;
+            ASSERT_EQ(box.contains({from_fixed(lat), from_fixed(lon)}), fixed.contains(lat, lon));
+        }
+    }
+}
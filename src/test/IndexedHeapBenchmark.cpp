@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "../IndexedHeap.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+
+using namespace Foliage;
+
+namespace {
+    struct VectorSlot {
+        std::vector<uint32_t> *slots;
+
+        uint32_t &operator()(uint32_t id) const { return (*slots)[id]; }
+    };
+
+    template<size_t Arity>
+    using Heap = Util::IndexedHeap<Arity, double, VectorSlot>;
+}
+
+// Dijkstra over a random grid with a lazy binary heap (a duplicate entry per improvement) and with indexed heaps
+TEST(IndexedHeapBenchmark, Dijkstra) {
+    const uint32_t side = 300, n = side * side;
+    std::mt19937 random(5);
+    std::vector<float> right(n), down(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        right[i] = 1 + random() % 100;
+        down[i] = 1 + random() % 100;
+    }
+    auto for_neighbors = [&](uint32_t u, auto &&relax) {
+        if (u % side + 1 < side) relax(u + 1, right[u]);
+        if (u % side > 0) relax(u - 1, right[u - 1]);
+        if (u + side < n) relax(u + side, down[u]);
+        if (u >= side) relax(u - side, down[u - side]);
+    };
+
+    std::vector<double> lazy_distance(n, std::numeric_limits<double>::infinity());
+    size_t lazy_pushes = 0, lazy_pops = 0;
+    auto st = std::chrono::steady_clock::now();
+    {
+        using Entry = std::pair<double, uint32_t>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+        lazy_distance[0] = 0;
+        heap.emplace(0, 0);
+        ++lazy_pushes;
+        while (!heap.empty()) {
+            const auto [d, u] = heap.top();
+            heap.pop();
+            ++lazy_pops;
+            if (d > lazy_distance[u]) continue;
+            for_neighbors(u, [&](uint32_t v, float w) {
+                if (d + w < lazy_distance[v]) {
+                    lazy_distance[v] = d + w;
+                    heap.emplace(d + w, v);
+                    ++lazy_pushes;
+                }
+            });
+        }
+    }
+    const double lazy_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+    std::cerr << "Lazy binary heap: " << lazy_pushes << " pushes, " << lazy_pops << " pops, " << lazy_seconds * 1e3
+            << " ms" << std::endl;
+
+    auto indexed = [&]<size_t Arity>(std::integral_constant<size_t, Arity>) {
+        std::vector<double> distance(n, std::numeric_limits<double>::infinity());
+        std::vector<uint32_t> slots(n, Heap<Arity>::npos);
+        Heap<Arity> heap({&slots});
+        const auto start = std::chrono::steady_clock::now();
+        distance[0] = 0;
+        heap.push_or_decrease(0, 0);
+        while (!heap.empty()) {
+            const auto [d, u] = heap.pop();
+            for_neighbors(u, [&](uint32_t v, float w) {
+                if (d + w < distance[v]) {
+                    distance[v] = d + w;
+                    heap.push_or_decrease(v, d + w);
+                }
+            });
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto &counters = heap.counters();
+        std::cerr << "Indexed " << Arity << "-ary heap: " << counters.pushes << " pushes, " << counters.decreases
+                << " decreases, " << counters.pops << " pops, " << seconds * 1e3 << " ms" << std::endl;
+        return distance;
+    };
+    ASSERT_EQ(lazy_distance, indexed(std::integral_constant<size_t, 2>{}));
+    ASSERT_EQ(lazy_distance, indexed(std::integral_constant<size_t, 4>{}));
+}
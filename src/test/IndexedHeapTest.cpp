@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include "../IndexedHeap.h"
+#include <algorithm>
+#include <random>
+
+using namespace Foliage;
+
+namespace {
+    struct VectorSlot {
+        std::vector<uint32_t> *slots;
+
+        uint32_t &operator()(uint32_t id) const { return (*slots)[id]; }
+    };
+
+    template<size_t Arity>
+    using Heap = Util::IndexedHeap<Arity, double, VectorSlot>;
+}
+
+TEST(IndexedHeap, PopsInKeyOrderWithDecreases) {
+    std::vector<uint32_t> slots(1000, Heap<4>::npos);
+    Heap<4> heap({&slots});
+    std::vector<double> keys(slots.size(), std::numeric_limits<double>::infinity());
+    std::mt19937 random(3);
+    for (int i = 0; i < 5000; ++i) {
+        const uint32_t id = random() % slots.size();
+        const double key = random() % 100000;
+        heap.push_or_decrease(id, key);
+        keys[id] = std::min(keys[id], key);
+    }
+    double last = -1;
+    size_t popped = 0;
+    while (!heap.empty()) {
+        const auto [key, id] = heap.pop();
+        ASSERT_EQ(keys[id], key);
+        ASSERT_GE(key, last);
+        ASSERT_EQ(Heap<4>::npos, slots[id]);
+        last = key;
+        ++popped;
+    }
+    ASSERT_EQ(popped, static_cast<size_t>(std::ranges::count_if(keys, [](double key) { return key < 1e9; })));
+    ASSERT_EQ(heap.counters().pushes, popped);
+    ASSERT_GT(heap.counters().decreases, 0u);
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "../Landmarks.h"
+#include "../RoutingProfile.h"
+#include "TestGrid.h"
+#include <cmath>
+#include <random>
+
+using namespace Foliage;
+
+class LandmarksTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 random(4);
+        graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(
+            Fixtures::grid(side, random, {"primary", "secondary", "residential", "footway"}, 0, 0.2)));
+    }
+
+    // Checks the bound against the true distance from a sample of sources to every node
+    void expect_admissible(const Graph::ProfileWeights &weights) const {
+        // Subtracting two float distances to a far landmark can be off by a few of their ulps
+        float largest = 0;
+        for (const auto d: weights.landmarks->from_landmark) if (std::isfinite(d)) largest = std::max(largest, d);
+        for (const auto d: weights.landmarks->to_landmark) if (std::isfinite(d)) largest = std::max(largest, d);
+        const float slack = 4 * std::numeric_limits<float>::epsilon() * largest;
+        for (Graph::NodeIndex source = 0; source < graph->node_count(); source += 37) {
+            const auto distance = Fixtures::distances(*graph, weights, source);
+            ASSERT_EQ(weights.lower_bound(source, source), 0);
+            for (Graph::NodeIndex target = 0; target < graph->node_count(); ++target) {
+                const float bound = weights.lower_bound(source, target);
+                ASSERT_GE(bound, 0);
+                if (std::isfinite(distance[target])) {
+                    ASSERT_LE(bound, distance[target] + slack) << source << " -> " << target;
+                }
+            }
+        }
+    }
+
+    const int side = 30;
+    std::shared_ptr<const Graph::RoutingGraph> graph;
+};
+
+TEST_F(LandmarksTest, LowerBoundIsAdmissible) {
+    for (const auto strategy: {Graph::LandmarkStrategy::Farthest, Graph::LandmarkStrategy::Avoid}) {
+        Graph::ProfileWeights weights(Graph::RoutingProfile::car(), *graph);
+        weights.landmarks = std::make_shared<const Graph::LandmarkTable>(
+            Graph::LandmarkTable::build(*graph, weights.weights, 6, strategy));
+        ASSERT_EQ(weights.landmarks->size(), 6);
+        ASSERT_EQ(weights.landmarks->from_landmark.size(), 6 * graph->node_count());
+        auto landmarks = weights.landmarks->landmarks;
+        std::ranges::sort(landmarks);
+        ASSERT_EQ(std::ranges::adjacent_find(landmarks), landmarks.end()) << "Landmarks must be distinct";
+        expect_admissible(weights);
+    }
+}
+
+TEST_F(LandmarksTest, CustomProfilesShareScaledBounds) {
+    Graph::ProfileSet profiles(graph, 8, 4);
+    const auto car = profiles.get({});
+    ASSERT_TRUE(car->landmarks);
+    ASSERT_EQ(car->landmark_scale, 1);
+
+    // Faster residential streets make those edges cheaper than the base profile thinks
+    const auto fast = profiles.get({{"speed.residential", "60"}});
+    ASSERT_EQ(fast->landmarks, car->landmarks);
+    ASSERT_FLOAT_EQ(fast->landmark_scale, 0.5);
+    expect_admissible(*fast);
+
+    // Avoiding a class only makes edges more expensive
+    const auto avoid = profiles.get({{"avoid", "secondary"}});
+    ASSERT_EQ(avoid->landmark_scale, 1);
+    expect_admissible(*avoid);
+
+    // Footways are closed for cars, so the car landmarks say nothing about them
+    const auto open = profiles.get({{"speed.footway", "5"}});
+    ASSERT_EQ(open->landmark_scale, 0);
+    ASSERT_EQ(open->lower_bound(0, graph->node_count() - 1), 0);
+}
@@ -1,6 +1,5 @@
 #include <gtest/gtest.h>
 #include "../LayeredAStarPathfinder.h"
-#include "../QuadTree.h"
 #include "../object.h"
 #include <map>
 #include <vector>
@@ -17,36 +16,28 @@ using namespace Foliage;
 class LayeredAStarPathfinderTest : public ::testing::TestWithParam<std::string> {
 protected:
     void SetUp() override {
-        // Initialize the QuadTree with appropriate boundaries
-        qtree = std::make_shared<Foliage::Util::QuadTree>(Geometry::BoundingBox({0, 0}, {100, 100}), 15);
-
         // Create nodes dynamically based on the graph data
         load_graph_from_file(GetParam()); // Load graph from the test file
 
-        // Initialize the pathfinder with the QuadTree
-        pathfinder = std::make_shared<Foliage::Pathfinder::LayeredAStarPathfinder>(qtree);
+        // Freeze the adjacency into the routing graph
+        graph = std::make_shared<const Foliage::Graph::RoutingGraph>(Foliage::Graph::RoutingGraph::build(ways));
+
+        // Initialize the pathfinder with the graph, which it snaps onto
+        pathfinder = std::make_shared<Foliage::Pathfinder::LayeredAStarPathfinder>(graph);
 
         // Define preferences (if applicable)
         preferences = {{"highway", "primary"}, {"avoid_obstacles", "false"}};
     }
 
     void TearDown() override {
-        // Clear neighbors to break potential cyclic references
+        // Clear back references to break cyclic references
         for (auto& node : nodes) {
-            node->neighbors.clear();
             node->ways.clear();
         }
 
         // Reset shared pointers
         pathfinder.reset();
-        qtree.reset();
-    }
-
-    // Helper function to calculate Euclidean distance
-    double calculate_distance(const Foliage::Geometry::Position& a, const Foliage::Geometry::Position& b) {
-        double dx = a.latitude - b.latitude;
-        double dy = a.longitude - b.longitude;
-        return std::sqrt(dx * dx + dy * dy);
+        graph.reset();
     }
 
     // Helper function to load graph from a file
@@ -65,21 +56,14 @@ protected:
                 auto node1 = get_or_create_node(id1, lat1, lon1, node_map);
                 auto node2 = get_or_create_node(id2, lat2, lon2, node_map);
 
-                // Create and add edges (ways) between the nodes
-                auto way = std::make_shared<Foliage::ObjectType::NeighborInfo>();
-                way->distance = calculate_distance(node1->position, node2->position);
-                way->tags = {{"highway", "primary"}, {"maxspeed", "10"}};
-
-                node1->neighbors[node2] = *way;
-                node2->neighbors[node1] = *way;
-
-                // Create and add the ways to the nodes' ways list
-                auto new_way = Foliage::ObjectType::Way();
-                new_way.nodes.push_back(node1);
-                new_way.nodes.push_back(node2);
-                new_way.tags["highway"] = "true";
-                node1->ways.insert(std::make_shared<const Foliage::ObjectType::Way>(new_way));
-                node2->ways.insert(std::make_shared<const Foliage::ObjectType::Way>(new_way));
+                // Create a way between the nodes and add it to the nodes' ways list
+                auto new_way = std::make_shared<Foliage::ObjectType::Way>(static_cast<int64_t>(ways.size()));
+                new_way->nodes.push_back(node1);
+                new_way->nodes.push_back(node2);
+                new_way->tags = {{"highway", "primary"}, {"maxspeed", "10"}};
+                node1->ways.insert(new_way);
+                node2->ways.insert(new_way);
+                ways.push_back(new_way);
             }
         }
         std::cerr << "Test setup finished here" << std::endl;
@@ -94,17 +78,17 @@ protected:
             new_node->position = Foliage::Geometry::Position(lat, lon);
             node_map[id] = new_node;
             nodes.push_back(new_node);
-            qtree->insert(new_node);
         }
         return node_map[id];
     }
 
     // Test members
     std::shared_ptr<Foliage::Pathfinder::LayeredAStarPathfinder> pathfinder;
-    std::shared_ptr<Foliage::Util::QuadTree> qtree;
+    std::shared_ptr<const Foliage::Graph::RoutingGraph> graph;
     Foliage::Geometry::Position start, end;
     std::map<std::string, std::string> preferences;
     std::vector<std::shared_ptr<Foliage::ObjectType::Node>> nodes;
+    std::vector<std::shared_ptr<Foliage::ObjectType::Way>> ways;
 };
 
 TEST_P(LayeredAStarPathfinderTest, GetPath_ReturnsValidPath) {
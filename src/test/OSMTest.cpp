@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "../OSM.h"
+#include "../XMLStreamReader.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace Foliage;
+using Foliage::DataProvider::OSM::Document;
+
+static const std::string sample_file = "../src/test/data/sample.osm";
+
+// Records every event as a string so two runs can be compared
+class RecordingHandler : public DataProvider::OSM::XMLStreamHandler {
+public:
+    std::vector<std::string> events;
+
+    void start_element(std::string_view name, std::span<const DataProvider::OSM::XMLAttribute> attributes) override {
+        std::string event = "<" + std::string(name);
+        for (const auto &attribute: attributes) {
+            event += " " + std::string(attribute.name) + "=" + std::string(attribute.value);
+        }
+        events.push_back(event);
+    }
+
+    void end_element(std::string_view name) override {
+        events.push_back("</" + std::string(name));
+    }
+};
+
+TEST(OSMTest, StreamingMatchesDOM) {
+    Document streaming(sample_file, Document::Loader::Streaming);
+    streaming.load();
+    streaming.parse();
+
+    Document dom(sample_file, Document::Loader::DOM);
+    dom.load();
+    dom.parse();
+
+    ASSERT_EQ(streaming.nodes_by_id.size(), 8);
+    ASSERT_EQ(streaming.ways_by_id.size(), 3);
+    ASSERT_EQ(streaming.nodes_by_id.size(), dom.nodes_by_id.size());
+    ASSERT_EQ(streaming.ways_by_id.size(), dom.ways_by_id.size());
+    ASSERT_EQ(streaming.border.min_position, dom.border.min_position);
+    ASSERT_EQ(streaming.border.max_position, dom.border.max_position);
+
+    for (const auto &[id, node]: streaming.nodes_by_id) {
+        const auto &other = dom.get_node_by_id(id);
+        ASSERT_EQ(node->position, other->position) << "Node " << id;
+        ASSERT_EQ(node->tags, other->tags) << "Node " << id;
+        ASSERT_EQ(node->ways.size(), other->ways.size()) << "Node " << id;
+    }
+    for (const auto &[id, way]: streaming.ways_by_id) {
+        const auto &other = dom.get_way_by_id(id);
+        ASSERT_EQ(way->tags, other->tags) << "Way " << id;
+        ASSERT_EQ(way->nodes.size(), other->nodes.size()) << "Way " << id;
+        for (size_t i = 0; i < way->nodes.size(); ++i) {
+            ASSERT_EQ(way->nodes[i]->id, other->nodes[i]->id) << "Way " << id;
+        }
+    }
+}
+
+TEST(OSMTest, StreamingDecodesEntities) {
+    Document document(sample_file);
+    document.load();
+
+    ASSERT_EQ(document.get_node_by_id(5)->tags.at("name"), "Caf\xC3\xA9 & \"Bar\" <1>");
+    ASSERT_EQ(document.get_way_by_id(100)->tags.at("name"), "Huaihai 'Middle' Road");
+    // Relation tags must not leak onto the last way
+    ASSERT_FALSE(document.get_way_by_id(102)->tags.contains("type"));
+}
+
+TEST(OSMTest, StreamReaderIsIndependentOfChunkSize) {
+    RecordingHandler whole, chunked;
+    DataProvider::OSM::XMLStreamReader(sample_file).read(whole);
+    DataProvider::OSM::XMLStreamReader(sample_file, 16).read(chunked);
+
+    ASSERT_FALSE(whole.events.empty());
+    ASSERT_EQ(whole.events, chunked.events);
+}
+
+TEST(OSMTest, ChunkReaderSplitsAtTopLevelElements) {
+    std::string whole, joined;
+    {
+        std::ifstream in(sample_file, std::ios::binary);
+        whole.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    DataProvider::OSM::XMLChunkReader reader(sample_file, {"node", "way", "relation"}, 16);
+    std::vector<std::string> pieces;
+    for (std::string piece; reader.next(piece);) pieces.push_back(piece);
+
+    // Header and bounds, then one piece per node, way and relation
+    ASSERT_EQ(pieces.size(), 13);
+    for (size_t i = 1; i < pieces.size(); ++i) {
+        ASSERT_TRUE(pieces[i].starts_with("<node ") || pieces[i].starts_with("<way ") ||
+                    pieces[i].starts_with("<relation ")) << pieces[i];
+    }
+    for (const auto &piece: pieces) joined += piece;
+    ASSERT_EQ(joined, whole);
+}
+
+TEST(OSMTest, ChunkReaderDoesNotSplitInsideComments) {
+    const std::string file = "osm_commented_out.osm";
+    {
+        std::ofstream out(file);
+        out << "<osm><node id=\"1\" lat=\"0\" lon=\"0\"/><!-- <node id=\"2\" lat=\"0\" lon=\"0\"/> -->"
+               "<node id=\"3\" lat=\"0\" lon=\"0\"/><?pi <way id=\"4\"/> ?></osm>";
+    }
+    DataProvider::OSM::XMLChunkReader reader(file, {"node", "way"}, 16);
+    std::vector<std::string> pieces;
+    for (std::string piece; reader.next(piece);) pieces.push_back(piece);
+    std::remove(file.c_str());
+
+    ASSERT_EQ(pieces.size(), 3);
+    ASSERT_TRUE(pieces[1].starts_with("<node id=\"1\""));
+    ASSERT_TRUE(pieces[2].starts_with("<node id=\"3\""));
+}
+
+TEST(OSMTest, StreamingResolvesForwardReferences) {
+    const std::string file = "osm_forward_reference.osm";
+    {
+        std::ofstream out(file);
+        out << "<osm><way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/></way>"
+               "<node id=\"1\" lat=\"0\" lon=\"0\"/><node id=\"2\" lat=\"1\" lon=\"1\"/></osm>";
+    }
+    Document document(file);
+    document.load();
+    document.parse();
+    std::remove(file.c_str());
+
+    const auto way = document.get_way_by_id(10);
+    ASSERT_EQ(way->nodes.size(), 2);
+    ASSERT_EQ(way->nodes[1], document.get_node_by_id(2));
+    ASSERT_TRUE(document.get_node_by_id(1)->ways.contains(way));
+
+    std::vector<std::string> stages;
+    for (const auto &stage: document.timings.stages) stages.push_back(stage.name);
+    ASSERT_EQ(stages, (std::vector<std::string>{"tokenize", "node index", "way references", "id tables"}));
+}
+
+TEST(OSMTest, StreamingRejectsDanglingReference) {
+    const std::string file = "osm_dangling_reference.osm";
+    {
+        std::ofstream out(file);
+        out << "<osm><node id=\"1\" lat=\"0\" lon=\"0\"/><way id=\"2\"><nd ref=\"1\"/><nd ref=\"3\"/></way></osm>";
+    }
+    Document document(file);
+    ASSERT_THROW(document.load(), std::runtime_error);
+    std::remove(file.c_str());
+}
+
+TEST(OSMTest, ResetReleasesObjects) {
+    Document document(sample_file);
+    document.load();
+    document.parse();
+
+    std::weak_ptr<ObjectType::Node> node = document.get_node_by_id(3);
+    std::weak_ptr<ObjectType::Way> way = document.get_way_by_id(100);
+    document.reset();
+
+    ASSERT_TRUE(node.expired()) << "Node kept alive by a reference cycle";
+    ASSERT_TRUE(way.expired()) << "Way kept alive by a reference cycle";
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "../OSM.h"
+#include "../PBF.h"
+#include "../object.h"
+#include <fstream>
+#include <string>
+
+using namespace Foliage;
+
+// sample.osm.pbf holds the same data as sample.osm, split into several blocks
+static const std::string sample_xml = "../src/test/data/sample.osm";
+static const std::string sample_pbf = "../src/test/data/sample.osm.pbf";
+
+TEST(PBFTest, MatchesXML) {
+    DataProvider::OSM::Document xml(sample_xml);
+    xml.load();
+    xml.parse();
+
+    DataProvider::PBF::Document pbf(sample_pbf);
+    pbf.load();
+    pbf.parse();
+
+    ASSERT_EQ(pbf.nodes_by_id.size(), xml.nodes_by_id.size());
+    ASSERT_EQ(pbf.ways_by_id.size(), xml.ways_by_id.size());
+    ASSERT_EQ(pbf.border.min_position, xml.border.min_position);
+    ASSERT_EQ(pbf.border.max_position, xml.border.max_position);
+
+    for (const auto &[id, node]: xml.nodes_by_id) {
+        const auto other = pbf.get_node_by_id(id);
+        ASSERT_EQ(node->position, other->position) << "Node " << id;
+        ASSERT_EQ(node->tags, other->tags) << "Node " << id;
+        ASSERT_EQ(node->ways.size(), other->ways.size()) << "Node " << id;
+    }
+    for (const auto &[id, way]: xml.ways_by_id) {
+        const auto other = pbf.get_way_by_id(id);
+        ASSERT_EQ(way->tags, other->tags) << "Way " << id;
+        ASSERT_EQ(way->nodes.size(), other->nodes.size()) << "Way " << id;
+        for (size_t i = 0; i < way->nodes.size(); ++i) {
+            ASSERT_EQ(way->nodes[i]->id, other->nodes[i]->id) << "Way " << id;
+        }
+    }
+}
+
+TEST(PBFTest, RejectsTruncatedFile) {
+    const std::string file = "pbf_truncated.osm.pbf";
+    {
+        std::ifstream in(sample_pbf, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(file, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size() - 7));
+    }
+    DataProvider::PBF::Document document(file);
+    ASSERT_THROW(document.load(), std::runtime_error);
+    std::remove(file.c_str());
+}
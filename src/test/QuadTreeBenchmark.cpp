@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "../FlatQuadTree.h"
+#include "../QuadTree.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace Foliage;
+
+// Loads the same points into the pointer QuadTree (one insert each) and the flat tree (one bulk
+// build), then runs the same box queries on both
+TEST(QuadTreeBenchmark, BuildAndQuery) {
+    const int points = 200000, queries = 20000;
+    std::mt19937 random(3);
+    std::vector<std::shared_ptr<ObjectType::Node>> nodes;
+    std::vector<Geometry::Position> positions;
+    for (int i = 0; i < points; ++i) {
+        auto node = std::make_shared<ObjectType::Node>(i);
+        node->position = Geometry::Position(31 + (random() % 1000000) * 1e-6, 121 + (random() % 1000000) * 1e-6);
+        nodes.push_back(node);
+        positions.push_back(node->position);
+    }
+    std::vector<Geometry::BoundingBox> boxes;
+    for (int i = 0; i < queries; ++i) {
+        const Geometry::Position center(31 + (random() % 1000000) * 1e-6, 121 + (random() % 1000000) * 1e-6);
+        boxes.emplace_back(center, 0.002);
+    }
+
+    auto st = std::chrono::steady_clock::now();
+    Util::QuadTree pointer_tree(Geometry::BoundingBox({30.9, 120.9}, {32.1, 122.1}), 16);
+    for (const auto &node: nodes) pointer_tree.insert(node);
+    auto built = std::chrono::steady_clock::now();
+    std::vector<int64_t> pointer_results;
+    for (const auto &box: boxes) {
+        for (const auto &node: pointer_tree.find_node(box)) pointer_results.push_back(node->id);
+    }
+    auto queried = std::chrono::steady_clock::now();
+
+    const auto flat_tree = Util::FlatQuadTree::build(positions);
+    auto flat_built = std::chrono::steady_clock::now();
+    std::vector<uint32_t> flat_results;
+    for (const auto &box: boxes) flat_tree.query(box, flat_results);
+    auto ed = std::chrono::steady_clock::now();
+
+    auto seconds = [](auto from, auto to) { return std::chrono::duration<double>(to - from).count(); };
+    std::cerr << "QuadTree:     build " << seconds(st, built) * 1e3 << " ms, "
+            << queries / seconds(built, queried) / 1e3 << " k queries/s" << std::endl;
+    std::cerr << "FlatQuadTree: build " << seconds(queried, flat_built) * 1e3 << " ms, "
+            << queries / seconds(flat_built, ed) / 1e3 << " k queries/s" << std::endl;
+
+    ASSERT_EQ(pointer_results.size(), flat_results.size());
+    std::vector<int64_t> flat_ids(flat_results.begin(), flat_results.end());
+    std::ranges::sort(pointer_results);
+    std::ranges::sort(flat_ids);
+    ASSERT_EQ(pointer_results, flat_ids);
+}
@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
+#include "../FlatQuadTree.h"
 #include "../QuadTree.h"
 #include "../object.h"
 #include "../Geometry.h"
-#include <vector>
+#include <algorithm>
 #include <memory>
+#include <random>
+#include <vector>
 
 using namespace Foliage;
 using namespace Foliage::Util;
@@ -165,3 +168,93 @@ TEST_F(QuadTreeTest, DestructorCleansUpChildren) {
     // Since tempQuadTree is out of scope, we expect its destructor to have been called without issues.
     SUCCEED() << "QuadTree destructor executed without issues.";
 }
+
+// Random points with a cluster of duplicates, which a leaf has to hold past its size.
+// Coordinates have 7 decimals at most, so the tree stores them exactly
+class FlatQuadTreeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 random(21);
+        for (int i = 0; i < 3000; ++i) {
+            positions.emplace_back(Geometry::from_fixed(310000000 + static_cast<int32_t>(random() % 100000) * 10),
+                                   Geometry::from_fixed(1210000000 + static_cast<int32_t>(random() % 100000) * 10));
+        }
+        positions.insert(positions.end(), 40, Geometry::Position(31.05, 121.05));
+        tree = FlatQuadTree::build(positions, 8);
+    }
+
+    Geometry::BoundingBox random_box(std::mt19937 &random) const {
+        const Geometry::Position corner(30.99 + (random() % 12000) * 1e-5, 120.99 + (random() % 12000) * 1e-5);
+        return Geometry::BoundingBox(corner, Geometry::Position(corner.latitude + (random() % 3000) * 1e-5,
+                                                                corner.longitude + (random() % 3000) * 1e-5));
+    }
+
+    double distance(uint32_t i, Geometry::Position position) const {
+        return tree.shape.projection.distance(positions[i], position);
+    }
+
+    std::vector<Geometry::Position> positions;
+    FlatQuadTree tree;
+};
+
+TEST_F(FlatQuadTreeTest, QueryMatchesBruteForce) {
+    ASSERT_EQ(tree.items.size(), positions.size());
+    std::mt19937 random(4);
+    std::vector<uint32_t> found;
+    for (int query = 0; query < 300; ++query) {
+        const auto box = random_box(random);
+        found.clear();
+        tree.query(box, found);
+        std::ranges::sort(found);
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < positions.size(); ++i) {
+            if (box.contains(positions[i])) expected.push_back(i);
+        }
+        ASSERT_EQ(found, expected);
+    }
+    // Corners of the box count as inside
+    found.clear();
+    tree.query(Geometry::BoundingBox(positions[7], positions[7]), found);
+    ASSERT_NE(std::ranges::find(found, 7u), found.end());
+}
+
+TEST_F(FlatQuadTreeTest, NearestMatchesBruteForce) {
+    std::mt19937 random(13);
+    for (int query = 0; query < 300; ++query) {
+        const Geometry::Position position(30.995 + (random() % 11000) * 1e-5, 120.995 + (random() % 11000) * 1e-5);
+        uint32_t expected = FlatQuadTree::npos;
+        for (uint32_t i = 0; i < positions.size(); ++i) {
+            if (distance(i, position) > 200) continue;
+            if (expected == FlatQuadTree::npos || distance(i, position) < distance(expected, position)) expected = i;
+        }
+        ASSERT_EQ(tree.nearest(position, 200), expected);
+    }
+    ASSERT_EQ(tree.nearest(Geometry::Position(31.05, 121.05), 0.001), 3000u) << "Ties go to the lowest index";
+    ASSERT_EQ(tree.nearest(Geometry::Position(40, 130), 1000), FlatQuadTree::npos);
+    ASSERT_EQ(FlatQuadTree::build({}).nearest(Geometry::Position(31, 121), 1), FlatQuadTree::npos);
+}
+
+TEST_F(FlatQuadTreeTest, KNearestWithFilter) {
+    std::mt19937 random(8);
+    std::vector<FlatQuadTree::Neighbor> found;
+    auto odd = [](uint32_t index) { return index % 2 == 1; };
+    for (int query = 0; query < 200; ++query) {
+        // Also from outside the points' bounds, where every cell is some way off
+        const Geometry::Position position(30.9 + (random() % 30000) * 1e-5, 120.9 + (random() % 30000) * 1e-5);
+        const size_t k = 1 + random() % 20;
+        const double max_distance = random() % 5000; // Metres
+        tree.nearest(position, k, max_distance, odd, found);
+
+        std::vector<std::pair<double, uint32_t>> expected;
+        for (uint32_t i = 1; i < positions.size(); i += 2) {
+            if (distance(i, position) <= max_distance) expected.emplace_back(distance(i, position), i);
+        }
+        std::ranges::sort(expected);
+        expected.resize(std::min(expected.size(), k));
+        ASSERT_EQ(found.size(), expected.size());
+        for (size_t i = 0; i < found.size(); ++i) {
+            ASSERT_EQ(found[i].index, expected[i].second);
+            ASSERT_NEAR(found[i].distance, expected[i].first, 1e-6);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "../RoutingGraph.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+using namespace Foliage;
+
+// Scans every edge the way the pathfinder does, once over the old per-node
+// neighbor maps (one tag map copy per edge) and once over the CSR arrays
+TEST(RoutingGraphBenchmark, EdgeScanThroughput) {
+    struct NeighborInfo {
+        double distance;
+        bool is_positive_direction;
+        std::unordered_map<std::string, std::string> tags;
+    };
+    std::unordered_map<std::shared_ptr<const ObjectType::Node>, std::unordered_map<
+        std::shared_ptr<const ObjectType::Node>, NeighborInfo>> neighbors;
+
+    const int side = 120;
+    std::vector<std::shared_ptr<ObjectType::Node>> nodes;
+    std::vector<std::shared_ptr<ObjectType::Way>> ways;
+    for (int i = 0; i < side * side; ++i) {
+        auto node = std::make_shared<ObjectType::Node>(i);
+        node->position = Geometry::Position(i / side, i % side);
+        nodes.push_back(node);
+    }
+    auto connect = [&](int a, int b) {
+        auto way = std::make_shared<ObjectType::Way>(static_cast<int64_t>(ways.size()));
+        way->nodes = {nodes[a], nodes[b]};
+        way->tags = {{"highway", a % 3 ? "primary" : "residential"}};
+        ways.push_back(way);
+    };
+    for (int i = 0; i < side * side; ++i) {
+        if (i % side + 1 < side) connect(i, i + 1);
+        if (i + side < side * side) connect(i, i + side);
+    }
+    const auto graph = Graph::RoutingGraph::build(ways);
+    for (const auto &way: ways) {
+        const auto &a = way->nodes[0], &b = way->nodes[1];
+        const double distance = graph.distance(graph.index_of(a->id), graph.index_of(b->id));
+        neighbors[a][b] = NeighborInfo{distance, true, way->tags};
+        neighbors[b][a] = NeighborInfo{distance, false, way->tags};
+    }
+
+    const int rounds = 10;
+    double checksum_map = 0, checksum_csr = 0;
+    size_t edges = 0;
+    auto st = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto &node: nodes) {
+            for (const auto &[target, info]: neighbors[node]) {
+                if (info.tags.contains("highway")) checksum_map += info.distance + target->position.latitude;
+                ++edges;
+            }
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (Graph::NodeIndex u = 0; u < graph.node_count(); ++u) {
+            for (auto edge = graph.edges_begin(u); edge < graph.edges_end(u); ++edge) {
+                if (graph.attributes[graph.edge_attributes[edge]].highway != Graph::HighwayClass::Other) {
+                    checksum_csr += graph.edge_lengths[edge] + graph.position(graph.edge_targets[edge]).latitude;
+                }
+            }
+        }
+    }
+    auto ed = std::chrono::steady_clock::now();
+
+    const double map_seconds = std::chrono::duration<double>(mid - st).count();
+    const double csr_seconds = std::chrono::duration<double>(ed - mid).count();
+    std::cerr << "Node::neighbors: " << edges / map_seconds / 1e6 << " M edges/s" << std::endl;
+    std::cerr << "RoutingGraph:    " << edges / csr_seconds / 1e6 << " M edges/s" << std::endl;
+    ASSERT_DOUBLE_EQ(checksum_map, checksum_csr);
+}
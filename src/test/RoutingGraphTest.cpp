@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "../OSM.h"
+#include "../RoutingGraph.h"
+#include <algorithm>
+#include <tuple>
+#include <string>
+
+using namespace Foliage;
+
+static const std::string sample_file = "../src/test/data/sample.osm";
+
+class RoutingGraphTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        document.set_document(sample_file);
+        document.load();
+        document.parse();
+        graph = Graph::RoutingGraph::build(document);
+    }
+
+    DataProvider::OSM::Document document;
+    Graph::RoutingGraph graph;
+};
+
+TEST_F(RoutingGraphTest, KeepsOnlyRoutableNodesAndEdges) {
+    // Nodes 7 and 8 are only part of the building
+    ASSERT_EQ(graph.node_count(), 6);
+    ASSERT_EQ(graph.index_of(7), Graph::invalid_node);
+    ASSERT_EQ(graph.index_of(8), Graph::invalid_node);
+    // 3 segments on way 100 and 2 on way 101, both directions
+    ASSERT_EQ(graph.edge_count(), 10);
+    ASSERT_EQ(graph.edge_offsets.size(), graph.node_count() + 1);
+    // One shared record per distinct tag set
+    ASSERT_EQ(graph.attributes.size(), 2);
+    ASSERT_TRUE(std::ranges::is_sorted(graph.node_ids));
+}
+
+TEST_F(RoutingGraphTest, MatchesWaySegments) {
+    size_t segments = 0;
+    for (const auto &[id, way]: document.ways_by_id) {
+        if (!way->tags.contains("highway")) continue;
+        for (size_t i = 0; i + 1 < way->nodes.size(); ++i, ++segments) {
+            const auto from = graph.index_of(way->nodes[i]->id);
+            const auto to = graph.index_of(way->nodes[i + 1]->id);
+            ASSERT_EQ(graph.position(from), way->nodes[i]->position);
+            for (const auto &[u, v, positive]: {std::tuple{from, to, true}, std::tuple{to, from, false}}) {
+                const auto first = graph.edge_targets.begin() + graph.edges_begin(u);
+                const auto last = graph.edge_targets.begin() + graph.edges_end(u);
+                const auto it = std::find(first, last, v);
+                ASSERT_NE(it, last) << "Missing edge on way " << id;
+                const auto edge = static_cast<Graph::EdgeIndex>(it - graph.edge_targets.begin());
+                ASSERT_EQ(graph.edge_is_positive_direction[edge], positive);
+                const auto twin = graph.edge_twins[edge];
+                ASSERT_EQ(graph.edge_twins[twin], edge);
+                ASSERT_EQ(graph.edge_source(edge), u);
+                ASSERT_EQ(graph.edge_targets[twin], u);
+                ASSERT_EQ(graph.edge_attributes[twin], graph.edge_attributes[edge]);
+                ASSERT_NE(graph.edge_is_positive_direction[twin], positive);
+                const auto attribute = graph.edge_attributes[edge];
+                ASSERT_EQ(graph.attributes[attribute].tags_end - graph.attributes[attribute].tags_begin,
+                          way->tags.size());
+                for (const auto &[key, value]: way->tags) {
+                    ASSERT_EQ(graph.tag(attribute, key), value) << "Tag " << key << " on way " << id;
+                }
+                ASSERT_NEAR(graph.edge_lengths[edge],
+                            graph.projection.distance(way->nodes[i]->position, way->nodes[i + 1]->position), 1e-6);
+            }
+        }
+    }
+    ASSERT_EQ(graph.edge_count(), 2 * segments);
+}
+
+TEST_F(RoutingGraphTest, DecodesWayAttributes) {
+    const auto attribute_of = [&](int64_t from, int64_t to) {
+        const auto u = graph.index_of(from);
+        for (auto edge = graph.edges_begin(u); edge < graph.edges_end(u); ++edge) {
+            if (graph.edge_targets[edge] == graph.index_of(to)) return graph.attributes[graph.edge_attributes[edge]];
+        }
+        throw std::runtime_error("No such edge");
+    };
+    const auto primary = attribute_of(1, 2);
+    ASSERT_EQ(primary.highway, Graph::HighwayClass::Primary);
+    ASSERT_EQ(primary.oneway, Graph::Oneway::No);
+    ASSERT_EQ(primary.maxspeed, 60);
+    const auto residential = attribute_of(5, 6);
+    ASSERT_EQ(residential.highway, Graph::HighwayClass::Residential);
+    ASSERT_EQ(residential.oneway, Graph::Oneway::Forward);
+    ASSERT_EQ(residential.maxspeed, 0);
+    ASSERT_TRUE(graph.tag(graph.edge_attributes[graph.edges_begin(graph.index_of(5))], "maxspeed").empty());
+    ASSERT_TRUE(graph.tag(0, "no such key").empty());
+
+    ASSERT_FLOAT_EQ(Graph::WayAttributes::parse_maxspeed("50 mph"), 50 * 1.609344f);
+    ASSERT_FLOAT_EQ(Graph::WayAttributes::parse_maxspeed("30km/h"), 30);
+    ASSERT_EQ(Graph::WayAttributes::parse_maxspeed("none"), 0);
+    ASSERT_EQ(Graph::WayAttributes::parse_maxspeed("RU:urban"), 0);
+    ASSERT_EQ(Graph::WayAttributes::parse_oneway("-1"), Graph::Oneway::Backward);
+    ASSERT_EQ(Graph::WayAttributes::parse_highway("motorway_link"), Graph::HighwayClass::MotorwayLink);
+    ASSERT_EQ(Graph::WayAttributes::parse_highway("proposed"), Graph::HighwayClass::Other);
+}
+
+TEST_F(RoutingGraphTest, EdgesAreSortedByTarget) {
+    for (Graph::NodeIndex u = 0; u < graph.node_count(); ++u) {
+        ASSERT_TRUE(std::is_sorted(graph.edge_targets.begin() + graph.edges_begin(u),
+                                   graph.edge_targets.begin() + graph.edges_end(u)));
+    }
+}
+
+TEST_F(RoutingGraphTest, MakeNodeRoundTrips) {
+    const auto index = graph.index_of(5);
+    ASSERT_NE(index, Graph::invalid_node);
+    const auto node = graph.make_node(index);
+    ASSERT_EQ(node->id, 5);
+    ASSERT_EQ(node->position, document.get_node_by_id(5)->position);
+}
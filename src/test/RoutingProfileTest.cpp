@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "../OSM.h"
+#include "../RoutingProfile.h"
+#include <cmath>
+#include <string>
+
+using namespace Foliage;
+
+static const std::string sample_file = "../src/test/data/sample.osm";
+
+class RoutingProfileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        document.set_document(sample_file);
+        document.load();
+        document.parse();
+        graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(document));
+    }
+
+    Graph::EdgeIndex edge_between(int64_t from, int64_t to) const {
+        const auto u = graph->index_of(from);
+        for (auto edge = graph->edges_begin(u); edge < graph->edges_end(u); ++edge) {
+            if (graph->edge_targets[edge] == graph->index_of(to)) return edge;
+        }
+        throw std::runtime_error("No such edge");
+    }
+
+    DataProvider::OSM::Document document;
+    std::shared_ptr<const Graph::RoutingGraph> graph;
+};
+
+TEST_F(RoutingProfileTest, CompilesOneWeightPerEdge) {
+    Graph::ProfileSet profiles(graph);
+    const auto car = profiles.get({});
+    ASSERT_EQ(car->weights.size(), graph->edge_count());
+
+    // Way 100 is a primary road tagged maxspeed=60
+    const auto edge = edge_between(1, 2);
+    ASSERT_FLOAT_EQ((*car)[edge], graph->edge_lengths[edge] / (0.9 * 60));
+    // Way 101 is a oneway residential street from 3 to 6
+    ASSERT_TRUE(std::isfinite((*car)[edge_between(3, 5)]));
+    ASSERT_TRUE(std::isinf((*car)[edge_between(5, 3)]));
+
+    const auto foot = profiles.get({{"profile", "foot"}});
+    ASSERT_TRUE(std::isfinite((*foot)[edge_between(5, 3)]));
+    ASSERT_FLOAT_EQ((*foot)[edge], graph->edge_lengths[edge] / 5 * 1.3);
+}
+
+TEST_F(RoutingProfileTest, ReusesCompiledProfiles) {
+    Graph::ProfileSet profiles(graph, 1);
+    // Unrecognized keys do not create a new profile
+    ASSERT_EQ(profiles.get({{"highway", "primary"}}), profiles.get({{"profile", "car"}}));
+
+    const auto avoid = profiles.get({{"avoid", "residential"}});
+    ASSERT_EQ(avoid->profile.name, "car;avoid=residential");
+    ASSERT_TRUE(std::isinf((*avoid)[edge_between(3, 5)]));
+    // Snapping skips nodes left without a usable edge; 6 can only be reached through the oneway
+    ASSERT_TRUE(profiles.get({})->routable[graph->index_of(6)]);
+    ASSERT_FALSE(avoid->routable[graph->index_of(5)]);
+    ASSERT_TRUE(avoid->routable[graph->index_of(3)]);
+    ASSERT_EQ(profiles.get({{"avoid", "residential"}}), avoid);
+
+    // The cache holds one custom profile, so this evicts the first one
+    const auto slow = profiles.get({{"profile", "bike"}, {"speed.primary", "9"}});
+    ASSERT_FLOAT_EQ((*slow)[edge_between(1, 2)], graph->edge_lengths[edge_between(1, 2)] / 9 * 2.0);
+    ASSERT_NE(profiles.get({{"avoid", "residential"}}), avoid);
+}
+
+TEST_F(RoutingProfileTest, RejectsInvalidPreferences) {
+    using Graph::RoutingProfile;
+    ASSERT_THROW(RoutingProfile::from_preferences({{"profile", "plane"}}), std::invalid_argument);
+    ASSERT_THROW(RoutingProfile::from_preferences({{"avoid", "motorway,highway"}}), std::invalid_argument);
+    ASSERT_THROW(RoutingProfile::from_preferences({{"speed.primary", "fast"}}), std::invalid_argument);
+    ASSERT_THROW(RoutingProfile::from_preferences({{"factor.primary", "0"}}), std::invalid_argument);
+    ASSERT_THROW(RoutingProfile::from_preferences({{"oneway", "maybe"}}), std::invalid_argument);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "../LayeredAStarPathfinder.h"
+#include "../SearchWorkspace.h"
+#include "TestGrid.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+
+using namespace Foliage;
+
+// Counts every allocation of the executable. Built apart from foliage_be_tests, since the replaced operator new
+// applies to the whole binary
+namespace {
+    std::atomic<size_t> allocations{0};
+}
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+// A* queries on a grid: time, allocations and heap operations per query once the thread's workspace is warm,
+// then the work saved by allowing a longer path
+TEST(SearchWorkspace, AStarQueryAllocations) {
+    const int side = 80, queries = 300;
+    std::mt19937 random(9);
+    const auto ways = Fixtures::grid(side, random, {"primary", "secondary", "residential", "tertiary"}, 0);
+    Pathfinder::LayeredAStarPathfinder astar(
+        std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(ways)));
+    astar.segments = std::make_shared<const Graph::SegmentIndex>(Graph::SegmentIndex::build(*astar.graph));
+
+    std::vector<std::pair<Geometry::Position, Geometry::Position>> pairs;
+    auto random_position = [&] {
+        return Geometry::Position(31 + (random() % 79000) * 1e-6, 121 + (random() % 79000) * 1e-6);
+    };
+    for (int i = 0; i < queries; ++i) pairs.emplace_back(random_position(), random_position());
+    const std::map<std::string, std::string> preferences = {{"profile", "car"}};
+    (void) astar.get_path(pairs[0].first, pairs[0].second, preferences);
+
+    auto &workspace = Pathfinder::SearchWorkspace::local();
+    const auto heap_before = workspace.heap_counters(0), other_before = workspace.heap_counters(1);
+    size_t path_nodes = 0;
+    const size_t allocated = allocations;
+    const auto st = std::chrono::steady_clock::now();
+    for (const auto &[start, goal]: pairs) {
+        const auto path = astar.get_path(start, goal, preferences);
+        ASSERT_FALSE(path.empty());
+        path_nodes += path.size();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+    const double per_query = static_cast<double>(allocations - allocated) / queries;
+    std::cerr << "A*: " << seconds / queries * 1e6 << " us/query, " << per_query << " allocations/query, "
+            << static_cast<double>(path_nodes) / queries << " path nodes/query" << std::endl;
+    const auto heap = workspace.heap_counters(0), other = workspace.heap_counters(1);
+    std::cerr << "A* heaps: " << static_cast<double>(heap.pushes + other.pushes - heap_before.pushes - other_before.pushes) / queries
+            << " pushes, " << static_cast<double>(heap.decreases + other.decreases - heap_before.decreases -
+                                                 other_before.decreases) / queries
+            << " decreases, " << static_cast<double>(heap.pops + other.pops - heap_before.pops - other_before.pops) / queries
+            << " pops per query" << std::endl;
+    // What is left is the answer itself, a node per step, and the snapping
+    ASSERT_LT(per_query, 4.0 * path_nodes / queries + 64);
+
+    // Speed against optimality, from the totals of the pathfinder. Searching arrivals by class of road keeps the
+    // search exact under the layered costs; it settles about twice the states a search over nodes did (3343 per
+    // query), and a factor of 1.2 brings it back below that
+    const std::map<std::string, double> max_settled = {{"1", 7500}, {"1.2", 3400}, {"1.5", 2400}, {"2", 2300}};
+    for (const char *factor: {"1", "1.2", "1.5", "2"}) {
+        const auto before = astar.totals();
+        const auto factor_st = std::chrono::steady_clock::now();
+        for (const auto &[start, goal]: pairs) (void) astar.get_path(start, goal, {{"suboptimality", factor}});
+        const double factor_seconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - factor_st).count();
+        const auto after = astar.totals();
+        std::cerr << "A* suboptimality " << factor << ": " << factor_seconds / queries * 1e6 << " us/query, "
+                << static_cast<double>(after.settled - before.settled) / queries << " settled, "
+                << static_cast<double>(after.relaxed - before.relaxed) / queries << " relaxed per query" << std::endl;
+        ASSERT_LT(static_cast<double>(after.settled - before.settled) / queries, max_settled.at(factor));
+    }
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include "../LayeredAStarPathfinder.h"
+#include "../SearchWorkspace.h"
+#include "TestGrid.h"
+#include <random>
+
+using namespace Foliage;
+
+TEST(SearchWorkspace, NewSearchForgetsThePreviousOne) {
+    using Workspace = Pathfinder::SearchWorkspace;
+    Workspace workspace;
+    workspace.reset(10);
+    const auto state = workspace.reach(0, 3, 30);
+    auto &label = workspace(0, state);
+    label.g_score = 5;
+    label.parent = 7;
+    label.closed = true;
+    workspace.push(0, 5, state);
+    ASSERT_TRUE(workspace.reached(0, 3, 30));
+    ASSERT_FALSE(workspace.reached(1, 3, 30));
+    ASSERT_EQ(state, workspace.reach(0, 3, 30)); // Already reached: kept
+    ASSERT_EQ(5, workspace(0, state).g_score);
+
+    // Another arrival at the same node is a state of its own
+    const auto other = workspace.reach(0, 3, 31);
+    ASSERT_NE(state, other);
+    ASSERT_EQ(other, workspace.find(0, 3, 31));
+    ASSERT_EQ(state, workspace.find(0, 3, 30));
+    ASSERT_EQ(2u, workspace.size(0));
+
+    // A smaller graph keeps the table, a larger one grows it
+    workspace.reset(4);
+    ASSERT_FALSE(workspace.reached(0, 3, 30));
+    ASSERT_TRUE(workspace.empty(0));
+    ASSERT_EQ(0u, workspace.size(0));
+    const auto &fresh = workspace(0, workspace.reach(0, 3, 30));
+    ASSERT_FALSE(fresh.closed);
+    ASSERT_TRUE(std::isinf(fresh.g_score));
+    ASSERT_EQ(Workspace::none, fresh.parent);
+    workspace.reset(20);
+    ASSERT_EQ(0u, workspace.reach(1, 19, 5));
+}
+
+// On roads of one class the layered costs are the profile weights halved, so paths can be checked against Dijkstra
+TEST(SearchWorkspace, AStarStopsAtTheCheapestPathOrWithinTheFactor) {
+    const int side = 40;
+    std::mt19937 random(21);
+    // Without a segment index queries snap onto nodes, so that a path is nothing but graph edges
+    Pathfinder::LayeredAStarPathfinder astar(std::make_shared<const Graph::RoutingGraph>(
+        Graph::RoutingGraph::build(Fixtures::grid(side, random, {"primary"}, 0.0004))));
+    const auto &graph = *astar.graph;
+    const auto weights = astar.profiles->get({});
+    auto cost_of = [&](const std::vector<std::shared_ptr<const ObjectType::Node>> &path) {
+        double total = 0;
+        for (size_t i = 0; i + 1 < path.size(); ++i) {
+            const auto from = graph.index_of(path[i]->id), to = graph.index_of(path[i + 1]->id);
+            double cheapest = std::numeric_limits<double>::infinity();
+            for (auto edge = graph.edges_begin(from); edge < graph.edges_end(from); ++edge) {
+                if (graph.edge_targets[edge] == to) cheapest = std::min<double>(cheapest, (*weights)[edge]);
+            }
+            total += cheapest;
+        }
+        return total;
+    };
+
+    uint64_t settled_optimal = 0, settled_bounded = 0;
+    for (int query = 0; query < 100; ++query) {
+        const auto source = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        const auto target = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        if (source == target) continue;
+        const double expected = Fixtures::distances(graph, *weights, source, target)[target];
+
+        const auto path = astar.get_path(graph.position(source), graph.position(target), {});
+        settled_optimal += Pathfinder::SearchWorkspace::local().stats().settled;
+        ASSERT_EQ(graph.index_of(path.front()->id), source);
+        ASSERT_EQ(graph.index_of(path.back()->id), target);
+        ASSERT_NEAR(cost_of(path), expected, expected * 1e-6) << source << " -> " << target;
+
+        const auto bounded = astar.get_path(graph.position(source), graph.position(target), {{"suboptimality", "1.5"}});
+        settled_bounded += Pathfinder::SearchWorkspace::local().stats().settled;
+        ASSERT_LE(cost_of(bounded), 1.5 * expected * (1 + 1e-6));
+    }
+    ASSERT_LT(settled_bounded, settled_optimal);
+    const auto totals = astar.totals();
+    ASSERT_GT(totals.searches, 0u);
+    ASSERT_GE(totals.relaxed, totals.settled);
+    ASSERT_EQ(0u, totals.unreachable);
+    ASSERT_THROW((void) astar.get_path(graph.position(0), graph.position(1), {{"suboptimality", "0.9"}}),
+                 std::invalid_argument);
+}
+
+// Oneways on roads of several classes, against Dijkstra over the states of the layered search: the arrival at a
+// node by an edge, since what the next edge costs depends on the class of road that led there
+TEST(SearchWorkspace, AStarFollowsOnewaysAcrossRoadClasses) {
+    {
+        // Around the oneway ring 1 -> 2 -> 3 -> 4 -> 1, from 1 to 4 is the long way
+        std::vector<std::shared_ptr<const ObjectType::Node>> ring;
+        const double corners[][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+        for (int64_t id = 1; id <= 4; ++id) {
+            auto node = std::make_shared<ObjectType::Node>(id);
+            node->position = Geometry::Position(31 + corners[id - 1][0] * 0.001, 121 + corners[id - 1][1] * 0.001);
+            ring.push_back(node);
+        }
+        auto way = std::make_shared<ObjectType::Way>(1);
+        way->nodes = {ring[0], ring[1], ring[2], ring[3], ring[0]};
+        way->tags = {{"highway", "residential"}, {"oneway", "yes"}};
+        Pathfinder::LayeredAStarPathfinder astar(
+            std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build({way})));
+        std::vector<int64_t> ids;
+        for (const auto &node: astar.get_path(ring[0]->position, ring[3]->position, {})) ids.push_back(node->id);
+        ASSERT_EQ(ids, (std::vector<int64_t>{1, 2, 3, 4}));
+    }
+
+    const int side = 30;
+    std::mt19937 random(17);
+    Pathfinder::LayeredAStarPathfinder astar(std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(
+        Fixtures::grid(side, random, {"primary", "secondary", "tertiary", "residential"}, 0.0004, 0.3))));
+    const auto &graph = *astar.graph;
+    const auto weights = astar.profiles->get({});
+    auto highway_of = [&](Graph::EdgeIndex edge) { return graph.attributes[graph.edge_attributes[edge]].highway; };
+    auto layered_cost_of = [&](const std::vector<std::shared_ptr<const ObjectType::Node>> &path) {
+        double total = 0;
+        auto previous = Graph::HighwayClass::Other;
+        for (size_t i = 0; i + 1 < path.size(); ++i) {
+            const auto from = graph.index_of(path[i]->id), to = graph.index_of(path[i + 1]->id);
+            auto taken = Graph::invalid_edge;
+            for (auto edge = graph.edges_begin(from); edge < graph.edges_end(from); ++edge) {
+                if (graph.edge_targets[edge] == to && std::isfinite((*weights)[edge])) taken = edge;
+            }
+            if (taken == Graph::invalid_edge) return std::numeric_limits<double>::infinity();
+            total += Pathfinder::LayeredAStarPathfinder::step_cost(previous, highway_of(taken), (*weights)[taken]);
+            previous = highway_of(taken);
+        }
+        return total;
+    };
+    auto step_cost = [&](Graph::EdgeIndex arrival, Graph::EdgeIndex edge) {
+        const auto previous = arrival == Graph::invalid_edge ? Graph::HighwayClass::Other : highway_of(arrival);
+        return Pathfinder::LayeredAStarPathfinder::step_cost(previous, highway_of(edge), (*weights)[edge]);
+    };
+
+    int routed = 0;
+    for (int query = 0; query < 150; ++query) {
+        const auto source = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        const auto target = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        const double expected = Fixtures::arrival_distances(graph, source, step_cost, target)[target];
+        if (source == target || std::isinf(expected)) continue;
+        ++routed;
+
+        const auto path = astar.get_path(graph.position(source), graph.position(target), {});
+        ASSERT_FALSE(path.empty()) << source << " -> " << target;
+        ASSERT_EQ(graph.index_of(path.front()->id), source);
+        ASSERT_EQ(graph.index_of(path.back()->id), target);
+        ASSERT_NEAR(layered_cost_of(path), expected, expected * 1e-6) << source << " -> " << target;
+
+        const auto bounded = astar.get_path(graph.position(source), graph.position(target), {{"suboptimality", "1.5"}});
+        ASSERT_LE(layered_cost_of(bounded), 1.5 * expected * (1 + 1e-6)) << source << " -> " << target;
+    }
+    ASSERT_GT(routed, 100);
+}
+
+// Arrivals at a node by roads of one class go on at the same costs, so the search keeps them as one state, at the
+// first edge of that class into the node
+TEST(SearchWorkspace, AStarSettlesArrivalsByClassOfRoad) {
+    const int side = 30;
+    std::mt19937 random(5);
+    Pathfinder::LayeredAStarPathfinder astar(std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(
+        Fixtures::grid(side, random, {"primary", "secondary", "tertiary", "residential"}, 0.0004))));
+    const auto &graph = *astar.graph;
+    // Without oneways, each class has one attribute record
+    auto first_arrival = [&](Graph::EdgeIndex edge) {
+        const auto node = graph.edge_targets[edge];
+        for (auto out = graph.edges_begin(node); out < graph.edges_end(node); ++out) {
+            if (graph.edge_attributes[graph.edge_twins[out]] == graph.edge_attributes[edge]) {
+                return graph.edge_twins[out];
+            }
+        }
+        return edge;
+    };
+
+    for (int query = 0; query < 20; ++query) {
+        const auto source = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        const auto target = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        (void) astar.get_path(graph.position(source), graph.position(target), {});
+        auto &workspace = Pathfinder::SearchWorkspace::local();
+        size_t reached = 0;
+        for (const int search_side: {0, 1}) {
+            for (uint32_t state = 0; state < workspace.size(search_side); ++state) {
+                const auto edge = workspace(search_side, state).edge;
+                ++reached;
+                ASSERT_EQ(first_arrival(edge), edge);
+                ASSERT_EQ(state, workspace.find(search_side, graph.edge_targets[edge], edge));
+            }
+        }
+        ASSERT_GE(reached, workspace.stats().settled);
+    }
+}
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "../FlatQuadTree.h"
+#include "../SegmentIndex.h"
+#include "../ThreadPool.h"
+#include "TestGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace Foliage;
+
+// Snaps a batch of points onto nodes and onto segments, one at a time and spread over the thread pool
+TEST(SegmentIndexBenchmark, BatchSnappingThroughput) {
+    std::mt19937 random(17);
+    const auto graph = Graph::RoutingGraph::build(
+        Fixtures::grid(60, random, {"secondary", "residential", "residential", "footway"}, 0.0002));
+    const auto index = Graph::SegmentIndex::build(graph);
+    const auto tree = Util::FlatQuadTree::build(graph.latitudes, graph.longitudes, graph.projection);
+    const Graph::ProfileWeights car(Graph::RoutingProfile::car(), graph);
+    std::vector<Geometry::Position> points(50000);
+    for (auto &point: points) point = {31 + (random() % 6000) * 1e-5, 121 + (random() % 6000) * 1e-5};
+
+    auto seconds_for = [&](auto &&snap) {
+        const auto st = std::chrono::steady_clock::now();
+        snap();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+    };
+    std::vector<Graph::EdgeIndex> sequential(points.size()), parallel(points.size());
+    const double node_seconds = seconds_for([&] {
+        std::vector<Util::FlatQuadTree::Neighbor> nearest;
+        for (const auto &point: points) {
+            tree.nearest(point, 1, 1000, [&](uint32_t node) { return car.routable[node]; }, nearest);
+        }
+    });
+    const double segment_seconds = seconds_for([&] {
+        for (size_t i = 0; i < points.size(); ++i) sequential[i] = index.nearest(graph, points[i], 1000, car)->forward;
+    });
+    const size_t batch = 1024;
+    const double parallel_seconds = seconds_for([&] {
+        Util::ThreadPool::shared().parallel_for((points.size() + batch - 1) / batch, [&](size_t block) {
+            for (size_t i = block * batch; i < std::min(points.size(), (block + 1) * batch); ++i) {
+                parallel[i] = index.nearest(graph, points[i], 1000, car)->forward;
+            }
+        });
+    });
+    std::cerr << "Nodes:    " << points.size() / node_seconds / 1e3 << " k points/s" << std::endl;
+    std::cerr << "Segments: " << points.size() / segment_seconds / 1e3 << " k points/s, "
+            << points.size() / parallel_seconds / 1e3 << " k points/s on " << Util::ThreadPool::shared().size()
+            << " threads" << std::endl;
+    ASSERT_EQ(sequential, parallel);
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include "../ContractionHierarchyPathfinder.h"
+#include "../SegmentIndex.h"
+#include "../ThreadPool.h"
+#include "TestGrid.h"
+#include <functional>
+#include <random>
+
+using namespace Foliage;
+
+using Path = std::vector<std::shared_ptr<const ObjectType::Node>>;
+
+// Jittered grid of side x side nodes: secondary roads north to south, residential streets and footways west to east,
+// and long diagonal roads across some of the blocks
+class SegmentIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 random(17);
+        // Id 0 marks projected points
+        auto ways = Fixtures::grid(side, random, {"secondary"}, 0.0002, 0, 1);
+        nodes.resize(side * side);
+        for (const auto &way: ways) {
+            for (const auto &node: way->nodes) nodes[node->id - 1] = node;
+            const bool west_to_east = way->nodes[1]->id == way->nodes[0]->id + 1;
+            if (west_to_east) way->tags["highway"] = random() % 4 ? "residential" : "footway";
+        }
+        for (int i = 0; i < side * side; ++i) {
+            if (i % side + 1 < side && i + side < side * side && random() % 6 == 0) {
+                auto way = std::make_shared<ObjectType::Way>(static_cast<int64_t>(ways.size()));
+                way->nodes = {nodes[i], nodes[i + side + 1]};
+                way->tags = {{"highway", "primary"}};
+                ways.push_back(way);
+            }
+        }
+        graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(ways));
+        index = Graph::SegmentIndex::build(*graph);
+    }
+
+    std::optional<Graph::EdgePoint> brute_force(Geometry::Position position, double max_distance,
+                                                const Graph::ProfileWeights *weights) const {
+        std::optional<Graph::EdgePoint> best;
+        for (const auto &segment: index.segments) {
+            if (weights && std::isinf((*weights)[segment.forward]) && std::isinf((*weights)[segment.backward])) {
+                continue;
+            }
+            const auto point = Graph::SegmentIndex::project(*graph, segment, position);
+            if (point.distance > max_distance) continue;
+            if (!best || point.distance < best->distance ||
+                (point.distance == best->distance && point.forward < best->forward)) {
+                best = point;
+            }
+        }
+        return best;
+    }
+
+    const int side = 60;
+    std::vector<std::shared_ptr<const ObjectType::Node>> nodes;
+    std::shared_ptr<const Graph::RoutingGraph> graph;
+    Graph::SegmentIndex index;
+};
+
+TEST_F(SegmentIndexTest, NearestMatchesBruteForce) {
+    ASSERT_EQ(index.segments.size() * 2, graph->edge_count());
+    const Graph::ProfileWeights car(Graph::RoutingProfile::car(), *graph);
+    std::mt19937 random(5);
+    for (int query = 0; query < 300; ++query) {
+        const Geometry::Position position(30.99 + (random() % 8000) * 1e-5, 120.99 + (random() % 8000) * 1e-5);
+        const double max_distance = random() % 200; // Metres; blocks are about 100 m wide
+        const auto any = index.nearest(*graph, position, max_distance, [](const auto &) { return true; });
+        const auto expected = brute_force(position, max_distance, nullptr);
+        ASSERT_EQ(any.has_value(), expected.has_value());
+        if (any) {
+            ASSERT_EQ(any->forward, expected->forward);
+            ASSERT_EQ(any->distance, expected->distance);
+        }
+
+        // Footways are skipped for cars
+        const auto drivable = index.nearest(*graph, position, max_distance, car);
+        const auto expected_drivable = brute_force(position, max_distance, &car);
+        ASSERT_EQ(drivable.has_value(), expected_drivable.has_value());
+        if (drivable) {
+            ASSERT_EQ(drivable->forward, expected_drivable->forward);
+        }
+    }
+}
+
+TEST_F(SegmentIndexTest, ProjectsOntoTheSegment) {
+    const auto from = graph->index_of(1), to = graph->index_of(side + 1);
+    const auto a = graph->position(from), b = graph->position(to);
+    const Geometry::Position middle((a.latitude + b.latitude) / 2, (a.longitude + b.longitude) / 2);
+    const auto point = index.nearest(*graph, Geometry::Position(middle.latitude, middle.longitude - 1e-4), 100,
+                                     [](const auto &) { return true; });
+    ASSERT_TRUE(point.has_value());
+    ASSERT_EQ(point->from, from);
+    ASSERT_EQ(point->to, to);
+    ASSERT_NEAR(point->fraction, 0.5, 0.05);
+    ASSERT_NEAR(point->position.latitude, middle.latitude, 1e-4);
+
+    const Graph::ProfileWeights car(Graph::RoutingProfile::car(), *graph);
+    const auto departures = point->departures(car);
+    ASSERT_EQ(departures.size(), 2);
+    ASSERT_FLOAT_EQ(departures[0].cost + departures[1].cost, car[point->forward]);
+}
+
+TEST_F(SegmentIndexTest, PathsStartAndEndOnTheRoad) {
+    auto astar = std::make_shared<Pathfinder::LayeredAStarPathfinder>(graph);
+    astar->segments = std::make_shared<const Graph::SegmentIndex>(index);
+    Pathfinder::ContractionHierarchyPathfinder ch(astar);
+    ch.build({{{"profile", "car"}}});
+
+    // Just west of a point part of the way along the secondary road from node a to node b
+    const auto along = [&](int a, int b, double fraction) {
+        const auto &p = nodes[a]->position, &q = nodes[b]->position;
+        return Geometry::Position(p.latitude + fraction * (q.latitude - p.latitude),
+                                  p.longitude + fraction * (q.longitude - p.longitude) - 2e-5);
+    };
+    const std::function<Path(Geometry::Position, Geometry::Position)> pathfinders[] = {
+        [&](auto start, auto end) { return astar->get_path(start, end, {}); },
+        [&](auto start, auto end) { return ch.get_path(start, end, {}); }
+    };
+    for (const auto &get_path: pathfinders) {
+        const auto path = get_path(along(0, side, 0.5), along(2, 2 + side, 0.5));
+        ASSERT_GE(path.size(), 4);
+        ASSERT_EQ(path.front()->id, 0) << "The route starts at the projected point";
+        ASSERT_EQ(path.back()->id, 0);
+        ASSERT_NEAR(path.front()->position.longitude, nodes[0]->position.longitude, 1e-4);
+        ASSERT_TRUE(path[1]->id == 1 || path[1]->id == side + 1);
+
+        // Both points on one segment: straight along it
+        const auto direct = get_path(along(0, side, 0.5), along(0, side, 0.25));
+        ASSERT_EQ(direct.size(), 2);
+        ASSERT_LT(direct.back()->position.latitude, direct.front()->position.latitude);
+    }
+}
+
+TEST_F(SegmentIndexTest, TableMatchesOneToOneQueries) {
+    auto astar = std::make_shared<Pathfinder::LayeredAStarPathfinder>(graph);
+    astar->segments = std::make_shared<const Graph::SegmentIndex>(index);
+    Pathfinder::ContractionHierarchyPathfinder ch(astar);
+    ch.build({{{"profile", "car"}}});
+    const auto car = astar->profiles->get({});
+
+    std::mt19937 random(17);
+    std::vector<Geometry::Position> points(12);
+    for (auto &point: points) point = {31 + (random() % 6000) * 1e-5, 121 + (random() % 6000) * 1e-5};
+    points.push_back({50, 50}); // Off the network
+    const auto costs = ch.table(points, points, {});
+    for (size_t s = 0; s < points.size(); ++s) {
+        for (size_t t = 0; t < points.size(); ++t) {
+            const auto terminals = astar->locate(points[s], points[t], *car, astar->max_snap_distance);
+            float expected = std::numeric_limits<float>::infinity();
+            if (terminals && !terminals->direct) {
+                (void) ch.hierarchies.at("car")->shortest_path(terminals->sources, terminals->targets, &expected);
+            }
+            if (terminals && terminals->direct) {
+                ASSERT_LE(costs[s * points.size() + t], car->weights[terminals->start->forward]);
+            } else if (std::isinf(expected)) {
+                ASSERT_TRUE(std::isinf(costs[s * points.size() + t]));
+            } else {
+                ASSERT_NEAR(costs[s * points.size() + t], expected, expected * 1e-4);
+            }
+        }
+    }
+    ASSERT_THROW((void) ch.table(points, points, {{"profile", "foot"}}), std::invalid_argument);
+}
+
+// Snapping a batch spread over the thread pool gives the same segments as one point at a time
+TEST_F(SegmentIndexTest, BatchSnapsLikeOneAtATime) {
+    const Graph::ProfileWeights car(Graph::RoutingProfile::car(), *graph);
+    std::mt19937 random(11);
+    std::vector<Geometry::Position> points(2000);
+    for (auto &point: points) point = {31 + (random() % 6000) * 1e-5, 121 + (random() % 6000) * 1e-5};
+
+    std::vector<Graph::EdgeIndex> sequential(points.size()), parallel(points.size());
+    for (size_t i = 0; i < points.size(); ++i) sequential[i] = index.nearest(*graph, points[i], 1000, car)->forward;
+    const size_t batch = 64;
+    Util::ThreadPool::shared().parallel_for((points.size() + batch - 1) / batch, [&](size_t block) {
+        for (size_t i = block * batch; i < std::min(points.size(), (block + 1) * batch); ++i) {
+            parallel[i] = index.nearest(*graph, points[i], 1000, car)->forward;
+        }
+    });
+    ASSERT_EQ(sequential, parallel);
+}
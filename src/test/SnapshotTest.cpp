@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include "../Snapshot.h"
+#include "TestGrid.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+using namespace Foliage;
+
+// Small grid of streets with a few tags, compiled and contracted for the car profile
+class SnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 random(5);
+        auto ways = Fixtures::grid(side, random, {"primary", "secondary", "residential"}, 0, 0.25, 1000);
+        for (const auto &way: ways) way->tags["name"] = "Street " + std::to_string(random() % 7);
+        auto graph = std::make_shared<const Graph::RoutingGraph>(Graph::RoutingGraph::build(ways));
+        profiles = std::make_shared<Graph::ProfileSet>(graph, 8, 4);
+        original.bounds = Geometry::BoundingBox({31, 121}, {31.1, 121.1});
+        original.graph = graph;
+        original.node_tree = std::make_shared<const Util::FlatQuadTree>(Util::FlatQuadTree::build(graph->latitudes, graph->longitudes, graph->projection));
+        original.segments = std::make_shared<const Graph::SegmentIndex>(Graph::SegmentIndex::build(*graph));
+        const auto car = profiles->get({});
+        original.landmarks["car"] = car->landmarks;
+        original.hierarchies["car"] = std::make_shared<const Graph::ContractionHierarchy>(
+            Graph::ContractionHierarchy::build(*graph, *car));
+        path = (std::filesystem::temp_directory_path() / ("foliage_" + std::to_string(::getpid()) + ".snapshot"))
+                .string();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(path);
+    }
+
+    template<class T>
+    static bool equal(const Util::Buffer<T> &a, const Util::Buffer<T> &b) {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+    }
+
+    const int side = 12;
+    std::shared_ptr<Graph::ProfileSet> profiles;
+    Graph::Snapshot original;
+    std::string path;
+};
+
+TEST_F(SnapshotTest, RoundTrip) {
+    original.write(path);
+    const auto loaded = Graph::Snapshot::load(path);
+
+    const auto &graph = *loaded.graph;
+    ASSERT_TRUE(graph.edge_targets.is_view()) << "Arrays should point into the mapping";
+    ASSERT_TRUE(loaded.node_tree->cells.is_view());
+    ASSERT_TRUE(equal(graph.node_ids, original.graph->node_ids));
+    ASSERT_TRUE(equal(graph.latitudes, original.graph->latitudes));
+    ASSERT_TRUE(equal(graph.longitudes, original.graph->longitudes));
+    ASSERT_EQ(graph.projection.metres_per_longitude, original.graph->projection.metres_per_longitude);
+    ASSERT_TRUE(equal(graph.edge_offsets, original.graph->edge_offsets));
+    ASSERT_TRUE(equal(graph.edge_targets, original.graph->edge_targets));
+    ASSERT_TRUE(equal(graph.edge_lengths, original.graph->edge_lengths));
+    ASSERT_TRUE(equal(graph.edge_twins, original.graph->edge_twins));
+    ASSERT_TRUE(equal(graph.attributes, original.graph->attributes));
+    ASSERT_EQ(loaded.bounds.max_position, original.bounds.max_position);
+    ASSERT_EQ(graph.index_of(1005), 5);
+
+    // Tag lookups go through the mapped dictionary
+    for (uint32_t attribute = 0; attribute < graph.attributes.size(); ++attribute) {
+        ASSERT_EQ(graph.tag(attribute, "name"), original.graph->tag(attribute, "name"));
+        ASSERT_EQ(graph.tag(attribute, "highway"), original.graph->tag(attribute, "highway"));
+    }
+    ASSERT_EQ(graph.tags.find("no such tag"), Util::invalid_tag);
+
+    // A profile set over the mapped graph reuses the stored landmarks, since the weights are the same
+    Graph::ProfileSet mapped_profiles(loaded.graph, 8, 4, loaded.landmarks);
+    ASSERT_EQ(mapped_profiles.get({})->landmarks, loaded.landmarks.at("car"));
+    ASSERT_NE(mapped_profiles.get({{"profile", "foot"}})->landmarks, nullptr);
+
+    const auto &hierarchy = *loaded.hierarchies.at("car");
+    ASSERT_EQ(hierarchy.weights_checksum, profiles->get({})->checksum);
+    std::mt19937 random(9);
+    for (int query = 0; query < 50; ++query) {
+        const auto source = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        const auto target = static_cast<Graph::NodeIndex>(random() % graph.node_count());
+        ASSERT_EQ(hierarchy.shortest_path(source, target), original.hierarchies.at("car")->shortest_path(source, target));
+
+        const Geometry::Position position(31 + (random() % 1200) * 1e-5, 121 + (random() % 1200) * 1e-5);
+        ASSERT_EQ(loaded.node_tree->nearest(position, 500), original.node_tree->nearest(position, 500));
+        const auto point = loaded.segments->nearest(graph, position, 500, *profiles->get({}));
+        ASSERT_TRUE(point.has_value());
+        ASSERT_EQ(point->forward, original.segments->nearest(graph, position, 500, *profiles->get({}))->forward);
+    }
+}
+
+TEST_F(SnapshotTest, RejectsDamagedFiles) {
+    original.write(path);
+    const auto size = std::filesystem::file_size(path);
+    {
+        // Flip a byte of the last section, which ends the file
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(size - 4));
+        char byte;
+        file.read(&byte, 1);
+        byte = static_cast<char>(~byte);
+        file.seekp(static_cast<std::streamoff>(size - 4));
+        file.write(&byte, 1);
+    }
+    ASSERT_THROW(Graph::Snapshot::load(path), std::runtime_error);
+
+    std::filesystem::resize_file(path, 100);
+    ASSERT_THROW(Graph::Snapshot::load(path, false), std::runtime_error);
+
+    std::ofstream(path, std::ios::trunc) << "<osm version=\"0.6\"></osm>";
+    ASSERT_THROW(Graph::Snapshot::load(path), std::runtime_error);
+    ASSERT_THROW(Graph::Snapshot::load(path + ".missing"), std::runtime_error);
+}
+
+// Checksums only catch damage after writing; values that would index out of bounds are rejected on their own
+TEST_F(SnapshotTest, RejectsInconsistentGraphs) {
+    const auto tamper = [&](auto &&change) {
+        auto graph = *original.graph;
+        change(graph);
+        auto snapshot = original;
+        snapshot.graph = std::make_shared<const Graph::RoutingGraph>(std::move(graph));
+        snapshot.write(path);
+        return Graph::Snapshot::load(path, false);
+    };
+    const auto nodes = static_cast<Graph::NodeIndex>(original.graph->node_count());
+    ASSERT_THROW(tamper([&](Graph::RoutingGraph &graph) { graph.edge_targets[3] = nodes; }), std::runtime_error);
+    ASSERT_THROW(tamper([](Graph::RoutingGraph &graph) { graph.edge_attributes[0] = graph.attributes.size(); }),
+                 std::runtime_error);
+    ASSERT_THROW(tamper([](Graph::RoutingGraph &graph) { std::swap(graph.edge_offsets[1], graph.edge_offsets[2]); }),
+                 std::runtime_error);
+    ASSERT_THROW(tamper([](Graph::RoutingGraph &graph) { graph.edge_twins[0] = graph.edge_twins[1]; }),
+                 std::runtime_error);
+    ASSERT_NO_THROW(tamper([](Graph::RoutingGraph &) {}));
+}
+
+// The same for the indexes and tables stored beside the graph
+TEST_F(SnapshotTest, RejectsInconsistentIndexes) {
+    const auto tamper = [&](auto &&change) {
+        auto snapshot = original;
+        change(snapshot);
+        snapshot.write(path);
+        return Graph::Snapshot::load(path, false);
+    };
+    auto hierarchy = [](Graph::Snapshot &snapshot) {
+        auto copy = std::make_shared<Graph::ContractionHierarchy>(*snapshot.hierarchies.at("car"));
+        snapshot.hierarchies["car"] = copy;
+        return copy;
+    };
+    const auto nodes = static_cast<Graph::NodeIndex>(original.graph->node_count());
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) { hierarchy(snapshot)->up_arcs[0].target = nodes; }),
+                 std::runtime_error);
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) { hierarchy(snapshot)->down_arcs[0].target = nodes; }),
+                 std::runtime_error);
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        const auto copy = hierarchy(snapshot);
+        const auto shortcut = std::ranges::find_if(copy->up_arcs, [](const auto &arc) {
+            return arc.middle != Graph::invalid_node;
+        });
+        ASSERT_NE(shortcut, copy->up_arcs.end());
+        shortcut->middle = nodes;
+    }), std::runtime_error);
+    // A shortcut bypassing one of its own ends would unpack forever
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        const auto copy = hierarchy(snapshot);
+        copy->up_arcs[0].middle = copy->up_arcs[0].target;
+    }), std::runtime_error);
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        auto table = std::make_shared<Graph::LandmarkTable>(*snapshot.landmarks.at("car"));
+        table->landmarks[0] = nodes;
+        snapshot.landmarks["car"] = table;
+    }), std::runtime_error);
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        auto segments = std::make_shared<Graph::SegmentIndex>(*snapshot.segments);
+        segments->level_offsets[1] += 1;
+        snapshot.segments = segments;
+    }), std::runtime_error);
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        auto graph = std::make_shared<Graph::RoutingGraph>(*snapshot.graph);
+        graph->tags.offsets[graph->tags.size()] += 1;
+        snapshot.graph = graph;
+    }), std::runtime_error);
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        auto tree = std::make_shared<Util::FlatQuadTree>(*snapshot.node_tree);
+        tree->items[0] = nodes;
+        snapshot.node_tree = tree;
+    }), std::runtime_error);
+    // A cell pointing back at cells before it would send the walk down the tree round in circles
+    ASSERT_THROW(tamper([&](Graph::Snapshot &snapshot) {
+        auto tree = std::make_shared<Util::FlatQuadTree>(*snapshot.node_tree);
+        ASSERT_GT(tree->cells.size(), 5u);
+        tree->cells[tree->cells.size() - 1].first_child = 1;
+        snapshot.node_tree = tree;
+    }), std::runtime_error);
+    ASSERT_NO_THROW(tamper([](Graph::Snapshot &) {}));
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "../TaskRegistry.h"
+#include "../WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace Foliage;
+using Status = Util::TaskRegistry::Status;
+
+// Workers create, run and finish tasks while pollers read random recent ones, under a tight memory cap
+TEST(TaskRegistryBenchmark, StressMillionsOfTasks) {
+    const size_t threads = 4, per_thread = 500000, max_bytes = size_t{4} << 20;
+    Util::TaskRegistry registry({.max_bytes = max_bytes});
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> found{0};
+    std::atomic<size_t> peak_bytes{0};
+
+    auto st = std::chrono::steady_clock::now();
+    std::vector<std::thread> pollers;
+    for (size_t t = 0; t < 2; ++t) {
+        pollers.emplace_back([&, t] {
+            std::mt19937 random(static_cast<unsigned>(t));
+            while (!done) {
+                const auto created = registry.stats().created;
+                if (created == 0) continue;
+                const auto id = "task_" + std::to_string(created - 1 - random() % std::min<uint64_t>(created, 10000));
+                if (registry.status(id) != Status::NotFound && registry.result(id)) ++found;
+                size_t bytes = registry.stats().bytes, peak = peak_bytes;
+                while (bytes > peak && !peak_bytes.compare_exchange_weak(peak, bytes)) {
+                }
+            }
+        });
+    }
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            const std::string result(100, 'r');
+            for (size_t i = 0; i < per_thread; ++i) {
+                const auto task = registry.create();
+                task.start();
+                task.finish(i % 16 == 0 ? Status::Failed : Status::Success, result);
+            }
+        });
+    }
+    for (auto &worker: workers) worker.join();
+    done = true;
+    for (auto &poller: pollers) poller.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+    const auto stats = registry.stats();
+    std::cerr << "TaskRegistry: " << threads * per_thread / seconds / 1e6 << " M tasks/s, " << stats.tasks
+            << " kept, " << stats.evicted << " evicted, " << found << " results read, peak "
+            << peak_bytes / 1024 << " KiB" << std::endl;
+    ASSERT_EQ(threads * per_thread, stats.created);
+    ASSERT_EQ(stats.created, stats.tasks + stats.evicted + stats.expired);
+    // Every shard may hold its newest result past its budget
+    ASSERT_LE(peak_bytes.load(), max_bytes + 64 * 1024);
+    ASSERT_GT(found.load(), 0u);
+}
+
+// End-to-end latency of a 1 ms query as a client sees it: submitted to the pool, then learned about by
+// polling the status every 10 ms, by long polling it, or by waiting on the task as /api/route does
+TEST(TaskRegistryBenchmark, LatencyOfPollingAndWaiting) {
+    Util::TaskRegistry registry;
+    Util::WorkerPool pool(2);
+    const auto forever = [] { return std::chrono::steady_clock::now() + std::chrono::seconds(10); };
+    auto measure = [&](const char *mode, const std::function<Status(const Util::TaskRegistry::Handle &)> &learn) {
+        std::vector<double> latencies;
+        for (int i = 0; i < 100; ++i) {
+            const auto st = std::chrono::steady_clock::now();
+            const auto task = registry.create();
+            pool.submit(Util::WorkerPool::Lane::Query, [task] {
+                task.start();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                task.finish(Status::Success, "{}");
+            });
+            EXPECT_EQ(Status::Success, learn(task));
+            EXPECT_NE(nullptr, registry.result(task.id()));
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - st).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0;
+        for (const double latency: latencies) sum += latency;
+        std::cerr << "TaskRegistry " << mode << ": mean " << sum / latencies.size() << " ms, p50 "
+                << latencies[latencies.size() / 2] << " ms, p99 " << latencies[latencies.size() * 99 / 100]
+                << " ms" << std::endl;
+        return sum / latencies.size();
+    };
+
+    const double polled = measure("polling every 10 ms", [&](const auto &task) {
+        Status status;
+        while ((status = registry.status(task.id())) == Status::InQueue || status == Status::Running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return status;
+    });
+    const double long_polled = measure("long polling", [&](const auto &task) {
+        return registry.wait(task.id(), forever());
+    });
+    const double waited = measure("waiting inline", [&](const auto &task) { return task.wait(forever()); });
+    ASSERT_LT(long_polled, polled);
+    ASSERT_LT(waited, polled);
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "../TaskRegistry.h"
+#include <chrono>
+#include <thread>
+
+using namespace Foliage;
+using Status = Util::TaskRegistry::Status;
+
+TEST(TaskRegistry, FollowsATaskThroughItsStates) {
+    Util::TaskRegistry registry;
+    const auto task = registry.create();
+    ASSERT_EQ(Status::InQueue, registry.status(task.id()));
+    ASSERT_EQ(nullptr, registry.result(task.id()));
+    task.start();
+    ASSERT_EQ(Status::Running, registry.status(task.id()));
+    task.finish(Status::Success, "{}");
+    ASSERT_EQ(Status::Success, registry.status(task.id()));
+    ASSERT_EQ("{}", *registry.result(task.id()));
+    ASSERT_THROW(task.finish(Status::Failed, "{}"), std::logic_error);
+
+    for (const auto *id: {"task_", "task_99", "task_1x", "1", ""}) ASSERT_EQ(Status::NotFound, registry.status(id));
+}
+
+TEST(TaskRegistry, ExpiresUnreadResults) {
+    Util::TaskRegistry registry({.ttl = std::chrono::milliseconds(20), .shards = 4});
+    const auto finished = registry.create(), running = registry.create();
+    finished.finish(Status::Failed, "{\"error\": \"\"}");
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    ASSERT_EQ(Status::NotFound, registry.status(finished.id()));
+    ASSERT_EQ(Status::InQueue, registry.status(running.id())); // Unfinished tasks never expire
+    ASSERT_EQ(1u, registry.stats().expired);
+    ASSERT_EQ(1u, registry.stats().tasks);
+}
+
+// A lookup holds the shard lock for a few evictions only, however many tasks have expired
+TEST(TaskRegistry, EvictsAFewTasksPerLookup) {
+    Util::TaskRegistry registry({
+        .ttl = std::chrono::milliseconds(20), .shards = 1, .sweep_interval = std::chrono::hours(1)
+    });
+    const auto running = registry.create();
+    for (int i = 0; i < 100; ++i) registry.create().finish(Status::Success, "{}");
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    ASSERT_EQ(Status::InQueue, registry.status(running.id()));
+    ASSERT_GE(registry.stats().expired, 1u);
+    ASSERT_LE(registry.stats().expired, 4u);
+    ASSERT_GE(registry.stats().tasks, 96u);
+}
+
+// With nothing looking tasks up, the sweeper expires them
+TEST(TaskRegistry, SweepsIdleShards) {
+    Util::TaskRegistry registry({
+        .ttl = std::chrono::milliseconds(20), .shards = 4, .sweep_interval = std::chrono::milliseconds(10)
+    });
+    for (int i = 0; i < 8; ++i) registry.create().finish(Status::Success, "{}");
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (registry.stats().tasks > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(0u, registry.stats().tasks);
+    ASSERT_EQ(8u, registry.stats().expired);
+}
+
+TEST(TaskRegistry, EvictsLeastRecentlyReadOverBudget) {
+    // One shard with room for about three results
+    Util::TaskRegistry registry({.max_bytes = 3500, .shards = 1});
+    const std::string result(1000, 'x');
+    std::vector<std::string> ids;
+    for (int i = 0; i < 3; ++i) {
+        const auto task = registry.create();
+        task.finish(Status::Success, result);
+        ids.push_back(task.id());
+    }
+    ASSERT_NE(nullptr, registry.result(ids[0])); // Now read more recently than ids[1]
+    const auto task = registry.create();
+    const auto evicted = registry.stats().evicted;
+    task.finish(Status::Success, result);
+    ASSERT_EQ(evicted, registry.stats().evicted); // Workers finishing tasks leave eviction to the next lookup
+    ASSERT_EQ(Status::Success, registry.status(ids[0]));
+    ASSERT_EQ(Status::NotFound, registry.status(ids[1]));
+    ASSERT_EQ(Status::Success, registry.status(task.id()));
+    ASSERT_LE(registry.stats().bytes, 3500u);
+    ASSERT_GE(registry.stats().evicted, 1u);
+}
+
+TEST(TaskRegistry, WaitsUntilFinishedOrDeadline) {
+    Util::TaskRegistry registry;
+    const auto task = registry.create();
+    const auto soon = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+    ASSERT_EQ(Status::InQueue, registry.wait(task.id(), soon));
+    ASSERT_GE(std::chrono::steady_clock::now(), soon);
+    ASSERT_EQ(Status::NotFound, registry.wait("task_99", std::chrono::steady_clock::now() + std::chrono::hours(1)));
+
+    std::thread worker([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        task.start();
+        task.finish(Status::Success, "{}");
+    });
+    const auto st = std::chrono::steady_clock::now();
+    ASSERT_EQ(Status::Success, registry.wait(task.id(), st + std::chrono::seconds(10)));
+    ASSERT_LT(std::chrono::steady_clock::now() - st, std::chrono::seconds(5));
+    ASSERT_EQ(Status::Success, task.wait(st)); // Finished tasks do not block
+    worker.join();
+}
@@ -0,0 +1,88 @@
+#ifndef TESTGRID_H
+#define TESTGRID_H
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../RoutingProfile.h"
+#include "../object.h"
+
+namespace Foliage::Fixtures {
+    // Ways between the neighbors of a side x side grid about 100 m apart, shifted by up to `jitter` degrees,
+    // each of a random class. About `oneways` of them are oneway. Node ids count up from `first_id`
+    inline std::vector<std::shared_ptr<ObjectType::Way>> grid(int side, std::mt19937 &random,
+                                                              const std::vector<std::string> &classes, double jitter,
+                                                              double oneways = 0, int64_t first_id = 0) {
+        std::vector<std::shared_ptr<ObjectType::Node>> nodes;
+        std::vector<std::shared_ptr<ObjectType::Way>> ways;
+        for (int i = 0; i < side * side; ++i) {
+            auto node = std::make_shared<ObjectType::Node>(first_id + i);
+            node->position = Geometry::Position(31 + (i / side) * 0.001 + (random() % 1000) * 1e-3 * jitter,
+                                                121 + (i % side) * 0.001 + (random() % 1000) * 1e-3 * jitter);
+            nodes.push_back(node);
+        }
+        for (int i = 0; i < side * side; ++i) {
+            for (const int next: {i % side + 1 < side ? i + 1 : -1, i + side < side * side ? i + side : -1}) {
+                if (next < 0) continue;
+                auto way = std::make_shared<ObjectType::Way>(static_cast<int64_t>(ways.size()));
+                way->nodes = {nodes[i], nodes[next]};
+                way->tags = {{"highway", classes[random() % classes.size()]}};
+                if (oneways > 0 && random() % 1000 < oneways * 1000) way->tags["oneway"] = "yes";
+                ways.push_back(way);
+            }
+        }
+        return ways;
+    }
+
+    /**
+     * Reference Dijkstra over the arrivals at nodes by an edge, for searches where what an edge costs depends on
+     * the one that led to it: `cost(arrival, edge)` prices taking `edge` after `arrival`, which is invalid_edge at
+     * the source. Infinite costs are impassable. Stops once `target` is settled
+     * @return The distance from `source` to every node settled, infinity for the others
+     */
+    template<typename Cost>
+    std::vector<double> arrival_distances(const Graph::RoutingGraph &graph, Graph::NodeIndex source, Cost &&cost,
+                                          Graph::NodeIndex target = Graph::invalid_node) {
+        std::vector<double> arrivals(graph.edge_count(), std::numeric_limits<double>::infinity());
+        std::vector<double> distance(graph.node_count(), std::numeric_limits<double>::infinity());
+        using Entry = std::pair<double, Graph::EdgeIndex>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+        auto relax = [&](Graph::EdgeIndex arrival, double d, Graph::NodeIndex node) {
+            for (auto edge = graph.edges_begin(node); edge < graph.edges_end(node); ++edge) {
+                const double through = d + cost(arrival, edge);
+                if (std::isfinite(through) && through < arrivals[edge]) {
+                    arrivals[edge] = through;
+                    heap.emplace(through, edge);
+                }
+            }
+        };
+        distance[source] = 0;
+        if (source == target) return distance;
+        relax(Graph::invalid_edge, 0, source);
+        while (!heap.empty()) {
+            const auto [d, arrival] = heap.top();
+            heap.pop();
+            if (d > arrivals[arrival]) continue;
+            const auto node = graph.edge_targets[arrival];
+            distance[node] = std::min(distance[node], d);
+            if (node == target) break;
+            relax(arrival, d, node);
+        }
+        return distance;
+    }
+
+    // Reference Dijkstra on the compiled weights of a profile, see arrival_distances
+    inline std::vector<double> distances(const Graph::RoutingGraph &graph, const Graph::ProfileWeights &weights,
+                                         Graph::NodeIndex source, Graph::NodeIndex target = Graph::invalid_node) {
+        return arrival_distances(graph, source, [&](Graph::EdgeIndex, Graph::EdgeIndex edge) {
+            return static_cast<double>(weights[edge]);
+        }, target);
+    }
+}
+
+#endif //TESTGRID_H
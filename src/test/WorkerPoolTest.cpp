@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "../WorkerPool.h"
+#include <future>
+#include <stdexcept>
+
+using namespace Foliage;
+using Lane = Util::WorkerPool::Lane;
+
+TEST(WorkerPool, RunsEveryTaskBeforeStopping) {
+    std::atomic<int> done{0};
+    {
+        Util::WorkerPool pool(4);
+        for (int i = 0; i < 1000; ++i) pool.submit(i % 10 == 0 ? Lane::Load : Lane::Query, [&] { ++done; });
+    }
+    ASSERT_EQ(1000, done.load());
+}
+
+TEST(WorkerPool, SlowLoadDoesNotHoldUpQueries) {
+    Util::WorkerPool pool(2);
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    pool.submit(Lane::Load, [released] { released.wait(); });
+
+    std::promise<void> answered;
+    pool.submit(Lane::Query, [&] { answered.set_value(); });
+    ASSERT_EQ(std::future_status::ready, answered.get_future().wait_for(std::chrono::seconds(10)));
+    release.set_value();
+}
+
+// Round-robin puts every other task behind the blocked one, so the idle worker has to steal them
+TEST(WorkerPool, IdleWorkerStealsFromBusyOne) {
+    Util::WorkerPool pool(2);
+    std::promise<void> release, started;
+    auto released = release.get_future().share();
+    pool.submit(Lane::Query, [&, released] {
+        started.set_value();
+        released.wait();
+    });
+    started.get_future().wait();
+
+    std::atomic<int> done{0};
+    std::promise<void> all_done;
+    for (int i = 0; i < 20; ++i) {
+        pool.submit(Lane::Query, [&] {
+            if (++done == 20) all_done.set_value();
+        });
+    }
+    ASSERT_EQ(std::future_status::ready, all_done.get_future().wait_for(std::chrono::seconds(10)));
+    while (pool.stats(Lane::Query).completed < 20) std::this_thread::yield();
+    const auto stats = pool.stats(Lane::Query);
+    ASSERT_EQ(2u, stats.workers);
+    ASSERT_EQ(1u, stats.running);
+    ASSERT_EQ(0u, stats.queued);
+    ASSERT_GT(stats.stolen, 0u);
+    release.set_value();
+}
+
+TEST(WorkerPool, CountsFailuresAndKeepsRunning) {
+    Util::WorkerPool pool(1);
+    pool.submit(Lane::Query, [] { throw std::runtime_error("Failed task"); });
+    std::promise<void> ran;
+    pool.submit(Lane::Query, [&] { ran.set_value(); });
+    ran.get_future().wait();
+    // The second task may still be finishing its bookkeeping
+    while (pool.stats(Lane::Query).completed < 2) std::this_thread::yield();
+    const auto stats = pool.stats(Lane::Query);
+    ASSERT_EQ(1u, stats.failed);
+    ASSERT_GE(stats.max_seconds, 0);
+    ASSERT_GE(stats.busy_seconds, stats.max_seconds);
+    ASSERT_EQ(0u, pool.stats(Lane::Load).completed);
+}